@@ -68,7 +68,7 @@ void M5Display::loadHzk16(Hzk16Types hzkTypes, const char *HZK16Path,
 
     // Hzk16Types hzkTypes = InternalHzk16
     if (hzkTypes == InternalHzk16) {
-        //#if defined(_ASC16_) && defined(_HZK16_)
+#if CONFIG_M5STICKC_FONT_HZK16
 
         pAscCharMatrix = (uint8_t *)&ASC16[0];
 
@@ -79,6 +79,10 @@ void M5Display::loadHzk16(Hzk16Types hzkTypes, const char *HZK16Path,
         Serial.println("ASC16 path: Internal");
 
         hzk16Used = initHzk16(true, nullptr, nullptr);
+#else
+        // not linked, see CONFIG_M5STICKC_FONT_HZK16
+        Serial.println("HZK16 path: Internal font not built in");
+#endif
     }
 
     Serial.print("HZK16 init result: ");
@@ -5,9 +5,13 @@
 #include <FS.h>
 #include <SPI.h>
 #include "utility/In_eSPI.h"
+#if CONFIG_M5STICKC_SPRITE
 #include "utility/Sprite.h"
+#endif
+#if CONFIG_M5STICKC_FONT_HZK16
 #include "Fonts/HZK16.h"
 #include "Fonts/ASC16.h"
+#endif
 
 typedef enum {
     JPEG_DIV_NONE,
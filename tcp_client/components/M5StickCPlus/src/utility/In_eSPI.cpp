@@ -54,7 +54,7 @@ inline void TFT_eSPI::spi_begin(void) {
     if (locked) {
         locked = false;
         spi.beginTransaction(
-            SPISettings(SPI_FREQUENCY, MSBFIRST, TFT_SPI_MODE));
+            SPISettings(_writeFreq, MSBFIRST, TFT_SPI_MODE));
         CS_L;
     }
 #else
@@ -68,7 +68,7 @@ inline void TFT_eSPI::spi_begin(void) {
 inline void TFT_eSPI::spi_end(void) {
 #if defined(SPI_HAS_TRANSACTION) && defined(SUPPORT_TRANSACTIONS) && \
     !defined(ESP32_PARALLEL)
-    if (!inTransaction) {
+    if (!inTransaction && !batchDepth) {
         if (!locked) {
             locked = true;
             CS_H;
@@ -79,7 +79,7 @@ inline void TFT_eSPI::spi_end(void) {
     SPI1U = SPI1U_READ;
 #endif
 #else
-    if (!inTransaction) CS_H;
+    if (!inTransaction && !batchDepth) CS_H;
 #endif
 }
 
@@ -115,7 +115,7 @@ inline void TFT_eSPI::spi_end_read(void) {
     }
 #else
 #if !defined(ESP32_PARALLEL)
-    spi.setFrequency(SPI_FREQUENCY);
+    spi.setFrequency(_writeFreq);
 #endif
     if (!inTransaction) CS_H;
 #endif
@@ -254,6 +254,8 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h) {
 
     locked        = true;  // ESP32 transaction mutex lock flags
     inTransaction = false;
+    batchDepth    = 0;
+    _writeFreq    = SPI_FREQUENCY;
 
     _booted = true;
     _cp437  = true;
@@ -964,8 +966,10 @@ void TFT_eSPI::end_SDA_Read(void) {
 #ifdef ESP32
     pinMode(TFT_MOSI, OUTPUT);
     pinMatrixOutAttach(TFT_MOSI, VSPID_OUT_IDX, false, false);
+#if TFT_MISO >= 0
     pinMode(TFT_MISO, INPUT);
     pinMatrixInAttach(TFT_MISO, VSPIQ_IN_IDX, false);
+#endif
 #else
 #ifdef TFT_SPI_OVERLAP
     spi.pins(6, 7, 8, 0);
@@ -3429,6 +3433,59 @@ void TFT_eSPI::endWrite(void) {
     spi_end();
 }
 
+/***************************************************************************************
+** Function name:           beginBatch
+** Description:             start or nest a batch, the transaction is held until
+*the outermost endBatch
+***************************************************************************************/
+void TFT_eSPI::beginBatch(void) {
+    if (batchDepth++ == 0) spi_begin();
+}
+
+/***************************************************************************************
+** Function name:           endBatch
+** Description:             end a batch, the outermost one ends the transaction
+***************************************************************************************/
+void TFT_eSPI::endBatch(void) {
+    if (batchDepth == 0) return;
+    if (--batchDepth == 0) spi_end();
+}
+
+/***************************************************************************************
+** Function name:           setWriteFrequency
+** Description:             SPI write clock for the next transactions
+***************************************************************************************/
+void TFT_eSPI::setWriteFrequency(uint32_t freq) {
+    _writeFreq = freq;
+}
+
+uint32_t TFT_eSPI::getWriteFrequency(void) {
+    return _writeFreq;
+}
+
+/***************************************************************************************
+** Function name:           testWriteFrequency
+** Description:             write a pattern with the write clock and read it back
+***************************************************************************************/
+bool TFT_eSPI::testWriteFrequency(int32_t x, int32_t y) {
+    uint16_t pattern[32], readback[32];
+    // walking one and walking zero interleaved, every data bit toggles on
+    // every pixel
+    for (int i = 0; i < 32; i++)
+        pattern[i] = (i & 1) ? (uint16_t) ~(1 << (i >> 1)) : (1 << (i >> 1));
+
+    startWrite();
+    setWindow(x, y, x + 31, y);
+    pushColors(pattern, 32);
+    endWrite();
+
+    readRect(x, y, 32, 1, readback);  // byte swapped, see readRect()
+    for (int i = 0; i < 32; i++)
+        if (readback[i] != (uint16_t)((pattern[i] << 8) | (pattern[i] >> 8)))
+            return false;
+    return true;
+}
+
 /***************************************************************************************
 ** Function name:           writeColor (use startWrite() and endWrite() before &
 *after)
@@ -5380,7 +5437,7 @@ void TFT_eSPI::getSetup(setup_t &tft_settings) {
     tft_settings.tft_spi_freq = 0;
 #else
     tft_settings.serial       = true;
-    tft_settings.tft_spi_freq = SPI_FREQUENCY / 100000;
+    tft_settings.tft_spi_freq = _writeFreq / 100000;
 #ifdef SPI_READ_FREQUENCY
     tft_settings.tft_rd_freq  = SPI_READ_FREQUENCY / 100000;
 #endif
@@ -939,6 +939,22 @@ class TFT_eSPI : public Print {
         uint32_t len);    // Write colours without transaction overhead
     void endWrite(void);  // End SPI transaction
 
+    // Group primitives into one SPI transaction (one bus lock and chip select
+    // for all of them) until the matching endBatch(), can be nested. The
+    // primitives do not end the transaction themselves inside a batch. No
+    // reads inside a batch, they need the read clock.
+    void beginBatch(void);
+    void endBatch(void);
+
+    // Write clock from the next transaction on, SPI_FREQUENCY after init().
+    // Reads keep SPI_READ_FREQUENCY.
+    void setWriteFrequency(uint32_t freq);
+    uint32_t getWriteFrequency(void);
+    // Writes a 32 x 1 pixel pattern at x, y with the current write clock,
+    // reads it back and compares, false on a mismatch or if reads do not
+    // work. The pattern stays on the screen. Not inside a batch.
+    bool testWriteFrequency(int32_t x, int32_t y);
+
     uint16_t decodeUTF8(uint8_t *buf, uint16_t *index, uint16_t remaining);
     uint16_t decodeUTF8(uint8_t c);
     size_t write(uint8_t);
@@ -1014,6 +1030,8 @@ class TFT_eSPI : public Print {
                                  // bottom edge of display
     bool _swapBytes;             // Swap the byte order for TFT pushImage()
     bool locked, inTransaction;  // Transaction and mutex lock flags for ESP32
+    uint8_t batchDepth;          // beginBatch() nesting, holds the transaction
+    uint32_t _writeFreq;         // SPI write clock, setWriteFrequency()
 
     bool _booted;  // init() or begin() has already run once
     bool _cp437;   // If set, use correct CP437 charset (default is ON)
@@ -34,8 +34,9 @@
 // MOSI line. To use the SDA line for reading data from the TFT uncomment the
 // following line:
 
-// #define TFT_SDA_READ      // This option if for ESP32 ONLY, tested with
-// ST7789 display only
+#define TFT_SDA_READ  // This option if for ESP32 ONLY, tested with
+// ST7789 display only. The M5StickC Plus has no MISO, reads are only used by
+// the write clock self test (testWriteFrequency)
 
 // For ST7789 ONLY, define the colour order IF the blue and red are swapped on
 // your display Try ONE option at a time to find the correct colour order for
@@ -239,22 +240,40 @@
 // normally necessary. If all fonts are loaded the extra FLASH space required is
 // about 17Kbytes. To save FLASH space only enable the fonts you need!
 
+// The fonts are selected in menuconfig ("M5StickC Plus display"), unused ones
+// are neither compiled nor linked.
+#include "sdkconfig.h"
+
+#if CONFIG_M5STICKC_FONT_GLCD
 #define LOAD_GLCD   // Font 1. Original Adafruit 8 pixel font needs ~1820 bytes
                     // in FLASH
+#endif
+#if CONFIG_M5STICKC_FONT_2
 #define LOAD_FONT2  // Font 2. Small 16 pixel high font, needs ~3534 bytes in
                     // FLASH, 96 characters
+#endif
+#if CONFIG_M5STICKC_FONT_4
 #define LOAD_FONT4  // Font 4. Medium 26 pixel high font, needs ~5848 bytes in
                     // FLASH, 96 characters
+#endif
+#if CONFIG_M5STICKC_FONT_6
 #define LOAD_FONT6  // Font 6. Large 48 pixel font, needs ~2666 bytes in FLASH,
                     // only characters 1234567890:-.apm
+#endif
+#if CONFIG_M5STICKC_FONT_7
 #define LOAD_FONT7  // Font 7. 7 segment 48 pixel font, needs ~2438 bytes in
                     // FLASH, only characters 1234567890:-.
+#endif
+#if CONFIG_M5STICKC_FONT_8
 #define LOAD_FONT8  // Font 8. Large 75 pixel font needs ~3256 bytes in FLASH,
                     // only characters 1234567890:-.
+#endif
 //#define LOAD_FONT8N // Font 8. Alternative to Font 8 above, slightly narrower,
 // so 3 digits fit a 160 pixel TFT
+#if CONFIG_M5STICKC_FONT_GFXFF
 #define LOAD_GFXFF  // FreeFonts. Include access to the 48 Adafruit_GFX free
                     // fonts FF1 to FF48 and custom fonts
+#endif
 
 // Comment out the #define below to stop the SPIFFS filing system and smooth
 // font code being loaded this will save ~20kbytes of FLASH
@@ -0,0 +1,8 @@
+# SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+import pytest
+
+
+def pytest_configure(config: pytest.Config) -> None:
+    # the IDF test environment registers host_test, this is for runs of pytest_tcp_client.py outside of it
+    config.addinivalue_line('markers', 'host_test: runs on the host, builds main/ sources with the host compiler')
@@ -0,0 +1,55 @@
+#include <math.h>
+
+#include "btd_activity.h"
+#include "btd_activity_model.h"
+
+static const char *activity_names[ACTIVITY_COUNT] = {"still", "walking", "gesture"};
+
+static int16_t saturate(float value)
+{
+    if (value > INT16_MAX)
+        return INT16_MAX;
+    if (value < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)lrintf(value);
+}
+
+void activity_quantize(const btd_features_t *features, int16_t *quantized)
+{
+    float stddev = sqrtf(features->variance);
+    quantized[ACTIVITY_FEATURE_STDDEV] = saturate(stddev);
+    quantized[ACTIVITY_FEATURE_MEAN] = saturate(features->mean);
+    quantized[ACTIVITY_FEATURE_CROSSINGS] = saturate(features->zero_crossing_rate * 10.0f);
+    quantized[ACTIVITY_FEATURE_PEAKS] = saturate(features->peak_count);
+    quantized[ACTIVITY_FEATURE_FREQUENCY] = saturate(features->dominant_frequency * 10.0f);
+    quantized[ACTIVITY_FEATURE_AMPLITUDE] = saturate(features->dominant_amplitude);
+    quantized[ACTIVITY_FEATURE_PERIODICITY] =
+        stddev > 0.0f ? saturate(100.0f * features->dominant_amplitude / (1.41421356f * stddev)) : 0;
+}
+
+btd_activity_t activity_classify_quantized(const int16_t *quantized)
+{
+    const activity_node_t *node = &ACTIVITY_MODEL[0];
+    for (int depth = 0; depth < ACTIVITY_MODEL_DEPTH && node->feature != ACTIVITY_LEAF; depth++)
+        node = &ACTIVITY_MODEL[quantized[node->feature] <= node->threshold ? node->left : node->right];
+    return (btd_activity_t)node->left; // leaves keep the class in left
+}
+
+btd_activity_t activity_classify(const btd_features_t *features)
+{
+    int16_t quantized[ACTIVITY_FEATURE_COUNT];
+    activity_quantize(features, quantized);
+    return activity_classify_quantized(quantized);
+}
+
+const char *activity_name(btd_activity_t activity)
+{
+    if ((unsigned)activity >= ACTIVITY_COUNT)
+        return "unknown";
+    return activity_names[activity];
+}
+
+size_t activity_model_size(void)
+{
+    return sizeof(ACTIVITY_MODEL);
+}
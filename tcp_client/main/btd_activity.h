@@ -0,0 +1,72 @@
+#ifndef BTD_ACTIVITY_H
+#define BTD_ACTIVITY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "btd_features.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Activity classifier over the features of the 2 sec magnitude window of
+// btd_movement (magnitude minus 1 g in mg, 50 Hz = ACTIVITY_MODEL_RATE_HZ, 0.5-6 Hz bins).
+// The features are quantized to integers and run through a decision tree that
+// tools/train_classifier.py trains on recorded CSVs and writes to
+// btd_activity_model.h. Inference visits at most ACTIVITY_MODEL_DEPTH nodes
+// with integer compares only.
+
+typedef enum
+{
+    ACTIVITY_STILL,   // sitting, standing or lying on the desk
+    ACTIVITY_WALKING,
+    ACTIVITY_GESTURE, // shaking the device
+    ACTIVITY_COUNT
+} btd_activity_t;
+
+typedef enum
+{
+    ACTIVITY_FEATURE_STDDEV,      // mg
+    ACTIVITY_FEATURE_MEAN,        // mg
+    ACTIVITY_FEATURE_CROSSINGS,   // zero crossings per 10 secs
+    ACTIVITY_FEATURE_PEAKS,       // peaks in the window
+    ACTIVITY_FEATURE_FREQUENCY,   // dominant frequency in 0.1 Hz
+    ACTIVITY_FEATURE_AMPLITUDE,   // dominant amplitude in mg
+    ACTIVITY_FEATURE_PERIODICITY, // dominant amplitude in % of a sine with the window's variance
+    ACTIVITY_FEATURE_COUNT
+} btd_activity_feature_t;
+
+/*
+    In: features of the magnitude window
+    Out: quantized features, ACTIVITY_FEATURE_COUNT values
+*/
+void activity_quantize(const btd_features_t *features, int16_t *quantized);
+
+/*
+    In: quantized features
+    Out: activity
+*/
+btd_activity_t activity_classify_quantized(const int16_t *quantized);
+
+/*
+    In: features of the magnitude window
+    Out: activity
+*/
+btd_activity_t activity_classify(const btd_features_t *features);
+
+/*
+    Out: name of the activity for logs
+*/
+const char *activity_name(btd_activity_t activity);
+
+/*
+    Out: size of the model in bytes
+*/
+size_t activity_model_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_ACTIVITY_H
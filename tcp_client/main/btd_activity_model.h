@@ -0,0 +1,65 @@
+// generated by tools/train_classifier.py, do not edit
+// 50 Hz, trained on values.csv and 120 synthetic gesture bursts
+// 29 nodes, depth 5, 174 bytes
+// training: 12173 windows, accuracy 0.979
+//   still    precision 0.976 recall 0.978  confusion [4864, 105, 2]
+//   walking  precision 0.975 recall 0.993  confusion [37, 5103, 0]
+//   gesture  precision 0.999 recall 0.947  confusion [85, 25, 1952]
+// validation: 5228 windows, accuracy 0.960
+//   still    precision 0.950 recall 0.971  confusion [2496, 71, 3]
+//   walking  precision 0.840 recall 0.937  confusion [27, 399, 0]
+//   gesture  precision 0.999 recall 0.951  confusion [105, 5, 2122]
+#ifndef BTD_ACTIVITY_MODEL_H
+#define BTD_ACTIVITY_MODEL_H
+
+#include <stdint.h>
+
+#define ACTIVITY_LEAF 0xFF
+
+// inner node: quantized[feature] <= threshold goes to left, else right
+// leaf: feature is ACTIVITY_LEAF, left is the btd_activity_t
+typedef struct
+{
+    int16_t threshold;
+    uint8_t feature;
+    uint8_t left;
+    uint8_t right;
+} activity_node_t;
+
+#define ACTIVITY_MODEL_RATE_HZ 50 // of the magnitude window the model was trained on
+
+constexpr int ACTIVITY_MODEL_DEPTH = 5;
+
+constexpr activity_node_t ACTIVITY_MODEL[] = {
+    {52, 2, 1, 12}, // 0: crossings <= 52
+    {27, 4, 2, 9}, // 1: frequency <= 27
+    {63, 0, 3, 6}, // 2: stddev <= 63
+    {21, 1, 4, 5}, // 3: mean <= 21
+    {0, ACTIVITY_LEAF, 0, 0}, // 4: still
+    {0, ACTIVITY_LEAF, 1, 0}, // 5: walking
+    {36, 6, 7, 8}, // 6: periodicity <= 36
+    {0, ACTIVITY_LEAF, 0, 0}, // 7: still
+    {0, ACTIVITY_LEAF, 1, 0}, // 8: walking
+    {32, 2, 10, 11}, // 9: crossings <= 32
+    {0, ACTIVITY_LEAF, 1, 0}, // 10: walking
+    {0, ACTIVITY_LEAF, 0, 0}, // 11: still
+    {65, 6, 13, 24}, // 12: periodicity <= 65
+    {39, 1, 14, 19}, // 13: mean <= 39
+    {394, 0, 15, 16}, // 14: stddev <= 394
+    {0, ACTIVITY_LEAF, 0, 0}, // 15: still
+    {63, 6, 17, 18}, // 16: periodicity <= 63
+    {0, ACTIVITY_LEAF, 0, 0}, // 17: still
+    {0, ACTIVITY_LEAF, 2, 0}, // 18: gesture
+    {1024, 0, 20, 21}, // 19: stddev <= 1024
+    {0, ACTIVITY_LEAF, 1, 0}, // 20: walking
+    {82, 2, 22, 23}, // 21: crossings <= 82
+    {0, ACTIVITY_LEAF, 1, 0}, // 22: walking
+    {0, ACTIVITY_LEAF, 0, 0}, // 23: still
+    {22, 4, 25, 28}, // 24: frequency <= 22
+    {72, 6, 26, 27}, // 25: periodicity <= 72
+    {0, ACTIVITY_LEAF, 0, 0}, // 26: still
+    {0, ACTIVITY_LEAF, 1, 0}, // 27: walking
+    {0, ACTIVITY_LEAF, 2, 0}, // 28: gesture
+};
+
+#endif // BTD_ACTIVITY_MODEL_H
@@ -1,13 +1,23 @@
-#include "driver/i2s.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
 #include "esp_log.h"
 
-static const char *TAG = "BTD_MICROPHONE_AUDIO";
+#include "btd_audio.h"
+
+[[maybe_unused]] static const char *TAG = "BTD_MICROPHONE_AUDIO";
 
 static const float AUDIO_THRESHOLD = 2500; // normal quietness at about 1700
 
 static bool currently_loud = false;
 static int64_t loud_start_time_ms = 0;
 static int64_t total_loud_duration_ms = 0; 
+static int last_sample = 0;
+static int64_t ignore_until_ms = 0; // cues of the buzzer, see audio_ignore()
+
+// the linux simulation provides init_microphone() and read_microphone_sample() (btd_sim.cpp)
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/i2s.h"
 
 #define I2S_MIC_PORT I2S_NUM_0
 #define I2S_MIC_SERIAL_CLK 26  
@@ -56,10 +66,12 @@ int read_microphone_sample() {
     int average = sum / samples_read;
     return average;
 }
+#endif
  
 bool is_volume_above_threshold(int64_t current_time_ms) {
     int sample = read_microphone_sample();
-    bool loud = abs(sample) > AUDIO_THRESHOLD;
+    last_sample = sample;
+    bool loud = abs(sample) > AUDIO_THRESHOLD && current_time_ms >= ignore_until_ms;
 
     if (loud && !currently_loud) {
         loud_start_time_ms = current_time_ms;
@@ -73,6 +85,11 @@ bool is_volume_above_threshold(int64_t current_time_ms) {
     return loud;
 }
 
+void audio_ignore(int64_t current_time_ms, uint32_t duration_ms) {
+    if (ignore_until_ms < current_time_ms) ignore_until_ms = current_time_ms;
+    ignore_until_ms += duration_ms;
+}
+
 float get_loud_percentage(int64_t session_start_ms, int64_t session_end_ms) {
     int64_t session_duration_ms = session_end_ms - session_start_ms;
     if (session_duration_ms == 0) return 0.0f;
@@ -82,3 +99,7 @@ float get_loud_percentage(int64_t session_start_ms, int64_t session_end_ms) {
 int64_t get_total_loud_duration_ms(){
     return total_loud_duration_ms;
 }
+
+int get_last_microphone_level(){
+    return last_sample;
+}
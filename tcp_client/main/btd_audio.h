@@ -11,6 +11,13 @@ void init_microphone();
 */
 bool is_volume_above_threshold(int64_t current_time_ms);
 
+/*
+    In: current timestamp, duration of a sound of the device itself
+    the microphone does not count as loud for this time, after the time already ignored
+    (a cue queued behind another plays after it)
+*/
+void audio_ignore(int64_t current_time_ms, uint32_t duration_ms);
+
 /*
     In: session start timestamp and session end timestamp
     Out: float value of percentage of duration of the session which is louder than threshold 
@@ -26,3 +33,8 @@ int read_microphone_sample();
     Out: total duration of time which is louder than threshold (in ms)
 */
 int64_t get_total_loud_duration_ms();
+
+/*
+    Out: volume of the last reading of is_volume_above_threshold()
+*/
+int get_last_microphone_level();
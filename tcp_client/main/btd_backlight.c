@@ -0,0 +1,72 @@
+#include <math.h>
+
+#include "btd_backlight.h"
+
+static backlight_level_t level = BACKLIGHT_FULL;
+static bool working = false;
+static bool facing = false;
+static int64_t activity_ms = 0;
+static int64_t level_since_ms = 0;
+static uint32_t session_ms[BACKLIGHT_LEVELS];
+
+void backlight_init(int64_t now_ms)
+{
+    level = BACKLIGHT_FULL;
+    working = false;
+    facing = false;
+    activity_ms = now_ms;
+    level_since_ms = now_ms;
+    for (int i = 0; i < BACKLIGHT_LEVELS; i++)
+        session_ms[i] = 0;
+}
+
+void backlight_set_working(bool new_working, int64_t now_ms)
+{
+    backlight_update(now_ms);
+    if (new_working && !working)
+    {
+        for (int i = 0; i < BACKLIGHT_LEVELS; i++)
+            session_ms[i] = 0;
+    }
+    working = new_working;
+    activity_ms = now_ms; // the screen of the new state is shown first
+}
+
+void backlight_activity(int64_t now_ms)
+{
+    activity_ms = now_ms;
+}
+
+bool backlight_is_facing(const float gravity[3])
+{
+    // gravity is a unit vector, its z component is the sine of the display normal's elevation
+    float elevation = asinf(fmaxf(-1.0f, fminf(1.0f, gravity[2]))) * (180.0f / (float)M_PI);
+    return elevation >= BACKLIGHT_FACING_MIN_DEG && elevation <= BACKLIGHT_FACING_MAX_DEG;
+}
+
+void backlight_set_facing(bool new_facing, int64_t now_ms)
+{
+    if (new_facing && !facing)
+        activity_ms = now_ms; // lifted
+    facing = new_facing;
+}
+
+backlight_level_t backlight_update(int64_t now_ms)
+{
+    backlight_level_t next;
+    int64_t idle_ms = now_ms - activity_ms;
+    if (working)
+        next = facing || idle_ms < BACKLIGHT_WAKE_MS ? BACKLIGHT_FULL : BACKLIGHT_OFF;
+    else
+        next = idle_ms < BACKLIGHT_DIM_AFTER_MS ? BACKLIGHT_FULL : BACKLIGHT_DIM;
+
+    session_ms[level] += (uint32_t)(now_ms - level_since_ms);
+    level_since_ms = now_ms;
+    level = next;
+    return level;
+}
+
+uint32_t backlight_session_ms(backlight_level_t at, int64_t now_ms)
+{
+    return session_ms[at] + (at == level ? (uint32_t)(now_ms - level_since_ms) : 0);
+}
@@ -0,0 +1,80 @@
+#ifndef BTD_BACKLIGHT_H
+#define BTD_BACKLIGHT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Display power policy, the backlight is one of the largest loads.
+// Outside of working sessions the display is at full brightness and dims after
+// BACKLIGHT_DIM_AFTER_MS without input. While working it is off unless the
+// display is tilted towards the user (from the fusion gravity vector): lifting
+// the device turns it on at once, a button press for BACKLIGHT_WAKE_MS.
+// The controller feeds the inputs and applies the level with
+// display_set_backlight(); times are hal_time_ms(). Single task only.
+
+#define BACKLIGHT_DIM_AFTER_MS 15000
+#define BACKLIGHT_WAKE_MS 5000
+#define BACKLIGHT_FACING_MIN_DEG 20.0f // display normal above the horizon, upright is 0
+#define BACKLIGHT_FACING_MAX_DEG 70.0f // lying flat is 90
+#define BACKLIGHT_FULL_PERCENT 70      // ScreenBreath(), about the 3.0 V of the AXP192 setup
+#define BACKLIGHT_DIM_PERCENT 20
+
+typedef enum
+{
+    BACKLIGHT_OFF,
+    BACKLIGHT_DIM,
+    BACKLIGHT_FULL,
+    BACKLIGHT_LEVELS,
+} backlight_level_t;
+
+/*
+    In: current time
+    starts at full brightness, outside of a working session
+*/
+void backlight_init(int64_t now_ms);
+
+/*
+    In: whether a working session runs from now on, current time
+    starting a session also restarts the on-time statistics
+*/
+void backlight_set_working(bool working, int64_t now_ms);
+
+/*
+    In: current time
+    a button press, wakes the display
+*/
+void backlight_activity(int64_t now_ms);
+
+/*
+    In: direction of gravity in the sensor frame (fusion_get_gravity())
+    Out: true if the display is tilted towards the user
+*/
+bool backlight_is_facing(const float gravity[3]);
+
+/*
+    In: facing from backlight_is_facing(), current time
+    turning towards the user counts as activity
+*/
+void backlight_set_facing(bool facing, int64_t now_ms);
+
+/*
+    In: current time
+    Out: level the display should have now
+*/
+backlight_level_t backlight_update(int64_t now_ms);
+
+/*
+    In: level, current time
+    Out: time at that level since the working session started
+*/
+uint32_t backlight_session_ms(backlight_level_t level, int64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_BACKLIGHT_H
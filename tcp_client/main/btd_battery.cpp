@@ -1,13 +1,96 @@
 #include "Arduino.h"
 #include "M5StickCPlus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "btd_battery.h"
+#include "btd_fuelgauge.h"
+#include "btd_energy.h"
+
+static const char *TAG = "BTD_BATTERY";
+
+static btd_fuelgauge_t gauge; // battery task only
+static btd_battery_status_t status;
+static SemaphoreHandle_t status_mutex = NULL;
+static SemaphoreHandle_t pmic_mutex = NULL; // every AXP192 transfer, see battery_pmic_lock()
+
+static void sample(void)
+{
+    xSemaphoreTake(status_mutex, portMAX_DELAY);
+    btd_battery_status_t next = status;
+    xSemaphoreGive(status_mutex);
+
+    battery_pmic_lock();
+    next.voltage_v = M5.Axp.GetBatVoltage();
+    next.current_ma = M5.Axp.GetBatCurrent();
+    next.coulomb_mah = M5.Axp.GetCoulombData();
+    // USB supplies the device and the charge current, without USB the battery supplies the device
+    next.load_ma = M5.Axp.GetVBusCurrent() + M5.Axp.GetVinCurrent() - next.current_ma;
+    battery_pmic_unlock();
+    energy_add_sample(next.load_ma);
+    fuelgauge_update(&gauge, next.voltage_v, next.current_ma, next.coulomb_mah);
+    next.percent = fuelgauge_percent(&gauge);
+    next.time_to_empty_min = fuelgauge_time_to_empty_min(&gauge);
+    next.samples++;
+
+    xSemaphoreTake(status_mutex, portMAX_DELAY);
+    status = next;
+    xSemaphoreGive(status_mutex);
+}
+
+static void battery_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true)
+    {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(BATTERY_SAMPLE_PERIOD_S * 1000));
+        sample();
+    }
+}
+
+void battery_init(void)
+{
+    status_mutex = xSemaphoreCreateMutex();
+    pmic_mutex = xSemaphoreCreateMutex();
+    fuelgauge_init(&gauge, FUELGAUGE_CAPACITY_MAH);
+    battery_pmic_lock();
+    M5.Axp.ClearCoulombcounter();
+    M5.Axp.EnableCoulombcounter();
+    battery_pmic_unlock();
+    sample(); // the first screens already show a value
+    xTaskCreate(battery_task, "battery", 3072, NULL, tskIDLE_PRIORITY + 1, NULL);
+    ESP_LOGI(TAG, "Battery %d%% (%.2f V), sampled every %d s", status.percent, status.voltage_v, BATTERY_SAMPLE_PERIOD_S);
+}
 
 int get_battery_percentage(void)
 {
-    float voltage = M5.Axp.GetBatVoltage();
-    int percentage = (voltage - 3.0) / (4.2 - 3.0) * 100; // formula from ChatGPT
-    if (percentage < 0)
-        percentage = 0;
-    if (percentage > 100)
-        percentage = 100;
-    return percentage;
-}
\ No newline at end of file
+    btd_battery_status_t copy;
+    battery_get_status(&copy);
+    return copy.percent;
+}
+
+int get_battery_time_to_empty_min(void)
+{
+    btd_battery_status_t copy;
+    battery_get_status(&copy);
+    return copy.time_to_empty_min;
+}
+
+void battery_get_status(btd_battery_status_t *out)
+{
+    xSemaphoreTake(status_mutex, portMAX_DELAY);
+    *out = status;
+    xSemaphoreGive(status_mutex);
+}
+
+void battery_pmic_lock(void)
+{
+    xSemaphoreTake(pmic_mutex, portMAX_DELAY);
+}
+
+void battery_pmic_unlock(void)
+{
+    xSemaphoreGive(pmic_mutex);
+}
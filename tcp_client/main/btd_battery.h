@@ -1,2 +1,61 @@
 #pragma once
-int get_battery_percentage(void);
\ No newline at end of file
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Battery service: a background task reads the AXP192 every BATTERY_SAMPLE_PERIOD_S
+// (voltage, current, coulomb counter), fuses them with btd_fuelgauge and caches the
+// result. The getters only read the cache, so the render path does no I2C.
+// Each sample also feeds the load current to the energy accounting (btd_energy).
+// The task shares Wire1 with the IMU, the Arduino driver locks the bus per transfer.
+// An AXP192 register access is several transfers and the backlight setters
+// read-modify-write registers, so every M5.Axp call of the app holds
+// battery_pmic_lock().
+
+#define BATTERY_SAMPLE_PERIOD_S CONFIG_BTD_BATTERY_SAMPLE_S
+
+typedef struct
+{
+    int percent;
+    int time_to_empty_min; // -1 while charging or idle
+    float voltage_v;
+    float current_ma; // positive while charging
+    float load_ma;    // drawn by the device, from the battery or USB
+    float coulomb_mah; // charged minus discharged since battery_init()
+    uint32_t samples;
+} btd_battery_status_t;
+
+/*
+    enables the coulomb counter, takes the first sample and starts the task,
+    call once after hal_board_init()
+*/
+void battery_init(void);
+
+/*
+    Out: cached state of charge in percent, 0..100
+*/
+int get_battery_percentage(void);
+
+/*
+    Out: cached minutes until empty, -1 while charging or idle
+*/
+int get_battery_time_to_empty_min(void);
+
+/*
+    Out: copy of the last sample and estimate
+*/
+void battery_get_status(btd_battery_status_t *status);
+
+/*
+    serializes the M5.Axp calls of all tasks, after battery_init()
+*/
+void battery_pmic_lock(void);
+void battery_pmic_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
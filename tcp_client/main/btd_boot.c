@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "btd_boot.h"
+#include "btd_hal.h"
+
+static const char *TAG = "BTD_BOOT";
+
+typedef struct
+{
+    const char *phase;
+    int64_t time_us;
+} boot_mark_t;
+
+static boot_mark_t marks[BOOT_MAX_MARKS];
+static int mark_count = 0;
+static SemaphoreHandle_t boot_mutex = NULL;
+
+static void lock(void)
+{
+    if (boot_mutex == NULL)
+        boot_mutex = xSemaphoreCreateMutex(); // first mark is from app_main, before the init task runs
+    xSemaphoreTake(boot_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(boot_mutex);
+}
+
+void boot_mark(const char *phase)
+{
+    int64_t now_us = hal_time_us();
+    lock();
+    if (mark_count < BOOT_MAX_MARKS)
+    {
+        marks[mark_count].phase = phase;
+        marks[mark_count].time_us = now_us;
+        mark_count++;
+    }
+    unlock();
+}
+
+int32_t boot_mark_ms(const char *phase)
+{
+    int32_t time_ms = -1;
+    lock();
+    for (int i = 0; i < mark_count; i++)
+    {
+        if (strcmp(marks[i].phase, phase) == 0)
+        {
+            time_ms = marks[i].time_us / 1000;
+            break;
+        }
+    }
+    unlock();
+    return time_ms;
+}
+
+void boot_log(void)
+{
+    lock();
+    int64_t previous_us = 0;
+    for (int i = 0; i < mark_count; i++)
+    {
+        ESP_LOGI(TAG, "%-12s %6lu ms (+%lu ms)", marks[i].phase, (unsigned long)(marks[i].time_us / 1000),
+                 (unsigned long)((marks[i].time_us - previous_us) / 1000));
+        previous_us = marks[i].time_us;
+    }
+    unlock();
+}
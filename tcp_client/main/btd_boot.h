@@ -0,0 +1,38 @@
+#ifndef BTD_BOOT_H
+#define BTD_BOOT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Boot timeline: the boot stages mark the time they are done (hal_time_us(),
+// so the time since the chip started). boot_log() prints the marks with the
+// time since the previous one; "first frame" is the time until the first
+// screen is shown. Marks come from the main task and the init task, a mutex
+// guards them; marks beyond BOOT_MAX_MARKS are dropped.
+
+#define BOOT_MAX_MARKS 16
+
+/*
+    In: name of the stage that is done, a string literal
+*/
+void boot_mark(const char *phase);
+
+/*
+    In: name of a stage
+    Out: time of its mark in ms since the chip started, -1 if it is not marked
+*/
+int32_t boot_mark_ms(const char *phase);
+
+/*
+    logs all marks
+*/
+void boot_log(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_BOOT_H
@@ -1,18 +1,159 @@
 #include <M5StickCPlus.h>
+#include <ctype.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
 
-// detect button press
-char btn_detect_press(void)
+#include "btd_button.h"
+
+static const char *TAG = "BTD_BUTTON";
+
+typedef struct
 {
-    M5.update(); // needed for reading out the button vals
-    if (M5.BtnA.wasReleased())
+    gpio_num_t pin;
+    char name;
+    esp_timer_handle_t debounce_timer;
+    esp_timer_handle_t long_press_timer;
+    volatile bool debouncing; // set by the ISR, cleared by the debounce timer
+    volatile int64_t edge_us; // first edge of the bounce being debounced
+    // only touched by the timer callbacks, which run one after the other on the esp_timer task
+    bool pressed;
+    bool long_reported;
+    int64_t press_us;
+    int64_t release_us; // of the last short press, for double presses
+} button_t;
+
+static button_t buttons[] = {
+    {.pin = (gpio_num_t)BUTTON_A_PIN, .name = 'A'},
+    {.pin = (gpio_num_t)BUTTON_B_PIN, .name = 'B'},
+};
+
+static QueueHandle_t events = NULL;
+static volatile uint32_t dropped_events = 0;
+static looptime_hist_t latency; // written by the state loop only
+
+static void IRAM_ATTR edge_isr(void *arg)
+{
+    button_t *button = (button_t *)arg;
+    if (button->debouncing)
+        return; // bounce of an edge that is being debounced
+    button->debouncing = true;
+    button->edge_us = esp_timer_get_time();
+    esp_timer_start_once(button->debounce_timer, BTN_DEBOUNCE_MS * 1000);
+}
+
+static void post(const button_t *button, btn_event_type_t type, int64_t timestamp_us)
+{
+    btn_event_t event = {.button = button->name, .type = type, .timestamp_us = timestamp_us};
+    if (xQueueSend(events, &event, 0) != pdTRUE)
+        dropped_events++;
+}
+
+static void debounce_done(void *arg)
+{
+    button_t *button = (button_t *)arg;
+    int64_t edge_us = button->edge_us;
+    button->debouncing = false; // before reading the level, so a later edge starts a new debounce
+    bool pressed = gpio_get_level(button->pin) == 0; // active low
+    if (pressed == button->pressed)
+        return; // bounced back
+
+    button->pressed = pressed;
+    if (pressed)
+    {
+        button->press_us = edge_us;
+        button->long_reported = false;
+        esp_timer_start_once(button->long_press_timer, BTN_LONG_PRESS_MS * 1000);
+        return;
+    }
+
+    esp_timer_stop(button->long_press_timer);
+    if (button->long_reported)
+        return;
+    if (button->press_us - button->release_us <= BTN_DOUBLE_PRESS_MS * 1000)
     {
-        // printf("PRESSED: A\n");
-        return 'A';
+        post(button, BTN_DOUBLE_PRESS, edge_us);
+        button->release_us = INT64_MIN / 2; // a third press starts over
     }
-    else if (M5.BtnB.wasReleased())
+    else
     {
-        // printf("PRESSED: B\n");
-        return 'B';
+        post(button, BTN_PRESS, edge_us);
+        button->release_us = edge_us;
     }
-    return 'X';
+}
+
+static void long_press_done(void *arg)
+{
+    button_t *button = (button_t *)arg;
+    if (!button->pressed)
+        return;
+    button->long_reported = true;
+    post(button, BTN_LONG_PRESS, button->press_us + BTN_LONG_PRESS_MS * 1000);
+}
+
+void btn_init(void)
+{
+    events = xQueueCreate(BTN_QUEUE_LENGTH, sizeof(btn_event_t));
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_ERR_INVALID_STATE) // already installed by another driver
+        ESP_ERROR_CHECK(err);
+
+    for (size_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++)
+    {
+        button_t *button = &buttons[i];
+        // GPIO 37 and 39 are input only without internal pulls, the board has pull-ups
+        gpio_config_t io = {
+            .pin_bit_mask = 1ULL << button->pin,
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_ANYEDGE,
+        };
+        ESP_ERROR_CHECK(gpio_config(&io));
+
+        esp_timer_create_args_t debounce_args = {.callback = debounce_done, .arg = button, .name = "btn_debounce"};
+        ESP_ERROR_CHECK(esp_timer_create(&debounce_args, &button->debounce_timer));
+        esp_timer_create_args_t long_press_args = {.callback = long_press_done, .arg = button, .name = "btn_long"};
+        ESP_ERROR_CHECK(esp_timer_create(&long_press_args, &button->long_press_timer));
+
+        button->pressed = gpio_get_level(button->pin) == 0;
+        button->release_us = INT64_MIN / 2;
+        ESP_ERROR_CHECK(gpio_isr_handler_add(button->pin, edge_isr, button));
+    }
+    ESP_LOGI(TAG, "Buttons on GPIO %d and %d", BUTTON_A_PIN, BUTTON_B_PIN);
+}
+
+bool btn_get_event(btn_event_t *event)
+{
+    if (events == NULL || xQueueReceive(events, event, 0) != pdTRUE)
+        return false;
+    int64_t latency_us = esp_timer_get_time() - event->timestamp_us;
+    looptime_record(&latency, latency_us > 0 ? (uint32_t)latency_us : 0);
+    return true;
+}
+
+char btn_detect_press(void)
+{
+    btn_event_t event;
+    if (!btn_get_event(&event))
+        return 'X';
+    return event.type == BTN_LONG_PRESS ? (char)tolower(event.button) : event.button;
+}
+
+void btn_wait(uint32_t timeout_ms)
+{
+    btn_event_t event;
+    if (events == NULL)
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+    else
+        xQueuePeek(events, &event, pdMS_TO_TICKS(timeout_ms));
+}
+
+void btn_latency_snapshot(looptime_hist_t *out, uint32_t *dropped)
+{
+    memcpy(out, &latency, sizeof(looptime_hist_t));
+    *dropped = dropped_events;
 }
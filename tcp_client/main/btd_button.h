@@ -1,3 +1,72 @@
 #pragma once
 
-char btn_detect_press(void);
\ No newline at end of file
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "btd_looptime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Buttons A (BUTTON_A_PIN, GPIO 37) and B (BUTTON_B_PIN, GPIO 39), interrupt driven.
+// Both edges of a pin run the GPIO ISR, which timestamps the first edge and starts
+// a debounce timer (esp_timer, BTN_DEBOUNCE_MS). The timer reads the settled level
+// and turns the change into events on a queue, with the time of the edge:
+// - BTN_PRESS on the release of a short press
+// - BTN_DOUBLE_PRESS instead of BTN_PRESS when the press follows the previous
+//   release within BTN_DOUBLE_PRESS_MS (the first press was reported already)
+// - BTN_LONG_PRESS once the button is held for BTN_LONG_PRESS_MS, nothing on its release
+// Nothing is polled, the state loop reads the queue; the time from the edge to the
+// read is kept as the reaction latency.
+
+#define BTN_DEBOUNCE_MS 20
+#define BTN_LONG_PRESS_MS 1000
+#define BTN_DOUBLE_PRESS_MS 400
+#define BTN_QUEUE_LENGTH 8
+
+typedef enum
+{
+    BTN_PRESS,
+    BTN_LONG_PRESS,
+    BTN_DOUBLE_PRESS,
+} btn_event_type_t;
+
+typedef struct
+{
+    char button; // 'A' or 'B'
+    btn_event_type_t type;
+    int64_t timestamp_us; // edge that completed the event, hal_time_us() clock
+} btn_event_t;
+
+/*
+    sets up the pins, the ISR and the timers, call once after hal_board_init()
+*/
+void btn_init(void);
+
+/*
+    Out: next event, false if there is none; records its latency
+*/
+bool btn_get_event(btn_event_t *event);
+
+/*
+    Out: 'A' or 'B' for a press or double press, 'a' or 'b' for a long press, 'X' for none
+*/
+char btn_detect_press(void);
+
+/*
+    In: maximum time to wait
+    waits until an event is queued (without taking it) or the time is up, replaces the
+    fixed delay of the state loop so a press is handled right away
+*/
+void btn_wait(uint32_t timeout_ms);
+
+/*
+    Out: copy of the latency histogram (edge to btn_get_event()) since boot, and the
+    number of events dropped because the queue was full
+*/
+void btn_latency_snapshot(looptime_hist_t *latency, uint32_t *dropped);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,16 +1,67 @@
 #include "driver/ledc.h"
 #include "freertos/FreeRTOS.h" // FreeRTOS API
 #include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "btd_buzzer.h"
 
 #define BUZZER_GPIO 2
 #define BUZZER_FREQ 2000
+#define BUZZER_MODE LEDC_LOW_SPEED_MODE // the Arduino LEDC of M5.Beep uses the high speed channels
+#define BUZZER_TIMER LEDC_TIMER_0
+#define BUZZER_CHANNEL LEDC_CHANNEL_0
+
+// the cue steps run on the esp_timer task, buzzer_play() only queues
+static pattern_player_t player;
+static portMUX_TYPE player_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t step_timer = NULL;
+static uint32_t tone_hz = BUZZER_FREQ;
+static bool fading = false;
+
+static uint32_t buzzer_duty(uint8_t level)
+{
+    // full level is 50% duty (range 0-1023), the loudest for a square wave
+    return (uint32_t)level * 512 / PATTERN_LEVEL_MAX;
+}
+
+static void next_step(void *arg)
+{
+    uint8_t level;
+    taskENTER_CRITICAL(&player_lock);
+    uint32_t ms = pattern_next(&player, &level);
+    const pattern_step_t *step = pattern_current(&player); // constant, safe after the lock
+    taskEXIT_CRITICAL(&player_lock);
+
+    if (fading)
+    {
+        ledc_fade_stop(BUZZER_MODE, BUZZER_CHANNEL);
+        fading = false;
+    }
+    if (step != NULL && step->hz != 0 && step->hz != tone_hz)
+    {
+        ledc_set_freq(BUZZER_MODE, BUZZER_TIMER, step->hz);
+        tone_hz = step->hz;
+    }
+    ledc_set_duty(BUZZER_MODE, BUZZER_CHANNEL, buzzer_duty(level));
+    ledc_update_duty(BUZZER_MODE, BUZZER_CHANNEL);
+    if (step != NULL && step->fade_to != step->level)
+    {
+        // the envelope runs in the LEDC, no CPU until the next step
+        ledc_set_fade_with_time(BUZZER_MODE, BUZZER_CHANNEL, buzzer_duty(step->fade_to), ms);
+        ledc_fade_start(BUZZER_MODE, BUZZER_CHANNEL, LEDC_FADE_NO_WAIT);
+        fading = true;
+    }
+    if (ms > 0)
+        esp_timer_start_once(step_timer, ms * 1000);
+}
 
 void init_buzzer(void)
 {
 
     ledc_timer_config_t ledc_timer = {
-        .speed_mode = LEDC_LOW_SPEED_MODE,
-        .timer_num = LEDC_TIMER_0,
+        .speed_mode = BUZZER_MODE,
+        .timer_num = BUZZER_TIMER,
         .duty_resolution = LEDC_TIMER_10_BIT,
         .freq_hz = BUZZER_FREQ,
         .clk_cfg = LEDC_AUTO_CLK};
@@ -18,42 +69,40 @@ void init_buzzer(void)
 
     ledc_channel_config_t ledc_channel = {
         .gpio_num = BUZZER_GPIO,
-        .speed_mode = LEDC_LOW_SPEED_MODE,
-        .channel = LEDC_CHANNEL_0,
-        .timer_sel = LEDC_TIMER_0,
-        .duty = 512, // 50% duty (range 0-1023)
+        .speed_mode = BUZZER_MODE,
+        .channel = BUZZER_CHANNEL,
+        .timer_sel = BUZZER_TIMER,
+        .duty = 0, // silent until a cue plays
         .hpoint = 0};
     ledc_channel_config(&ledc_channel);
+    ledc_fade_func_install(0);
+
+    pattern_player_init(&player);
+    esp_timer_create_args_t step_args = {.callback = next_step, .name = "buzzer"};
+    ESP_ERROR_CHECK(esp_timer_create(&step_args, &step_timer));
 }
 
-static void turn_on_buzzer(void)
+bool buzzer_play(const pattern_t *pattern)
 {
-    ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 512); // Set duty to 50%
-    ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
+    taskENTER_CRITICAL(&player_lock);
+    bool idle = pattern_is_idle(&player);
+    bool queued = pattern_play(&player, pattern);
+    taskEXIT_CRITICAL(&player_lock);
+    if (queued && idle)
+        esp_timer_start_once(step_timer, 0); // fails harmlessly if a step is already armed
+    return queued;
 }
 
-static void turn_off_buzzer(void)
+void buzzer_stop(void)
 {
-    ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0); // Set duty to 0%
-    ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
+    taskENTER_CRITICAL(&player_lock);
+    pattern_stop(&player);
+    taskEXIT_CRITICAL(&player_lock);
+    esp_timer_stop(step_timer);
+    esp_timer_start_once(step_timer, 0); // the output is turned off on the timer task, after a running step
 }
 
 void exec_buzzer_pattern_a(void)
 {
-    turn_on_buzzer();
-    vTaskDelay(pdMS_TO_TICKS(200));
-
-    turn_off_buzzer();
-    vTaskDelay(pdMS_TO_TICKS(200));
-
-    turn_on_buzzer();
-    vTaskDelay(pdMS_TO_TICKS(200));
-
-    turn_off_buzzer();
-    vTaskDelay(pdMS_TO_TICKS(200));
-
-    turn_on_buzzer();
-    vTaskDelay(pdMS_TO_TICKS(400));
-
-    turn_off_buzzer();
+    buzzer_play(&PATTERN_A);
 }
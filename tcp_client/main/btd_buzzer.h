@@ -0,0 +1,33 @@
+#pragma once
+#include <stdbool.h>
+#include "btd_pattern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Audio cues on the passive buzzer of GPIO 2. The board has no DAC or I2S
+// amplifier on it and I2S0 runs the PDM microphone (btd_audio.cpp), so the
+// tones are the LEDC square wave: a step sets the frequency and the duty, a
+// fade step ramps the duty in hardware. The microphone hears the cues, see
+// audio_ignore().
+
+void init_buzzer(void);
+
+/*
+    In: pattern, usually one of the CUE_ of btd_pattern.h
+    Out: false if PATTERN_QUEUE_LEN patterns are already waiting
+    returns at once, the cue plays on the esp_timer task after the queued ones
+*/
+bool buzzer_play(const pattern_t *pattern);
+
+/*
+    stops the playing cue and drops the queued ones
+*/
+void buzzer_stop(void);
+
+void exec_buzzer_pattern_a(void); // buzzer_play(&PATTERN_A)
+
+#ifdef __cplusplus
+}
+#endif
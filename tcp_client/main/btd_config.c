@@ -1,58 +1,300 @@
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "btd_config.h"
 
 #define NVS_NAMESPACE "btd_cfg"
-#define NVS_KEY "config"
+#define NVS_KEY "cfg"           // tagged encoding, see below
+#define NVS_KEY_LEGACY "config" // raw btd_config_v0_t, migrated on first read
+
+// Stored encoding: magic, schema version, then one record per field:
+// tag (1 byte), length (1 byte), value (little endian).
+// Fields that have no record get their default from DEFAULT_CONFIG, so adding a
+// field only needs a new tag. Records with unknown tags were written by a newer
+// firmware; they are skipped when decoding and written back unchanged on save.
+// Tags are never reused; a field whose meaning changes gets a new tag, or a
+// conversion in migrate() based on the stored schema version.
+#define CONFIG_MAGIC 0xB7
+#define CONFIG_VERSION 1
+#define CONFIG_MAX_SIZE 128
+#define CONFIG_HEADER_SIZE 2
+
+// layout of the raw struct blob written by earlier firmware, frozen
+typedef struct
+{
+    uint16_t workTimeSeconds;
+    uint16_t breakTimeSeconds;
+    uint16_t longBreakTimeSeconds;
+    uint16_t longBreakSessionCount;
+    uint16_t timeoutSeconds;
+    bool breakGestureEnabled;
+} btd_config_v0_t;
+
+typedef enum
+{
+    TAG_WORK_TIME = 1,
+    TAG_BREAK_TIME = 2,
+    TAG_LONG_BREAK_TIME = 3,
+    TAG_LONG_BREAK_SESSIONS = 4,
+    TAG_TIMEOUT = 5,
+    TAG_BREAK_GESTURE = 6,
+} config_tag_t;
+
+typedef struct
+{
+    uint8_t tag;
+    uint8_t size; // 2 for uint16_t, 1 for bool
+    uint16_t offset;
+} config_record_t;
+
+#define RECORD(tag, field) {tag, sizeof(((btd_config_t *)0)->field), offsetof(btd_config_t, field)}
+
+static const config_record_t records[] = {
+    RECORD(TAG_WORK_TIME, workTimeSeconds),
+    RECORD(TAG_BREAK_TIME, breakTimeSeconds),
+    RECORD(TAG_LONG_BREAK_TIME, longBreakTimeSeconds),
+    RECORD(TAG_LONG_BREAK_SESSIONS, longBreakSessionCount),
+    RECORD(TAG_TIMEOUT, timeoutSeconds),
+    RECORD(TAG_BREAK_GESTURE, breakGestureEnabled),
+};
+
+#define RECORD_COUNT (sizeof(records) / sizeof(records[0]))
+#define KNOWN_SIZE (CONFIG_HEADER_SIZE + 2 * RECORD_COUNT + sizeof(btd_config_t)) // upper bound of the encoded known fields
 
 static const char *TAG = "BTD_CONFIG";
 
-esp_err_t btd_read_config(btd_config_t *config)
+// decoded config, NVS is only read once per boot
+static btd_config_t cache;
+static bool cache_valid = false;
+// records of newer firmware, kept for the next save
+static uint8_t unknown_records[CONFIG_MAX_SIZE];
+static size_t unknown_len = 0;
+static SemaphoreHandle_t config_mutex = NULL;
+
+void config_init(void)
 {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    config_mutex = xSemaphoreCreateMutex();
+}
 
-    if (err == ESP_ERR_NVS_NOT_FOUND)
+static void lock(void)
+{
+    xSemaphoreTake(config_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(config_mutex);
+}
+
+static const config_record_t *find_record(uint8_t tag)
+{
+    for (size_t i = 0; i < RECORD_COUNT; i++)
     {
-        nvs_close(handle);
-        ESP_LOGI(TAG, "No configuration found, using defaults.");
-        // Initialize config with default values
-        memcpy(config, &DEFAULT_CONFIG, sizeof(btd_config_t));
-        return btd_save_config(config);
+        if (records[i].tag == tag)
+            return &records[i];
     }
-    ESP_ERROR_CHECK(err);
+    return NULL;
+}
 
-    size_t required_size = sizeof(btd_config_t);
-    err = nvs_get_blob(handle, NVS_KEY, config, &required_size);
-    nvs_close(handle);
+static void migrate(btd_config_t *config, uint8_t from_version)
+{
+    // no conversions yet, version 1 is the first tagged schema.
+    // add them here as: if (from_version < N) { convert to schema N }
+    (void)config;
+    (void)from_version;
+}
+
+static size_t encode(const btd_config_t *config, uint8_t *out)
+{
+    size_t len = 0;
+    out[len++] = CONFIG_MAGIC;
+    out[len++] = CONFIG_VERSION;
+    for (size_t i = 0; i < RECORD_COUNT; i++)
+    {
+        const config_record_t *record = &records[i];
+        const uint8_t *value = (const uint8_t *)config + record->offset;
+        out[len++] = record->tag;
+        out[len++] = record->size;
+        if (record->size == 1)
+        {
+            out[len++] = *(const bool *)value;
+        }
+        else
+        {
+            uint16_t field = *(const uint16_t *)value;
+            out[len++] = field & 0xFF;
+            out[len++] = field >> 8;
+        }
+    }
+    memcpy(out + len, unknown_records, unknown_len);
+    return len + unknown_len;
+}
+
+static esp_err_t decode(const uint8_t *data, size_t len, btd_config_t *config)
+{
+    if (len < CONFIG_HEADER_SIZE || data[0] != CONFIG_MAGIC)
+        return ESP_ERR_INVALID_STATE;
+    uint8_t version = data[1];
+
+    memcpy(config, &DEFAULT_CONFIG, sizeof(btd_config_t));
+    unknown_len = 0;
+    size_t pos = CONFIG_HEADER_SIZE;
+    while (pos + 2 <= len)
+    {
+        uint8_t tag = data[pos];
+        uint8_t size = data[pos + 1];
+        if (pos + 2 + size > len)
+            return ESP_ERR_INVALID_SIZE;
+
+        const uint8_t *value = data + pos + 2;
+        const config_record_t *record = find_record(tag);
+        if (record == NULL)
+        {
+            if (KNOWN_SIZE + unknown_len + 2 + size <= CONFIG_MAX_SIZE)
+            {
+                memcpy(unknown_records + unknown_len, data + pos, 2 + size);
+                unknown_len += 2 + size;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "No room to keep unknown field %u", tag);
+            }
+        }
+        else if (record->size != size)
+        {
+            ESP_LOGW(TAG, "Field %u has %u bytes instead of %u, using the default", tag, size, record->size);
+        }
+        else if (size == 1)
+        {
+            *(bool *)((uint8_t *)config + record->offset) = value[0] != 0;
+        }
+        else
+        {
+            *(uint16_t *)((uint8_t *)config + record->offset) = value[0] | (value[1] << 8);
+        }
+        pos += 2 + size;
+    }
+    if (pos != len)
+        return ESP_ERR_INVALID_SIZE;
+
+    if (version < CONFIG_VERSION)
+        migrate(config, version);
+    else if (version > CONFIG_VERSION)
+        ESP_LOGW(TAG, "Configuration schema %u is newer than %u, %u bytes of unknown fields kept",
+                 version, CONFIG_VERSION, (unsigned)unknown_len);
+    return ESP_OK;
+}
+
+static esp_err_t write_config(nvs_handle_t handle, const btd_config_t *config)
+{
+    uint8_t data[CONFIG_MAX_SIZE];
+    size_t len = encode(config, data);
+    esp_err_t err = nvs_set_blob(handle, NVS_KEY, data, len);
+    if (err == ESP_OK)
+        err = nvs_commit(handle);
     return err;
 }
 
-esp_err_t btd_save_config(const btd_config_t *config)
+// reads the stored config into the cache, called with the lock held
+static esp_err_t load_config(void)
 {
     nvs_handle_t handle;
-
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK)
         return err;
 
-    err = nvs_set_blob(handle, NVS_KEY, config, sizeof(btd_config_t));
+    uint8_t data[CONFIG_MAX_SIZE];
+    size_t len = sizeof(data);
+    err = nvs_get_blob(handle, NVS_KEY, data, &len);
     if (err == ESP_OK)
-        err = nvs_commit(handle);
+    {
+        err = decode(data, len, &cache);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Stored configuration is corrupted (%s), using defaults", esp_err_to_name(err));
+            memcpy(&cache, &DEFAULT_CONFIG, sizeof(btd_config_t));
+            unknown_len = 0;
+            err = write_config(handle, &cache);
+        }
+    }
+    else if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        btd_config_v0_t legacy;
+        size_t legacy_len = sizeof(legacy);
+        memcpy(&cache, &DEFAULT_CONFIG, sizeof(btd_config_t));
+        unknown_len = 0;
+
+        if (nvs_get_blob(handle, NVS_KEY_LEGACY, &legacy, &legacy_len) == ESP_OK && legacy_len == sizeof(legacy))
+        {
+            cache.workTimeSeconds = legacy.workTimeSeconds;
+            cache.breakTimeSeconds = legacy.breakTimeSeconds;
+            cache.longBreakTimeSeconds = legacy.longBreakTimeSeconds;
+            cache.longBreakSessionCount = legacy.longBreakSessionCount;
+            cache.timeoutSeconds = legacy.timeoutSeconds;
+            cache.breakGestureEnabled = legacy.breakGestureEnabled;
+            migrate(&cache, 0);
+            ESP_LOGI(TAG, "Migrating the configuration from the raw struct blob");
+        }
+        else
+        {
+            ESP_LOGI(TAG, "No configuration found, using defaults.");
+        }
 
+        err = write_config(handle, &cache);
+        if (err == ESP_OK)
+            nvs_erase_key(handle, NVS_KEY_LEGACY); // fails harmlessly if there was none
+    }
     nvs_close(handle);
+
+    cache_valid = err == ESP_OK;
+    return err;
+}
+
+esp_err_t btd_read_config(btd_config_t *config)
+{
+    lock();
+    esp_err_t err = cache_valid ? ESP_OK : load_config();
+    if (err == ESP_OK)
+        memcpy(config, &cache, sizeof(btd_config_t));
+    unlock();
+    return err;
+}
+
+esp_err_t btd_save_config(const btd_config_t *config)
+{
+    nvs_handle_t handle;
+
+    lock();
+    if (!cache_valid)
+        load_config(); // picks up fields of newer firmware, so they survive the save
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK)
+    {
+        err = write_config(handle, config);
+        nvs_close(handle);
+    }
+    if (err == ESP_OK)
+    {
+        memcpy(&cache, config, sizeof(btd_config_t));
+        cache_valid = true;
+    }
+    unlock();
     return err;
 }
 
 esp_err_t btd_delete_config(void)
 {
+    lock();
+    cache_valid = false;
+    unknown_len = 0;
+    unlock();
     ESP_ERROR_CHECK(nvs_flash_erase()); // Erase NVS to reset configuration
     return nvs_flash_init(); // Reinitialize NVS
 }
-
@@ -21,11 +21,20 @@ static const btd_config_t DEFAULT_CONFIG = {
     .breakGestureEnabled = true           // Break gesture enabled by default
 };
 
+/*
+* @brief Creates the lock of the config cache.
+*
+* Call once from init(), before any task reads or saves the config.
+*/
+void config_init(void);
+
 /*
 * @brief Reads the configuration from NVS.
 * 
 * This function reads the configuration from the NVS storage. If no configuration is found,
-* it initializes the config with default values and saves it.
+* it initializes the config with default values and saves it. Fields missing in the stored
+* config get their value from DEFAULT_CONFIG, a config in the old raw struct format is migrated.
+* The config is cached in RAM, NVS is only read on the first call.
 * 
 * @param config Pointer to the btd_config_t structure to store the configuration.
 * @return ESP_OK on success, or an error code on failure.
@@ -35,7 +44,7 @@ esp_err_t btd_read_config(btd_config_t *config);
 /*
 * @brief Saves the configuration to NVS.
 * 
-* This function saves the provided configuration to the NVS storage.
+* This function saves the provided configuration to the NVS storage and the RAM cache.
 * @param config Pointer to the btd_config_t structure containing the configuration to save.
 * @return ESP_OK on success, or an error code on failure.
 */
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "btd_config_json.h"
+
+#define MAX_DEPTH 16 // of nested values in unknown fields
+
+typedef enum
+{
+    FIELD_U16,
+    FIELD_BOOL,
+} field_type_t;
+
+typedef struct
+{
+    const char *name;
+    uint8_t name_len;
+    field_type_t type;
+    uint16_t offset;
+    uint16_t min;
+    uint16_t max;
+} config_field_t;
+
+#define U16_FIELD(field, lo, hi) {#field, sizeof(#field) - 1, FIELD_U16, offsetof(btd_config_t, field), lo, hi}
+#define BOOL_FIELD(field) {#field, sizeof(#field) - 1, FIELD_BOOL, offsetof(btd_config_t, field), 0, 1}
+
+// the JSON names are the field names of btd_config_t
+static const config_field_t fields[] = {
+    U16_FIELD(workTimeSeconds, 10, 4 * 60 * 60),
+    U16_FIELD(breakTimeSeconds, 10, 60 * 60),
+    U16_FIELD(longBreakTimeSeconds, 10, 2 * 60 * 60),
+    U16_FIELD(longBreakSessionCount, 1, 20),
+    U16_FIELD(timeoutSeconds, 0, 60 * 60), // 0 = no timeout
+    BOOL_FIELD(breakGestureEnabled),
+};
+
+#define FIELD_COUNT (sizeof(fields) / sizeof(fields[0]))
+
+typedef struct
+{
+    const char *start;
+    const char *p;
+    const char *end;
+    char *error;
+} reader_t;
+
+static bool fail(reader_t *r, const char *format, ...)
+{
+    if (r->error)
+    {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(r->error, CONFIG_JSON_ERROR_LEN, format, args);
+        va_end(args);
+    }
+    return false;
+}
+
+static bool fail_syntax(reader_t *r)
+{
+    if (r->p >= r->end)
+        return fail(r, "unexpected end of json");
+    return fail(r, "invalid json at offset %d", (int)(r->p - r->start));
+}
+
+static void skip_whitespace(reader_t *r)
+{
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r'))
+        r->p++;
+}
+
+static bool consume(reader_t *r, char c)
+{
+    skip_whitespace(r);
+    if (r->p >= r->end || *r->p != c)
+        return false;
+    r->p++;
+    return true;
+}
+
+// string at r->p, out gets the raw bytes between the quotes
+static bool read_string(reader_t *r, const char **out, size_t *len)
+{
+    if (r->p >= r->end || *r->p != '"')
+        return fail_syntax(r);
+    const char *start = ++r->p;
+    while (r->p < r->end && *r->p != '"')
+    {
+        if ((unsigned char)*r->p < 0x20)
+            return fail_syntax(r);
+        if (*r->p == '\\')
+            r->p++; // the escaped character can not end the string
+        r->p++;
+    }
+    if (r->p >= r->end)
+        return fail_syntax(r);
+    *out = start;
+    *len = r->p - start;
+    r->p++;
+    return true;
+}
+
+static bool is_literal_char(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+// skips the value of an unknown field, brackets are checked, literals are not
+static bool skip_value(reader_t *r)
+{
+    uint16_t is_array = 0; // one bit per nesting level
+    int depth = 0;
+    do
+    {
+        skip_whitespace(r);
+        if (r->p >= r->end)
+            return fail_syntax(r);
+
+        char c = *r->p;
+        if (c == '"')
+        {
+            const char *string;
+            size_t len;
+            if (!read_string(r, &string, &len))
+                return false;
+        }
+        else if (c == '{' || c == '[')
+        {
+            if (depth == MAX_DEPTH)
+                return fail(r, "json nested too deep");
+            is_array = (is_array << 1) | (c == '[');
+            depth++;
+            r->p++;
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (depth == 0 || (is_array & 1) != (c == ']'))
+                return fail_syntax(r);
+            is_array >>= 1;
+            depth--;
+            r->p++;
+        }
+        else if ((c == ',' || c == ':') && depth > 0)
+        {
+            r->p++;
+        }
+        else if (is_literal_char(c))
+        {
+            while (r->p < r->end && is_literal_char(*r->p))
+                r->p++;
+        }
+        else
+        {
+            return fail_syntax(r);
+        }
+    } while (depth > 0);
+    return true;
+}
+
+static bool read_literal(reader_t *r, const char *literal)
+{
+    size_t len = strlen(literal);
+    if ((size_t)(r->end - r->p) < len || memcmp(r->p, literal, len) != 0)
+        return false;
+    r->p += len;
+    return true;
+}
+
+static bool read_field(reader_t *r, const config_field_t *field, btd_config_t *config)
+{
+    uint8_t *target = (uint8_t *)config + field->offset;
+    skip_whitespace(r);
+
+    if (field->type == FIELD_BOOL)
+    {
+        if (read_literal(r, "true"))
+            *(bool *)target = true;
+        else if (read_literal(r, "false"))
+            *(bool *)target = false;
+        else
+            return fail(r, "%s must be true or false", field->name);
+        return true;
+    }
+
+    bool negative = r->p < r->end && *r->p == '-';
+    if (negative)
+        r->p++;
+    if (r->p >= r->end || *r->p < '0' || *r->p > '9')
+        return fail(r, "%s must be a number", field->name);
+
+    uint32_t value = 0;
+    while (r->p < r->end && *r->p >= '0' && *r->p <= '9')
+    {
+        if (value <= 0xFFFFFF)
+            value = value * 10 + (*r->p - '0'); // larger values are out of range anyway
+        r->p++;
+    }
+    if (r->p < r->end && (*r->p == '.' || *r->p == 'e' || *r->p == 'E'))
+        return fail(r, "%s must be an integer", field->name);
+    if ((negative && value > 0) || value < field->min || value > field->max)
+        return fail(r, "%s must be %u..%u", field->name, field->min, field->max);
+
+    *(uint16_t *)target = value;
+    return true;
+}
+
+static const config_field_t *find_field(const char *name, size_t len)
+{
+    for (size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        if (fields[i].name_len == len && memcmp(fields[i].name, name, len) == 0)
+            return &fields[i];
+    }
+    return NULL;
+}
+
+static bool read_object(reader_t *r, btd_config_t *config)
+{
+    if (!consume(r, '{'))
+        return fail_syntax(r);
+    if (consume(r, '}'))
+        return true;
+
+    do
+    {
+        const char *key;
+        size_t key_len;
+        skip_whitespace(r);
+        if (!read_string(r, &key, &key_len))
+            return false;
+        if (!consume(r, ':'))
+            return fail_syntax(r);
+
+        const config_field_t *field = find_field(key, key_len);
+        if (field ? !read_field(r, field, config) : !skip_value(r))
+            return false;
+    } while (consume(r, ','));
+
+    if (!consume(r, '}'))
+        return fail_syntax(r);
+    return true;
+}
+
+esp_err_t config_json_parse(const char *json, size_t len, btd_config_t *config, char *error)
+{
+    reader_t r = {.start = json, .p = json, .end = json + len, .error = error};
+    btd_config_t updated;
+    memcpy(&updated, config, sizeof(btd_config_t));
+
+    if (!read_object(&r, &updated))
+        return ESP_ERR_INVALID_ARG;
+    skip_whitespace(&r);
+    if (r.p != r.end)
+    {
+        fail_syntax(&r);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(config, &updated, sizeof(btd_config_t));
+    return ESP_OK;
+}
+
+typedef struct
+{
+    char *p;
+    char *end;
+} writer_t;
+
+static void write_bytes(writer_t *w, const char *data, size_t len)
+{
+    if (w->p > w->end || (size_t)(w->end - w->p) < len)
+    {
+        w->p = w->end + 1; // marks the overflow
+        return;
+    }
+    memcpy(w->p, data, len);
+    w->p += len;
+}
+
+static void write_u16(writer_t *w, uint16_t value)
+{
+    char digits[5];
+    int count = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    write_bytes(w, digits + sizeof(digits) - count, count);
+}
+
+size_t config_json_write(const btd_config_t *config, char *out, size_t size)
+{
+    if (size == 0)
+        return 0;
+    writer_t w = {.p = out, .end = out + size - 1}; // room for the terminator
+
+    for (size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        const config_field_t *field = &fields[i];
+        const uint8_t *source = (const uint8_t *)config + field->offset;
+
+        write_bytes(&w, i == 0 ? "{\"" : ",\"", 2);
+        write_bytes(&w, field->name, field->name_len);
+        write_bytes(&w, "\":", 2);
+        if (field->type == FIELD_BOOL)
+        {
+            if (*(const bool *)source)
+                write_bytes(&w, "true", 4);
+            else
+                write_bytes(&w, "false", 5);
+        }
+        else
+        {
+            write_u16(&w, *(const uint16_t *)source);
+        }
+    }
+    write_bytes(&w, "}", 1);
+
+    if (w.p > w.end)
+        return 0;
+    *w.p = '\0';
+    return w.p - out;
+}
@@ -0,0 +1,43 @@
+#ifndef BTD_CONFIG_JSON_H
+#define BTD_CONFIG_JSON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#include "btd_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// JSON reader and writer for btd_config_t, driven by the field table in
+// btd_config_json.c (name, type, offset, range). Works on the caller's buffers
+// and never allocates.
+// The reader takes one object of the known fields. Fields that are missing keep
+// their value (partial update), unknown fields are skipped. Nothing is written
+// to the config unless the whole object is valid. Keys are compared as written,
+// escape sequences in keys are not decoded.
+
+#define CONFIG_JSON_MAX_LEN 512 // longest request body accepted by the config server
+#define CONFIG_JSON_ERROR_LEN 64
+
+/*
+    In: json text of len bytes (does not need to be terminated), config with the current values
+    Out: ESP_OK with config updated, or ESP_ERR_INVALID_ARG with config unchanged and
+    a message in error (at least CONFIG_JSON_ERROR_LEN bytes, may be NULL)
+*/
+esp_err_t config_json_parse(const char *json, size_t len, btd_config_t *config, char *error);
+
+/*
+    In: config and output buffer
+    Out: length of the terminated json object in out, or 0 if size is too small
+*/
+size_t config_json_write(const btd_config_t *config, char *out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_CONFIG_JSON_H
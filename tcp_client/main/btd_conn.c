@@ -0,0 +1,344 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <arpa/inet.h>
+
+#include "esp_log.h"
+
+#include "btd_conn.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define CONNECT_TIMEOUT_MS 3000
+#define HANDSHAKE_TIMEOUT_MS 3000
+
+static const char *TAG = "BTD_CONN";
+
+static void put_u16(uint8_t *buf, uint16_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        buf[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint32_t next_random(btd_conn_t *conn)
+{
+    // xorshift32
+    uint32_t x = conn->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    conn->rng = x;
+    return x;
+}
+
+void conn_init(btd_conn_t *conn, btd_conn_record_t *records, size_t capacity,
+               const char *host, int port, uint32_t session_id, uint32_t seed)
+{
+    memset(conn, 0, sizeof(btd_conn_t));
+    strncpy(conn->host, host, sizeof(conn->host) - 1);
+    conn->port = port;
+    conn->session_id = session_id;
+    conn->backoff_min_ms = 500;
+    conn->backoff_max_ms = 30000;
+    conn->state = CONN_DISCONNECTED;
+    conn->sock = -1;
+    conn->rng = seed ? seed : 0x2545F491;
+    conn->records = records;
+    conn->capacity = capacity;
+}
+
+void conn_set_backoff(btd_conn_t *conn, uint32_t min_ms, uint32_t max_ms)
+{
+    conn->backoff_min_ms = min_ms;
+    conn->backoff_max_ms = max_ms > min_ms ? max_ms : min_ms;
+}
+
+size_t conn_pending(const btd_conn_t *conn)
+{
+    return conn->next_seq - conn->first_seq;
+}
+
+esp_err_t conn_submit(btd_conn_t *conn, const void *data, size_t len)
+{
+    if (len > BTD_CONN_MAX_PAYLOAD)
+        return ESP_ERR_INVALID_SIZE;
+
+    if (conn_pending(conn) == conn->capacity)
+    {
+        conn->first_seq++;
+        conn->dropped_records++;
+        if ((int32_t)(conn->send_seq - conn->first_seq) < 0)
+            conn->send_seq = conn->first_seq;
+    }
+
+    btd_conn_record_t *record = &conn->records[conn->next_seq % conn->capacity];
+    record->seq = conn->next_seq++;
+    record->len = len;
+    memcpy(record->data, data, len);
+    return ESP_OK;
+}
+
+void conn_close(btd_conn_t *conn)
+{
+    if (conn->sock >= 0)
+    {
+        shutdown(conn->sock, SHUT_RDWR);
+        close(conn->sock);
+    }
+    conn->sock = -1;
+    conn->rx_len = 0;
+    conn->tx_len = 0;
+    conn->tx_sent = 0;
+    conn->state = CONN_DISCONNECTED;
+}
+
+static void schedule_reconnect(btd_conn_t *conn, int64_t now_ms)
+{
+    if (conn->state == CONN_HANDSHAKE || conn->state == CONN_ONLINE)
+        conn->disconnects++;
+    conn_close(conn);
+
+    // exponential backoff with "equal jitter": wait between backoff/2 and backoff
+    if (conn->backoff_ms == 0)
+        conn->backoff_ms = conn->backoff_min_ms;
+    else if (conn->backoff_ms < conn->backoff_max_ms / 2)
+        conn->backoff_ms *= 2;
+    else
+        conn->backoff_ms = conn->backoff_max_ms;
+
+    uint32_t half = conn->backoff_ms / 2;
+    uint32_t delay = half + next_random(conn) % (half + 1);
+    conn->next_attempt_ms = now_ms + delay;
+    ESP_LOGW(TAG, "Disconnected, %u records pending, retrying in %u ms",
+             (unsigned)conn_pending(conn), (unsigned)delay);
+}
+
+// sends as much of the pending frame as the socket takes, returns false if the connection is gone
+static bool flush_tx(btd_conn_t *conn, int64_t now_ms)
+{
+    while (conn->tx_sent < conn->tx_len)
+    {
+        int sent = send(conn->sock, conn->tx + conn->tx_sent, conn->tx_len - conn->tx_sent, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true; // the socket buffer is full, the rest goes out on a later poll
+            ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+            schedule_reconnect(conn, now_ms);
+            return false;
+        }
+        conn->tx_sent += sent;
+    }
+    conn->tx_len = 0;
+    conn->tx_sent = 0;
+    return true;
+}
+
+// the frame goes out with the next flush_tx(), the tx buffer has to be empty
+static void queue_frame(btd_conn_t *conn, uint8_t type, uint32_t seq, const uint8_t *payload, size_t len)
+{
+    conn->tx[0] = type;
+    conn->tx[1] = 0;
+    put_u16(&conn->tx[2], len);
+    put_u32(&conn->tx[4], seq);
+    memcpy(&conn->tx[BTD_CONN_FRAME_HEADER], payload, len);
+    conn->tx_len = BTD_CONN_FRAME_HEADER + len;
+    conn->tx_sent = 0;
+}
+
+static void start_connect(btd_conn_t *conn, int64_t now_ms)
+{
+    struct sockaddr_in dest_addr;
+    memset(&dest_addr, 0, sizeof(dest_addr));
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(conn->port);
+    if (inet_pton(AF_INET, conn->host, &dest_addr.sin_addr) != 1)
+    {
+        ESP_LOGE(TAG, "Invalid IP address format");
+        schedule_reconnect(conn, now_ms);
+        return;
+    }
+
+    conn->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (conn->sock < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        schedule_reconnect(conn, now_ms);
+        return;
+    }
+
+    // connect in the background, conn_poll() checks for completion
+    fcntl(conn->sock, F_SETFL, fcntl(conn->sock, F_GETFL, 0) | O_NONBLOCK);
+    int err = connect(conn->sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    if (err != 0 && errno != EINPROGRESS)
+    {
+        ESP_LOGE(TAG, "Socket unable to connect: errno %d", errno);
+        schedule_reconnect(conn, now_ms);
+        return;
+    }
+
+    conn->state = CONN_CONNECTING;
+    conn->deadline_ms = now_ms + CONNECT_TIMEOUT_MS;
+}
+
+static bool connect_finished(btd_conn_t *conn, int64_t now_ms)
+{
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(conn->sock, &writable);
+    struct timeval no_wait = {0, 0};
+
+    if (select(conn->sock + 1, NULL, &writable, NULL, &no_wait) <= 0)
+    {
+        if (now_ms >= conn->deadline_ms)
+        {
+            ESP_LOGE(TAG, "Connect to %s:%d timed out", conn->host, conn->port);
+            schedule_reconnect(conn, now_ms);
+        }
+        return false;
+    }
+
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    getsockopt(conn->sock, SOL_SOCKET, SO_ERROR, &error, &error_len);
+    if (error != 0)
+    {
+        ESP_LOGE(TAG, "Socket unable to connect: errno %d", error);
+        schedule_reconnect(conn, now_ms);
+        return false;
+    }
+
+    // the socket stays non-blocking, a frame that does not fit is finished by a later poll
+    return true;
+}
+
+static void acknowledge(btd_conn_t *conn, uint32_t ack_seq)
+{
+    // ignore acks outside of the pending window
+    if ((int32_t)(ack_seq - conn->first_seq) <= 0 || (int32_t)(ack_seq - conn->next_seq) > 0)
+        return;
+    conn->first_seq = ack_seq;
+    if ((int32_t)(conn->send_seq - ack_seq) < 0)
+        conn->send_seq = ack_seq;
+}
+
+// reads all available server frames, returns false if the connection is gone
+static bool receive_frames(btd_conn_t *conn, int64_t now_ms)
+{
+    while (1)
+    {
+        int len = recv(conn->sock, conn->rx + conn->rx_len, sizeof(conn->rx) - conn->rx_len, MSG_DONTWAIT);
+        if (len == 0)
+        {
+            ESP_LOGW(TAG, "Connection closed by server");
+            schedule_reconnect(conn, now_ms);
+            return false;
+        }
+        if (len < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return true;
+            ESP_LOGE(TAG, "recv failed: errno %d", errno);
+            schedule_reconnect(conn, now_ms);
+            return false;
+        }
+        conn->rx_len += len;
+
+        while (conn->rx_len >= BTD_CONN_FRAME_HEADER)
+        {
+            uint8_t type = conn->rx[0];
+            uint16_t payload_len = conn->rx[2] | (conn->rx[3] << 8);
+            uint32_t seq = get_u32(&conn->rx[4]);
+            if (payload_len != 0 || (type != BTD_CONN_FRAME_ACK && type != BTD_CONN_FRAME_RESUME))
+            {
+                ESP_LOGE(TAG, "Unexpected frame type %d from server", type);
+                schedule_reconnect(conn, now_ms);
+                return false;
+            }
+            conn->rx_len -= BTD_CONN_FRAME_HEADER;
+            memmove(conn->rx, conn->rx + BTD_CONN_FRAME_HEADER, conn->rx_len);
+
+            if (type == BTD_CONN_FRAME_RESUME && conn->state == CONN_HANDSHAKE)
+            {
+                acknowledge(conn, seq);
+                // records sent on the old connection that the server never got
+                if ((int32_t)(conn->send_seq - conn->first_seq) > 0)
+                    conn->replayed_records += conn->send_seq - conn->first_seq;
+                conn->send_seq = conn->first_seq;
+                conn->state = CONN_ONLINE;
+                conn->backoff_ms = 0;
+                conn->connects++;
+                ESP_LOGI(TAG, "Session %u resumed at seq %u, replaying %u records",
+                         (unsigned)conn->session_id, (unsigned)conn->first_seq, (unsigned)conn_pending(conn));
+            }
+            else if (type == BTD_CONN_FRAME_ACK && conn->state == CONN_ONLINE)
+            {
+                acknowledge(conn, seq);
+            }
+        }
+    }
+}
+
+void conn_poll(btd_conn_t *conn, int64_t now_ms)
+{
+    switch (conn->state)
+    {
+    case CONN_DISCONNECTED:
+        if (now_ms >= conn->next_attempt_ms)
+            start_connect(conn, now_ms);
+        return;
+
+    case CONN_CONNECTING:
+        if (!connect_finished(conn, now_ms))
+            return;
+        {
+            uint8_t session[4];
+            put_u32(session, conn->session_id);
+            queue_frame(conn, BTD_CONN_FRAME_HELLO, conn->first_seq, session, sizeof(session));
+        }
+        conn->state = CONN_HANDSHAKE;
+        conn->deadline_ms = now_ms + HANDSHAKE_TIMEOUT_MS;
+        flush_tx(conn, now_ms);
+        return;
+
+    case CONN_HANDSHAKE:
+        if (!flush_tx(conn, now_ms) || !receive_frames(conn, now_ms))
+            return;
+        if (conn->state == CONN_HANDSHAKE && now_ms >= conn->deadline_ms)
+        {
+            ESP_LOGE(TAG, "No resume from server");
+            schedule_reconnect(conn, now_ms);
+        }
+        return;
+
+    case CONN_ONLINE:
+        if (!receive_frames(conn, now_ms))
+            return;
+        // fill the socket buffer, a frame in tx is a copy, conn_submit() may drop its record meanwhile
+        while (flush_tx(conn, now_ms) && conn->tx_len == 0 && conn->send_seq != conn->next_seq)
+        {
+            const btd_conn_record_t *record = &conn->records[conn->send_seq % conn->capacity];
+            queue_frame(conn, BTD_CONN_FRAME_DATA, record->seq, record->data, record->len);
+            conn->send_seq++;
+        }
+        return;
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef BTD_CONN_H
+#define BTD_CONN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reconnecting TCP record stream with a bounded resend buffer.
+//
+// Every frame starts with an 8 byte header (little endian):
+//   uint8 type, uint8 flags (0), uint16 payload length, uint32 sequence number
+//
+// client -> server  'H' hello:  seq = last acknowledged seq, payload = uint32 session id
+// server -> client  'R' resume: seq = next seq the server expects for this session
+// client -> server  'D' data:   seq = record seq, payload = record
+// server -> client  'A' ack:    seq = next seq the server expects (cumulative)
+//
+// Records stay in the resend buffer until they are acknowledged. After a
+// reconnect everything from the resume seq on is sent again. When the buffer
+// is full the oldest record is dropped and the server sees a gap.
+
+#define BTD_CONN_MAX_PAYLOAD 128
+#define BTD_CONN_FRAME_HEADER 8
+
+#define BTD_CONN_FRAME_HELLO 'H'
+#define BTD_CONN_FRAME_RESUME 'R'
+#define BTD_CONN_FRAME_DATA 'D'
+#define BTD_CONN_FRAME_ACK 'A'
+
+typedef enum
+{
+    CONN_DISCONNECTED,
+    CONN_CONNECTING,
+    CONN_HANDSHAKE,
+    CONN_ONLINE,
+} btd_conn_state_t;
+
+typedef struct
+{
+    uint32_t seq;
+    uint16_t len;
+    uint8_t data[BTD_CONN_MAX_PAYLOAD];
+} btd_conn_record_t;
+
+typedef struct
+{
+    // configuration
+    char host[40];
+    int port;
+    uint32_t session_id;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+
+    // connection
+    btd_conn_state_t state;
+    int sock;
+    int64_t deadline_ms;     // timeout of the current connect or handshake
+    int64_t next_attempt_ms; // earliest time of the next connect
+    uint32_t backoff_ms;     // 0 until the first failure
+    uint32_t rng;            // xorshift state for the backoff jitter
+    uint8_t rx[32];
+    size_t rx_len;
+    uint8_t tx[BTD_CONN_FRAME_HEADER + BTD_CONN_MAX_PAYLOAD]; // frame the socket did not take yet
+    size_t tx_len;
+    size_t tx_sent;
+
+    // resend buffer, record seq lives at records[seq % capacity]
+    btd_conn_record_t *records;
+    size_t capacity;
+    uint32_t first_seq; // oldest unacknowledged record
+    uint32_t send_seq;  // next record to copy to tx on the current connection
+    uint32_t next_seq;  // seq of the next submitted record
+
+    // statistics
+    uint32_t connects;
+    uint32_t disconnects; // established connections that were lost
+    uint32_t dropped_records;
+    uint32_t replayed_records;
+} btd_conn_t;
+
+/*
+    In: connection, caller provided record storage, server address, session id and a random seed
+    The storage is used as the resend buffer, no memory is allocated.
+*/
+void conn_init(btd_conn_t *conn, btd_conn_record_t *records, size_t capacity,
+               const char *host, int port, uint32_t session_id, uint32_t seed);
+
+/*
+    In: min and max reconnect delay, the delay doubles per failed attempt and is jittered by up to 50%
+*/
+void conn_set_backoff(btd_conn_t *conn, uint32_t min_ms, uint32_t max_ms);
+
+/*
+    In: record to send
+    Out: ESP_OK, or ESP_ERR_INVALID_SIZE if the record is larger than BTD_CONN_MAX_PAYLOAD.
+    Queues the record, the oldest unacknowledged record is dropped if the buffer is full.
+*/
+esp_err_t conn_submit(btd_conn_t *conn, const void *data, size_t len);
+
+/*
+    In: current time
+    Connects, handshakes, sends queued records and processes acks without
+    blocking, the socket is non-blocking from the connect on. Call periodically.
+*/
+void conn_poll(btd_conn_t *conn, int64_t now_ms);
+
+/*
+    Closes the connection, queued records are kept
+*/
+void conn_close(btd_conn_t *conn);
+
+/*
+    Out: number of records waiting for an acknowledgement
+*/
+size_t conn_pending(const btd_conn_t *conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_CONN_H
@@ -1,19 +1,17 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h" // FreeRTOS API
 #include "freertos/task.h"     // Task management
-#include "esp_timer.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
-#include "esp_event.h"
 #include "esp_system.h"
-#include "esp_wifi.h"
+#include "sdkconfig.h"
 
 #include "btd_vibrator.h"
+#include "btd_buzzer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
-#include "Arduino.h"
-#include "M5StickCPlus.h"
-
+#include "btd_hal.h"
 #include "btd_battery.h"
 #include "btd_display.h"
 #include "btd_imu.h"
@@ -21,6 +19,11 @@
 #include "btd_button.h"
 #include "btd_audio.h"
 #include "btd_movement.h"
+#include "btd_imulog.h"
+#include "btd_looptime.h"
+#include "btd_telemetry.h"
+#include "btd_rates.h"
+#include "btd_boot.h"
 
 extern "C"
 {
@@ -29,24 +32,28 @@ extern "C"
 #include "btd_http.h"
 #include "btd_wifi.h"
 #include "btd_stats.h"
+#include "btd_sender.h"
+#include "btd_steps.h"
+#include "btd_fusion.h"
+#include "btd_energy.h"
+#include "btd_backlight.h"
 }
 
 #define INTERVAL 400
 #define WAIT vTaskDelay(INTERVAL)
-#define SAMPLING_FREQUENCY 100
 
 static const char *TAG = "BTD_CONTROLLER";
 
-static const int DELAY_BETWEEN_SAMPLES = 1000 / SAMPLING_FREQUENCY;
-
 static btd_state_t current_state = STATE_INIT;
 
 static btd_config_t config = {0};
 static int working_sec = 0;
+static int64_t working_end_ms = 0;
 static int session_counter = 0;
 
 static int break_sec_config = 0;
 static int break_sec = 0;
+static int64_t break_end_ms = 0;
 static bool break_gesture_config = true;
 
 static int longbreak_sec_config = 0;
@@ -57,71 +64,118 @@ static int64_t session_end_time_ms = 0;
 
 SemaphoreHandle_t nvs_mutex = NULL;
 
-// Wifi handler for checking if anyone connected to AP for automatic QR code switch
-static volatile bool someone_connected = false;
+// Sec. countdown START --------------------------
+// counts down against a deadline instead of a task, so it follows the HAL clock
+static int seconds_until(int64_t end_ms)
+{
+    int64_t remaining_ms = end_ms - hal_time_ms();
+    if (remaining_ms <= 0)
+        return 0;
+    return (remaining_ms + 999) / 1000;
+}
+// Sec. countdown END --------------------------
 
-static void wifi_event_handler(void *arg, esp_event_base_t event_base,
-                               int32_t event_id, void *event_data)
+// publishes the state for the /ws telemetry stream, called once per loop iteration
+static void update_telemetry()
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED)
-    {
-        someone_connected = true;
-        ESP_LOGI(TAG, "A station connected to the AP");
-    }
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STADISCONNECTED)
+    int remaining_sec = 0;
+    if (current_state == STATE_WORKING)
+        remaining_sec = working_sec;
+    else if (current_state == STATE_BREAK)
+        remaining_sec = break_sec;
+    telemetry_set_state(current_state, remaining_sec);
+    telemetry_set_steps(get_step_count());
+    telemetry_set_battery(get_battery_percentage()); // cached by the battery task
+}
+
+// applies the backlight policy, called once per loop iteration
+static void update_backlight()
+{
+    static backlight_level_t applied = BACKLIGHT_FULL;
+    backlight_level_t level = backlight_update(hal_time_ms());
+    if (level != applied)
     {
-        someone_connected = false;
-        ESP_LOGI(TAG, "A station disconnected from the AP");
+        display_set_backlight(level);
+        energy_set_feature(ENERGY_FEATURE_DISPLAY, level != BACKLIGHT_OFF);
+        applied = level;
     }
 }
 
-// Sec. counter task START --------------------------
-TaskHandle_t break_task_handle = NULL;
-TaskHandle_t working_task_handle = NULL;
+// reads a button event, any press wakes the display
+static char read_button()
+{
+    char btn = btn_detect_press();
+    if (btn != 'X')
+        backlight_activity(hal_time_ms());
+    return btn;
+}
 
-void countdown_task(void *pvParameter)
+// records the duration of a loop stage that started at start_us, returns the end time
+static int64_t end_stage(loop_stage_t stage, int64_t start_us)
 {
-    int *seconds = (int *)pvParameter;
-    while (1)
-    {
-        if (seconds && *seconds > 0)
-        {
-            (*seconds)--;
-        }
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Wait 1 second
-    }
+    int64_t now_us = hal_time_us();
+    looptime_stage(stage, now_us - start_us);
+    return now_us;
 }
-// Sec. counter task END --------------------------
 
-void init() // pls put all your inits here
+static SemaphoreHandle_t init_io_done = NULL;
+
+// storage, sensors and detectors, runs while the main task brings up the display
+static void init_io(void *arg)
 {
-    M5.begin();
-    init_imu();
-    setup_display();
-    init_vibrator();
-    // ESP_ERROR_CHECK(nvs_flash_erase()); // IMPORTANT! Erase NVS at first startup, comment out to persist data
-    // TODO Delete in final vers
+    // ESP_ERROR_CHECK(nvs_flash_erase()); // wipes settings and sessions, firmware updates do not need it (see btd_config.c)
     ESP_ERROR_CHECK(nvs_flash_init());
-    // apparently its still needed??? even tho it errors? heck if I know
-    // but yea, dont check if it errors - it just worksTM, sorry for the hack
-    esp_event_loop_create_default();
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(
-        WIFI_EVENT,
-        ESP_EVENT_ANY_ID,
-        &wifi_event_handler,
-        NULL,
-        NULL));
+    energy_load();
+    boot_mark("nvs");
+    init_imu(); // shares Wire1 with the battery, the Arduino driver locks the bus per transfer
+    boot_mark("imu");
     init_microphone();
     init_movement_detection();
+    boot_mark("mic, detectors");
+    xSemaphoreGive(init_io_done);
+    vTaskDelete(NULL);
+}
+
+// Wi-Fi and the HTTP server are not started here, see start_http()
+void init() // pls put all your inits here
+{
+    hal_board_init();
+    energy_init();
+    config_init();
+    boot_mark("board");
     if (nvs_mutex == NULL)
     {
         nvs_mutex = xSemaphoreCreateMutex();
     }
+    imulog_init();
+    init_io_done = xSemaphoreCreateBinary();
+    xTaskCreate(init_io, "init_io", 4096, NULL, 5, NULL);
+
+    setup_display();
+    backlight_init(hal_time_ms());
+    btn_init();
+    init_vibrator();
+    init_buzzer(); // after hal_board_init(), M5.Beep attaches GPIO 2 as well
+    battery_init();
+    boot_mark("display, power");
 
+    xSemaphoreTake(init_io_done, portMAX_DELAY);
+    vSemaphoreDelete(init_io_done);
     ESP_LOGI(TAG, "inits completed");
 }
 
+/*
+    In: cue of btd_pattern.h
+    plays it without waiting, the microphone ignores it
+*/
+static void play_cue(const pattern_t *cue)
+{
+#if CONFIG_BTD_AUDIO_CUES
+    if (buzzer_play(cue))
+        audio_ignore(hal_time_ms(), pattern_duration_ms(cue));
+#endif
+}
+
 // Tests START -------------------------------------------
 void test_config()
 {
@@ -164,38 +218,58 @@ void test_display()
         display_time(test_time_sec);
         test_time_sec--;
         display_break_bar();
-        delay(1000);
+        hal_delay_ms(1000);
         clear_display();
         display_break_msg();
-        delay(1000);
+        hal_delay_ms(1000);
         clear_display();
         display_battery_percentage(get_battery_percentage());
         display_wifi_code();
-        delay(1000);
+        hal_delay_ms(1000);
     }
 }
 // Tests END -------------------------------------------
 
 // Awake state START -------------------------------------------
+static bool http_running = false;
+
+// the AP start takes a few hundred ms, so it follows the first frame of the awake screen;
+// the first start after boot completes the boot timeline
+static void start_http()
+{
+    if (http_running)
+        return;
+    bool booting = boot_mark_ms("first frame") < 0;
+    if (booting)
+        boot_mark("first frame");
+    start_http_server("ti:ma", "12345678");
+    http_running = true;
+    ESP_LOGI(TAG, "HTTP server started");
+    if (booting)
+    {
+        boot_mark("wifi");
+        boot_log();
+    }
+}
+
 void start_awake()
 {
     ESP_LOGI(TAG, "Start awake ");
     clear_display();
-    start_http_server("ti:ma", "12345678");
-    ESP_LOGI(TAG, "HTTP server started");
 }
 
 bool handle_awake()
 {
     static int awake_step = 1;
 
-    char btn = btn_detect_press();
+    char btn = read_button();
 
     if (awake_step == 1)
     {
         display_wifi_code();
         display_battery_percentage(get_battery_percentage());
-        if (someone_connected || btn == 'A')
+        start_http();
+        if (http_station_connected() || btn == 'A')
         {
             clear_display();
             display_link_code();
@@ -217,8 +291,14 @@ bool handle_awake()
 
 void stop_awake()
 {
-    stop_http_server();
-    ESP_LOGI(TAG, "HTTP server stopped");
+#if !CONFIG_BTD_HTTP_ALWAYS_ON
+    if (http_running)
+    {
+        stop_http_server();
+        http_running = false;
+        ESP_LOGI(TAG, "HTTP server stopped");
+    }
+#endif
 }
 
 // Awake state END -------------------------------------------
@@ -231,49 +311,139 @@ void start_working()
              config.workTimeSeconds, config.breakTimeSeconds, config.longBreakTimeSeconds,
              config.longBreakSessionCount, config.breakGestureEnabled);
     display_working_info_screen(get_battery_percentage());
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    // vibration_pattern_a(); TODO fix vibrations
-    session_start_time_ms = esp_timer_get_time() / 1000;
-    working_sec = config.workTimeSeconds + 1;
+    hal_delay_ms(1000);
+    vibration_pattern_a(); // returns at once, the pattern plays on the esp_timer task
+    play_cue(&CUE_WORK_START);
+    session_start_time_ms = hal_time_ms();
+    reset_auto_off(session_start_time_ms); // no movement is tracked outside of working sessions
+    working_end_ms = session_start_time_ms + (config.workTimeSeconds + 1) * 1000;
+    working_sec = seconds_until(working_end_ms);
     break_sec_config = config.breakTimeSeconds + 1;
     break_sec = break_sec_config;
     longbreak_sec_config = config.longBreakTimeSeconds + 1;
     longbreak_sess_config = config.longBreakSessionCount;
     break_gesture_config = config.breakGestureEnabled;
     session_counter++;
-    xTaskCreate(countdown_task, "working_sec_countdown", 2048, &working_sec, 5, &working_task_handle);
+    steps_session_start();
+    imulog_start();
+#if CONFIG_BTD_STREAM
+    sender_start(); // the first awake state brought up Wi-Fi
+#endif
+    resetImuSamples();
+    looptime_reset(LOOP_PERIOD_MS * 1000);
+    energy_set_feature(ENERGY_FEATURE_MIC, true);
+    backlight_set_working(true, hal_time_ms());
 }
 
 void stop_working()
 {
-    session_end_time_ms = esp_timer_get_time() / 1000;
+    imulog_stop();
+#if CONFIG_BTD_STREAM
+    sender_stop();
+#endif
+    energy_set_feature(ENERGY_FEATURE_MIC, false);
+    session_end_time_ms = hal_time_ms();
     float loud_percent = get_loud_percentage(session_start_time_ms, session_end_time_ms);
     int64_t loud_time_duration_ms = get_total_loud_duration_ms();
     ESP_LOGI(TAG, "Lautstärkeanteil in dieser Session: %.2f%%", loud_percent);             // TODO noch entfernen sobald es in der statistik ist
     ESP_LOGI(TAG, "Lautstärke dauer in dieser Session: %ld", (long)loud_time_duration_ms); // TODO noch entfernen sobald es in der statistik ist
     // TODO noch in der statistik dann anzeigen lassen...
 
+    session_stats_t stats = {0};
+    stats.duration_seconds = (session_end_time_ms - session_start_time_ms) / 1000;
+    stats.mic_level = (uint8_t)loud_percent;
+    stats.steps = steps_session_count();
+    stats.cadence_spm = steps_session_cadence();
+    int64_t now_ms = hal_time_ms();
+    stats.display_on_s = (backlight_session_ms(BACKLIGHT_FULL, now_ms) + backlight_session_ms(BACKLIGHT_DIM, now_ms)) / 1000;
+    backlight_set_working(false, now_ms);
+    if (nvs_mutex)
+        xSemaphoreTake(nvs_mutex, portMAX_DELAY);
+    esp_err_t err = record_work_session(&stats);
+    if (nvs_mutex)
+        xSemaphoreGive(nvs_mutex);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Failed to record the session: %s", esp_err_to_name(err));
+    ESP_LOGI(TAG, "Session %lu: %lu s, %lu steps, %u steps/min, display on %u s", (unsigned long)stats.session_id,
+             (unsigned long)stats.duration_seconds, (unsigned long)stats.steps, stats.cadence_spm, stats.display_on_s);
+
     ESP_LOGI(TAG, "Stop working");
-    vTaskDelete(working_task_handle);
-    working_task_handle = NULL;
+    looptime_log();
+}
+
+// the display follows the tilt towards the user while working
+static void update_facing()
+{
+    float gravity[3];
+    fusion_get_gravity(gravity);
+    backlight_set_facing(backlight_is_facing(gravity), hal_time_ms());
+}
+
+// logs orientation changes of the sensor fusion during working sessions
+static void log_orientation()
+{
+    static btd_orientation_t last_orientation = ORIENTATION_FACE_UP;
+    btd_orientation_t orientation = fusion_get_orientation();
+    if (orientation != last_orientation)
+    {
+        ESP_LOGI(TAG, "Orientation: %s", fusion_orientation_name(orientation));
+        last_orientation = orientation;
+    }
 }
 
 bool handle_working()
 {
-    char btn = btn_detect_press();
+    char btn = read_button();
     if (btn == 'B')
     {
         current_state = STATE_AWAKE;
         return false;
     }
 
-    float magnitude = getAccelMagnitude();
-    int64_t timestamp = esp_timer_get_time() / 1000;
+    int64_t stage_start_us = hal_time_us();
+    btd_imu_raw_t samples[IMU_MAX_BATCH];
+    int count = getImuSamples(samples, IMU_MAX_BATCH);
+    if (count > 0)
+    {
+        const btd_imu_raw_t *latest = &samples[count - 1];
+        imulog_append(latest->ax, latest->ay, latest->az); // the log stays at the loop rate
+#if CONFIG_BTD_STREAM
+        sender_push(latest->ax, latest->ay, latest->az, stage_start_us); // the server expects the loop rate as well
+#endif
+    }
+    stage_start_us = end_stage(LOOP_STAGE_IMU, stage_start_us);
+
+    float a_res = getAccelResolution();
+    float g_res = getGyroResolution();
+    float magnitudes[IMU_MAX_BATCH], rotation_rates[IMU_MAX_BATCH];
+    for (int i = 0; i < count; i++)
+    {
+        const btd_imu_raw_t *sample = &samples[i];
+        fusion_update(sample->ax * a_res, sample->ay * a_res, sample->az * a_res,
+                      sample->gx * g_res, sample->gy * g_res, sample->gz * g_res);
+        magnitudes[i] = getAccelMagnitudeFromAdc(sample->ax, sample->ay, sample->az);
+        rotation_rates[i] = fusion_get_rotation_rate();
+    }
+    log_orientation();
+    update_facing();
+    stage_start_us = end_stage(LOOP_STAGE_FUSION, stage_start_us);
+
+    int64_t timestamp = hal_time_ms();
+    working_sec = seconds_until(working_end_ms);
 
     bool is_above_threshold = is_volume_above_threshold(timestamp);
-    bool walking = is_walking(magnitude, timestamp);
-    bool break_gesture_detected = detect_break_gesture(magnitude, timestamp);
-    bool auto_off = should_auto_off(magnitude, timestamp);
+    telemetry_set_audio(is_above_threshold, get_last_microphone_level());
+    stage_start_us = end_stage(LOOP_STAGE_AUDIO, stage_start_us);
+
+    for (int i = 0; i < count; i++)
+    {
+        // the batch ends at the current time, one IMU period apart
+        update_movement_features(magnitudes[i], rotation_rates[i], timestamp - (count - 1 - i) * 1000 / IMU_RATE_HZ);
+    }
+    bool walking = is_walking(timestamp);
+    bool break_gesture_detected = detect_break_gesture();
+    bool auto_off = should_auto_off(timestamp);
+    end_stage(LOOP_STAGE_DETECTORS, stage_start_us);
 
     if (walking)
     {
@@ -290,7 +460,7 @@ bool handle_working()
     if (auto_off)
     {
         // TODO correct auto off with saving data, protocolling etc.
-        M5.Axp.PowerOff();
+        hal_power_off();
     }
 
     if (working_sec == 0)
@@ -317,20 +487,21 @@ void start_break()
         break_sec = break_sec_config;
     }
     display_break_info_screen(get_battery_percentage());
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    xTaskCreate(countdown_task, "break_sec_countdown", 2048, &break_sec, 5, &break_task_handle);
+    play_cue(&CUE_BREAK_START);
+    hal_delay_ms(1000);
+    // break_sec holds the configured length until here
+    break_end_ms = hal_time_ms() + break_sec * 1000;
 }
 
 void stop_break()
 {
     ESP_LOGI(TAG, "Stop break");
-    vTaskDelete(break_task_handle);
-    break_task_handle = NULL;
+    play_cue(&CUE_BREAK_END);
 }
 
 bool handle_break()
 {
-    char btn = btn_detect_press();
+    char btn = read_button();
 
     if (btn == 'B')
     {
@@ -338,6 +509,7 @@ bool handle_break()
         return false;
     }
 
+    break_sec = seconds_until(break_end_ms);
     if (break_sec == 0)
     {
         return true;
@@ -350,16 +522,23 @@ bool handle_break()
 
 extern "C" void app_main(void)
 {
-    initArduino();
+    boot_mark("app_main");
     init();
     ESP_LOGI(TAG, "Starting ti:ma");
 
-    static TickType_t last_wake_time = 0;
+    static int64_t last_wake_ms = 0;
+    bool deadline_missed = false;
 
+#if CONFIG_BTD_BOOT_SELF_TEST
+    // a blocking Wi-Fi scan and a fake session in the stats on every boot, development only
     test_config();
+    ESP_ERROR_CHECK(init_http_server());
     test_fingerprint();
     test_stats();
+#endif
 
+    // with CONFIG_BTD_HTTP_ALWAYS_ON the AP and the config server started by the first awake
+    // state stay up in all states, for the /ws telemetry and the sample stream
     current_state = STATE_AWAKE;
 
     btd_state_t last_state = (btd_state_t)-1;
@@ -384,6 +563,7 @@ extern "C" void app_main(void)
                 break;
             }
 
+            energy_set_state(current_state);
             switch (current_state) // == START HANDLERS
             {
             case STATE_AWAKE:
@@ -391,6 +571,9 @@ extern "C" void app_main(void)
                 break;
             case STATE_WORKING:
                 start_working();
+                // the sampling period starts now, also when coming back from a break
+                last_wake_ms = hal_time_ms();
+                deadline_missed = false;
                 break;
             case STATE_BREAK:
                 start_break();
@@ -401,32 +584,39 @@ extern "C" void app_main(void)
             last_state = current_state;
         }
 
+        update_telemetry();
+        update_backlight();
+        display_poll_benchmark(); // GET /display
+
         switch (current_state) // == IN-BETWEEN HANDLERS
         {
         case STATE_AWAKE:
             if (handle_awake())
             {
                 current_state = STATE_WORKING;
-                last_wake_time = xTaskGetTickCount();
             }
 
-            vTaskDelay(pdMS_TO_TICKS(200));
+            btn_wait(200);
             break;
         case STATE_WORKING:
             static int last_displayed_working_sec = -1;
+            looptime_iteration(hal_time_us(), deadline_missed);
             if (handle_working())
             {
                 current_state = STATE_BREAK;
                 ESP_LOGI(TAG, "Stop Transitioning to break state.\n");
             }
 
-            if (working_sec != last_displayed_working_sec)
+            // nothing is drawn while the backlight is off, the time is redrawn once it is on
+            if (working_sec != last_displayed_working_sec && backlight_update(hal_time_ms()) != BACKLIGHT_OFF)
             {
+                int64_t display_start_us = hal_time_us();
                 display_working_time(working_sec, get_battery_percentage());
+                end_stage(LOOP_STAGE_DISPLAY, display_start_us);
                 last_displayed_working_sec = working_sec;
             }
 
-            vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(DELAY_BETWEEN_SAMPLES));
+            deadline_missed = !hal_delay_until(&last_wake_ms, LOOP_PERIOD_MS);
             break;
         case STATE_BREAK:
             static int last_displayed_break_sec = -1;
@@ -442,10 +632,10 @@ extern "C" void app_main(void)
                 last_displayed_break_sec = break_sec;
             }
 
-            vTaskDelay(pdMS_TO_TICKS(200));
+            btn_wait(200);
             break;
         default:
-            vTaskDelay(pdMS_TO_TICKS(200));
+            hal_delay_ms(200);
             break;
         }
     }
@@ -0,0 +1,94 @@
+#include <math.h>
+#include <string.h>
+
+#include "btd_decimator.h"
+
+#define CUTOFF 0.4f // of the output rate
+
+// tap k of a Hamming windowed sinc low-pass, cutoff in cycles per input sample
+static float windowed_sinc(int k, int length, float cutoff)
+{
+    float x = k - (length - 1) / 2.0f;
+    float sinc = x == 0.0f ? 2.0f * cutoff : sinf(2.0f * (float)M_PI * cutoff * x) / ((float)M_PI * x);
+    return sinc * (0.54f - 0.46f * cosf(2.0f * (float)M_PI * k / (length - 1)));
+}
+
+bool decimator_init(btd_decimator_t *decimator, uint8_t factor)
+{
+    if (factor < 1 || factor > DECIMATOR_MAX_FACTOR)
+        return false;
+
+    memset(decimator, 0, sizeof(btd_decimator_t));
+    decimator->factor = factor;
+    if (factor == 1)
+        return true;
+
+    int length = factor * DECIMATOR_TAPS_PER_PHASE;
+    float cutoff = CUTOFF / factor;
+    float sum = 0.0f; // for unity gain at DC
+    for (int k = 0; k < length; k++)
+        sum += windowed_sinc(k, length, cutoff);
+
+    // output m = sum of h[k] x[m * factor + factor - 1 - k], so the input at phase p
+    // goes with h[j * factor + factor - 1 - p] into the output j periods ahead
+    for (int p = 0; p < factor; p++)
+    {
+        for (int j = 0; j < DECIMATOR_TAPS_PER_PHASE; j++)
+        {
+            int k = j * factor + factor - 1 - p;
+            decimator->taps[p * DECIMATOR_TAPS_PER_PHASE + j] = windowed_sinc(k, length, cutoff) / sum;
+        }
+    }
+    return true;
+}
+
+void decimator_reset(btd_decimator_t *decimator)
+{
+    decimator->phase = 0;
+    decimator->output = 0;
+    memset(decimator->accumulators, 0, sizeof(decimator->accumulators));
+}
+
+bool decimator_push(btd_decimator_t *decimator, float sample, float *output)
+{
+    if (decimator->factor == 1)
+    {
+        *output = sample;
+        return true;
+    }
+
+    const float *taps = &decimator->taps[decimator->phase * DECIMATOR_TAPS_PER_PHASE];
+    int slot = decimator->output;
+    for (int j = 0; j < DECIMATOR_TAPS_PER_PHASE; j++)
+    {
+        decimator->accumulators[slot] += taps[j] * sample;
+        if (++slot == DECIMATOR_TAPS_PER_PHASE)
+            slot = 0;
+    }
+
+    if (++decimator->phase < decimator->factor)
+        return false;
+
+    // the output of this period has all its taps, its accumulator starts the period after the last
+    decimator->phase = 0;
+    *output = decimator->accumulators[decimator->output];
+    decimator->accumulators[decimator->output] = 0.0f;
+    if (++decimator->output == DECIMATOR_TAPS_PER_PHASE)
+        decimator->output = 0;
+    return true;
+}
+
+void decimator_prime(btd_decimator_t *decimator, float value)
+{
+    decimator_reset(decimator);
+    float output;
+    for (int i = 0; i < decimator->factor * DECIMATOR_TAPS_PER_PHASE; i++)
+        decimator_push(decimator, value, &output);
+}
+
+float decimator_delay(const btd_decimator_t *decimator)
+{
+    if (decimator->factor == 1)
+        return 0.0f;
+    return (decimator->factor * DECIMATOR_TAPS_PER_PHASE - 1) / 2.0f;
+}
@@ -0,0 +1,68 @@
+#ifndef BTD_DECIMATOR_H
+#define BTD_DECIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Anti-alias filter and downsampler by an integer factor, for feeding the
+// detectors of btd_movement at their own rates from the IMU rate (btd_rates.h).
+// The low-pass is a windowed-sinc FIR of DECIMATOR_TAPS_PER_PHASE taps per
+// input sample of an output period, cut off at 0.4 of the output rate.
+// It runs in polyphase form: every input is multiplied with the taps of its
+// phase into the DECIMATOR_TAPS_PER_PHASE outputs it belongs to, so nothing is
+// computed for the outputs that are dropped and no input history is kept.
+// Factor 1 passes the samples through.
+// Single task only, like the filters of btd_bandpass.
+
+#define DECIMATOR_MAX_FACTOR 50 // 500 Hz IMU to 10 Hz
+#define DECIMATOR_TAPS_PER_PHASE 8
+
+typedef struct
+{
+    uint8_t factor;
+    uint8_t phase;  // inputs of the current output period so far
+    uint8_t output; // accumulator of the output that completes next
+    float taps[DECIMATOR_MAX_FACTOR * DECIMATOR_TAPS_PER_PHASE]; // [phase][accumulator offset]
+    float accumulators[DECIMATOR_TAPS_PER_PHASE];
+} btd_decimator_t;
+
+/*
+    In: decimator and the factor, 1..DECIMATOR_MAX_FACTOR
+    Out: false if the factor does not fit
+*/
+bool decimator_init(btd_decimator_t *decimator, uint8_t factor);
+
+/*
+    In: decimator
+    clears the filter state, keeps the factor
+*/
+void decimator_reset(btd_decimator_t *decimator);
+
+/*
+    In: decimator and a sample value
+    fills the filter as if the input had been this value for the whole filter length,
+    so a signal with an offset (the 1 g of the magnitude) does not start with a step
+*/
+void decimator_prime(btd_decimator_t *decimator, float value);
+
+/*
+    In: decimator and the next input sample
+    Out: true and the output sample on every factor-th input
+*/
+bool decimator_push(btd_decimator_t *decimator, float sample, float *output);
+
+/*
+    In: decimator
+    Out: group delay of the filter in input samples
+*/
+float decimator_delay(const btd_decimator_t *decimator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_DECIMATOR_H
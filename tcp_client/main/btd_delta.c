@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "btd_delta.h"
+
+// a zigzag encoded 16 bit delta needs at most 16 bits, i.e. 3 varint bytes
+#define MAX_VARINT_SHIFT 14
+
+static inline uint16_t zigzag_encode(int16_t value)
+{
+    return (uint16_t)(((uint16_t)value << 1) ^ (uint16_t)(value >> 15));
+}
+
+static inline int16_t zigzag_decode(uint16_t value)
+{
+    return (int16_t)((value >> 1) ^ (uint16_t)-(int16_t)(value & 1));
+}
+
+void delta_encoder_init(btd_delta_encoder_t *encoder, uint16_t keyframe_interval)
+{
+    memset(encoder, 0, sizeof(btd_delta_encoder_t));
+    encoder->keyframe_interval = keyframe_interval;
+}
+
+size_t delta_encode_sample(btd_delta_encoder_t *encoder, const int16_t sample[BTD_DELTA_AXES], uint8_t *out)
+{
+    if (encoder->since_keyframe == 0)
+        memset(encoder->prev, 0, sizeof(encoder->prev));
+
+    size_t len = 0;
+    for (int axis = 0; axis < BTD_DELTA_AXES; axis++)
+    {
+        // wrap around in 16 bit, the decoder wraps back the same way
+        int16_t delta = (int16_t)(sample[axis] - encoder->prev[axis]);
+        uint16_t value = zigzag_encode(delta);
+        while (value >= 0x80)
+        {
+            out[len++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        out[len++] = (uint8_t)value;
+        encoder->prev[axis] = sample[axis];
+    }
+
+    if (encoder->keyframe_interval > 0 && ++encoder->since_keyframe >= encoder->keyframe_interval)
+        encoder->since_keyframe = 0;
+    else if (encoder->keyframe_interval == 0)
+        encoder->since_keyframe = 1;
+
+    return len;
+}
+
+void delta_decoder_init(btd_delta_decoder_t *decoder, uint16_t keyframe_interval)
+{
+    memset(decoder, 0, sizeof(btd_delta_decoder_t));
+    decoder->keyframe_interval = keyframe_interval;
+}
+
+int delta_decode(btd_delta_decoder_t *decoder, const uint8_t *in, size_t len,
+                 int16_t (*out)[BTD_DELTA_AXES], size_t max_samples, size_t *consumed)
+{
+    size_t pos = 0;
+    size_t samples = 0;
+
+    while (pos < len && samples < max_samples)
+    {
+        uint8_t byte = in[pos++];
+        decoder->value |= (uint32_t)(byte & 0x7F) << decoder->shift;
+        if (byte & 0x80)
+        {
+            decoder->shift += 7;
+            if (decoder->shift > MAX_VARINT_SHIFT)
+            {
+                *consumed = pos;
+                return -1;
+            }
+            continue;
+        }
+
+        if (decoder->axis == 0 && decoder->since_keyframe == 0)
+            memset(decoder->prev, 0, sizeof(decoder->prev));
+
+        int16_t delta = zigzag_decode((uint16_t)decoder->value);
+        decoder->current[decoder->axis] = (int16_t)(decoder->prev[decoder->axis] + delta);
+        decoder->value = 0;
+        decoder->shift = 0;
+
+        if (++decoder->axis < BTD_DELTA_AXES)
+            continue;
+
+        decoder->axis = 0;
+        memcpy(decoder->prev, decoder->current, sizeof(decoder->prev));
+        memcpy(out[samples++], decoder->current, sizeof(decoder->current));
+
+        if (decoder->keyframe_interval > 0 && ++decoder->since_keyframe >= decoder->keyframe_interval)
+            decoder->since_keyframe = 0;
+        else if (decoder->keyframe_interval == 0)
+            decoder->since_keyframe = 1;
+    }
+
+    *consumed = pos;
+    return (int)samples;
+}
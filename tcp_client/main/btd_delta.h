@@ -0,0 +1,69 @@
+#ifndef BTD_DELTA_H
+#define BTD_DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BTD_DELTA_AXES 3
+#define BTD_DELTA_MAX_SAMPLE_BYTES 9 // worst case: 3 axes x 3 varint bytes
+#define BTD_DELTA_KEYFRAME_INTERVAL 100 // default, one keyframe per second at 100 Hz
+
+// Delta + zigzag varint coding of int16 xyz samples.
+// Every sample is stored as one varint per axis, holding the zigzag encoded
+// difference to the previous sample. Every keyframe_interval samples the
+// reference is reset to zero, so the sample is stored as an absolute value and
+// a decoder can start from there. Encoder and decoder must use the same interval.
+
+typedef struct
+{
+    int16_t prev[BTD_DELTA_AXES];
+    uint16_t keyframe_interval;
+    uint16_t since_keyframe;
+} btd_delta_encoder_t;
+
+typedef struct
+{
+    int16_t prev[BTD_DELTA_AXES];
+    uint16_t keyframe_interval;
+    uint16_t since_keyframe;
+    // partially decoded sample, kept between calls
+    int16_t current[BTD_DELTA_AXES];
+    uint8_t axis;
+    uint8_t shift;
+    uint32_t value;
+} btd_delta_decoder_t;
+
+/*
+    In: encoder and keyframe interval in samples (0 = only the first sample is a keyframe)
+*/
+void delta_encoder_init(btd_delta_encoder_t *encoder, uint16_t keyframe_interval);
+
+/*
+    In: encoder, one xyz sample and an output buffer of at least BTD_DELTA_MAX_SAMPLE_BYTES
+    Out: number of bytes written
+*/
+size_t delta_encode_sample(btd_delta_encoder_t *encoder, const int16_t sample[BTD_DELTA_AXES], uint8_t *out);
+
+/*
+    In: decoder and keyframe interval, must match the encoder
+*/
+void delta_decoder_init(btd_delta_decoder_t *decoder, uint16_t keyframe_interval);
+
+/*
+    In: decoder, encoded bytes and room for max_samples decoded samples
+    Out: number of complete samples written to out, or -1 on a malformed varint.
+    consumed is set to the number of input bytes used. Input may end in the
+    middle of a sample, decoding continues with the next call.
+*/
+int delta_decode(btd_delta_decoder_t *decoder, const uint8_t *in, size_t len,
+                 int16_t (*out)[BTD_DELTA_AXES], size_t max_samples, size_t *consumed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_DELTA_H
@@ -1,21 +1,103 @@
 #include "Arduino.h"
 #include "M5StickCPlus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
 #include "btd_qr.h"
+#include "btd_display.h"
+#include "btd_battery.h"
+#include "sdkconfig.h"
+#if CONFIG_BTD_DISPLAY_DIGIT_ATLAS
+#include "btd_digit_atlas.h" // generated from Font16.c, see digits/digit_atlas.py
+#endif
 // display size 135 x 240
 
+static const char *TAG = "BTD_DISPLAY";
+
+// write clock, the fastest that passed the readback self test in setup_display()
+static bool spi_verified = false;
+
+static SemaphoreHandle_t bench_done = NULL;
+static volatile bool bench_requested = false;
+static display_bench_t bench_result;
+
+#define TIME_X 55
+#define TIME_Y 40
+#define TIME_MAX_CHARS 16 // "%02d:%02d" of any int
+
+#if CONFIG_BTD_DISPLAY_DIGIT_ATLAS
+typedef enum
+{
+    SCREEN_OTHER,
+    SCREEN_WORKING,
+    SCREEN_BREAK,
+} screen_t;
+
+// what is on the display, so a timer update only pushes the characters that changed;
+// clear_display() forgets it
+static screen_t shown_screen = SCREEN_OTHER;
+static int shown_battery = -1;
+static char shown_time[TIME_MAX_CHARS] = "";
+static int shown_time_end_x = TIME_X;
+
+// one glyph is pushed in blocks of rows, 1 kB of pixels
+#define GLYPH_BLOCK_ROWS 16
+static uint16_t glyph_pixels[DIGIT_ATLAS_MAX_WIDTH * GLYPH_BLOCK_ROWS];
+#endif
+
+/*
+    tries CONFIG_BTD_DISPLAY_SPI_MHZ, then the library default SPI_FREQUENCY; a clock is
+    used if the pattern written with it reads back right. If nothing reads back (reads
+    are not wired) the default stays, unverified.
+*/
+static void select_spi_clock(void)
+{
+    const uint32_t clocks[] = {CONFIG_BTD_DISPLAY_SPI_MHZ * 1000000UL, SPI_FREQUENCY};
+    for (size_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]) && !spi_verified; i++)
+    {
+        M5.Lcd.setWriteFrequency(clocks[i]);
+        spi_verified = M5.Lcd.testWriteFrequency(0, 0);
+        if (!spi_verified)
+            ESP_LOGW(TAG, "SPI write clock %lu Hz failed the readback", (unsigned long)clocks[i]);
+    }
+    if (!spi_verified)
+        M5.Lcd.setWriteFrequency(SPI_FREQUENCY);
+    ESP_LOGI(TAG, "SPI write clock %lu Hz%s", (unsigned long)M5.Lcd.getWriteFrequency(),
+             spi_verified ? "" : " (not verified)");
+}
+
 void setup_display(void)
 {
+    bench_done = xSemaphoreCreateBinary();
     M5.Lcd.begin();
     M5.Lcd.setRotation(3);
+    select_spi_clock();
 
     M5.Lcd.fillScreen(BLACK);
     M5.Lcd.setCursor(0, 0, 1);
 }
 
+// ScreenSwitch(false) takes LDO2 (the backlight) to its lowest voltage, ScreenBreath() sets it again
+void display_set_backlight(backlight_level_t level)
+{
+    battery_pmic_lock(); // the battery task reads the AXP192 at the same time
+    if (level == BACKLIGHT_OFF)
+        M5.Axp.ScreenSwitch(false);
+    else
+        M5.Axp.ScreenBreath(level == BACKLIGHT_FULL ? BACKLIGHT_FULL_PERCENT : BACKLIGHT_DIM_PERCENT);
+    battery_pmic_unlock();
+}
+
 void clear_display(void)
 {
     M5.Lcd.fillScreen(BLACK);
     M5.Lcd.setCursor(0, 0, 1);
+#if CONFIG_BTD_DISPLAY_DIGIT_ATLAS
+    shown_screen = SCREEN_OTHER;
+    shown_time[0] = '\0';
+    shown_time_end_x = TIME_X;
+#endif
 }
 
 void display_battery_percentage(int percentage)
@@ -47,15 +129,76 @@ void display_link_code(void)
     M5.Lcd.pushImage(100, 0, 135, 135, link_code);
 }
 
+#if CONFIG_BTD_DISPLAY_DIGIT_ATLAS
+static const digit_glyph_t *find_glyph(char c)
+{
+    for (int i = 0; i < DIGIT_ATLAS_GLYPHS; i++)
+        if (DIGIT_GLYPHS[i].c == c)
+            return &DIGIT_GLYPHS[i];
+    return NULL;
+}
+
+/*
+    In: glyph, top left corner, colors
+    writes the whole cell, background included, in one window, so nothing has to be
+    cleared before
+*/
+static void push_glyph(const digit_glyph_t *glyph, int x, int y, uint16_t fg, uint16_t bg)
+{
+    int stride = (glyph->width + 7) / 8;
+    const uint8_t *row = &DIGIT_ATLAS[glyph->offset];
+
+    M5.Lcd.startWrite();
+    M5.Lcd.setWindow(x, y, x + glyph->width - 1, y + DIGIT_ATLAS_HEIGHT - 1);
+    for (int block = 0; block < DIGIT_ATLAS_HEIGHT; block += GLYPH_BLOCK_ROWS)
+    {
+        // the last block is shorter when the height is not a multiple of the block
+        int rows = DIGIT_ATLAS_HEIGHT - block < GLYPH_BLOCK_ROWS ? DIGIT_ATLAS_HEIGHT - block : GLYPH_BLOCK_ROWS;
+        uint16_t *pixel = glyph_pixels;
+        for (int r = 0; r < rows; r++, row += stride)
+            for (int i = 0; i < glyph->width; i++)
+                *pixel++ = (row[i >> 3] & (0x80 >> (i & 7))) ? fg : bg;
+        M5.Lcd.pushColors(glyph_pixels, (uint32_t)(pixel - glyph_pixels));
+    }
+    M5.Lcd.endWrite();
+}
+
+void display_time(int sec)
+{
+    char text[TIME_MAX_CHARS];
+    snprintf(text, sizeof(text), "%02d:%02d", sec / 60, sec % 60);
+
+    M5.Lcd.beginBatch();
+    int x = TIME_X;
+    bool same = true; // as shown so far, a shifted rest has to be pushed
+    for (int i = 0; text[i] != '\0'; i++)
+    {
+        const digit_glyph_t *glyph = find_glyph(text[i]);
+        if (glyph == NULL)
+            continue;
+        same = same && shown_time[i] == text[i];
+        if (!same)
+            push_glyph(glyph, x, TIME_Y, WHITE, BLACK);
+        x += glyph->width;
+    }
+    if (x < shown_time_end_x) // one character less than before
+        M5.Lcd.fillRect(x, TIME_Y, shown_time_end_x - x, DIGIT_ATLAS_HEIGHT, BLACK);
+    M5.Lcd.endBatch();
+
+    strcpy(shown_time, text);
+    shown_time_end_x = x;
+}
+#else
 void display_time(int sec)
 {
     M5.Lcd.setTextSize(4);
     int minutes = sec / 60;
     int seconds = sec % 60;
-    M5.Lcd.setCursor(55, 40, 2);
+    M5.Lcd.setCursor(TIME_X, TIME_Y, 2);
 
     M5.Lcd.printf("%02d:%02d\n", minutes, seconds);
 }
+#endif
 
 void display_break_msg(void)
 {
@@ -102,10 +245,24 @@ void display_working_bar(void)
 
 void display_break_time(int break_sec, int battery)
 {
+#if CONFIG_BTD_DISPLAY_DIGIT_ATLAS
+    if (shown_screen != SCREEN_BREAK || battery != shown_battery)
+    {
+        M5.Lcd.beginBatch();
+        clear_display();
+        display_break_bar();
+        display_battery_percentage(battery);
+        M5.Lcd.endBatch();
+        shown_screen = SCREEN_BREAK;
+        shown_battery = battery;
+    }
+    display_time(break_sec);
+#else
     clear_display();
     display_time(break_sec);
     display_break_bar();
     display_battery_percentage(battery);
+#endif
 }
 
 void display_working_info_screen(int battery)
@@ -117,8 +274,79 @@ void display_working_info_screen(int battery)
 
 void display_working_time(int working_sec, int battery)
 {
+#if CONFIG_BTD_DISPLAY_DIGIT_ATLAS
+    if (shown_screen != SCREEN_WORKING || battery != shown_battery)
+    {
+        M5.Lcd.beginBatch();
+        clear_display();
+        display_working_bar();
+        display_battery_percentage(battery);
+        M5.Lcd.endBatch();
+        shown_screen = SCREEN_WORKING;
+        shown_battery = battery;
+    }
+    display_time(working_sec);
+#else
     clear_display();
     display_time(working_sec);
     display_working_bar();
     display_battery_percentage(battery);
+#endif
+}
+
+static uint32_t elapsed_us(int64_t start_us)
+{
+    return (uint32_t)(esp_timer_get_time() - start_us);
+}
+
+static void run_benchmark(display_bench_t *out)
+{
+    out->spi_hz = M5.Lcd.getWriteFrequency();
+    out->spi_verified = spi_verified;
+
+    int64_t start_us = esp_timer_get_time();
+    M5.Lcd.fillScreen(BLUE);
+    out->fill_screen_us = elapsed_us(start_us);
+
+    // small primitives, where the transaction per call dominates
+    start_us = esp_timer_get_time();
+    for (int i = 0; i < DISPLAY_BENCH_RECTS; i++)
+        M5.Lcd.fillRect((i % 30) * 8, (i / 30) * 8, 8, 8, (i & 1) ? WHITE : BLACK);
+    out->rects_us = elapsed_us(start_us);
+
+    start_us = esp_timer_get_time();
+    M5.Lcd.beginBatch();
+    for (int i = 0; i < DISPLAY_BENCH_RECTS; i++)
+        M5.Lcd.fillRect((i % 30) * 8, (i / 30) * 8, 8, 8, (i & 1) ? BLACK : WHITE);
+    M5.Lcd.endBatch();
+    out->rects_batched_us = elapsed_us(start_us);
+
+    clear_display(); // the timers are redrawn on their next update
+}
+
+bool display_request_benchmark(display_bench_t *out, uint32_t timeout_ms)
+{
+    if (bench_done == NULL)
+        return false;
+    xSemaphoreTake(bench_done, 0); // a result that came after an earlier timeout
+    bench_requested = true;
+    if (xSemaphoreTake(bench_done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    {
+        bench_requested = false;
+        return false;
+    }
+    memcpy(out, &bench_result, sizeof(display_bench_t));
+    return true;
+}
+
+void display_poll_benchmark(void)
+{
+    if (!bench_requested)
+        return;
+    run_benchmark(&bench_result);
+    ESP_LOGI(TAG, "benchmark at %lu Hz: fillScreen %lu us, %d rects %lu us, batched %lu us",
+             (unsigned long)bench_result.spi_hz, (unsigned long)bench_result.fill_screen_us, DISPLAY_BENCH_RECTS,
+             (unsigned long)bench_result.rects_us, (unsigned long)bench_result.rects_batched_us);
+    bench_requested = false;
+    xSemaphoreGive(bench_done);
 }
@@ -1,4 +1,23 @@
 #pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "btd_backlight.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DISPLAY_BENCH_RECTS 240 // 8 x 8 fillRect per run
+
+typedef struct
+{
+    uint32_t spi_hz;           // write clock in use
+    bool spi_verified;         // it passed the readback self test at boot
+    uint32_t fill_screen_us;   // one fillScreen(), 240 x 135 pixels
+    uint32_t rects_us;         // DISPLAY_BENCH_RECTS fillRect, a transaction each
+    uint32_t rects_batched_us; // the same in one batch
+} display_bench_t;
+
 void setup_display(void);
 void clear_display(void);
 void display_battery_percentage(int percentage);
@@ -12,4 +31,22 @@ void display_break_time(int break_sec, int battery);
 void display_working_msg(void);
 void display_working_bar(void);
 void display_working_info_screen(int battery);
-void display_working_time(int working_sec, int battery);
\ No newline at end of file
+void display_working_time(int working_sec, int battery);
+void display_set_backlight(backlight_level_t level);
+
+/*
+    In: result, maximum time to wait
+    Out: false if the state loop did not run the benchmark in time
+    asks the state loop (display_poll_benchmark()) for a pixel throughput benchmark and
+    waits for it, from another task (the /display handler); the screen is cleared
+*/
+bool display_request_benchmark(display_bench_t *out, uint32_t timeout_ms);
+
+/*
+    runs a requested benchmark, called by the state loop that owns the display
+*/
+void display_poll_benchmark(void);
+
+#ifdef __cplusplus
+}
+#endif
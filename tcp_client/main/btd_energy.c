@@ -0,0 +1,198 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "btd_energy.h"
+#include "btd_hal.h"
+
+static const char *TAG = "BTD_ENERGY";
+
+static const char *NVS_NAMESPACE = "btd_energy";
+static const char *NVS_KEY_TOTALS = "totals";
+
+static const char *state_names[ENERGY_STATES] = {"init", "awake", "working", "break"};
+static const char *feature_names[ENERGY_FEATURES] = {"display", "mic", "wifi_ap", "wifi_scan"};
+
+static energy_totals_t totals;
+static uint8_t current_state = 0;
+static bool feature_on[ENERGY_FEATURES];
+// time since the last sample, not yet attributed
+static uint32_t pending_state_ms[ENERGY_STATES];
+static uint32_t pending_feature_ms[ENERGY_FEATURES];
+static int64_t settled_ms = 0;
+static int64_t last_save_ms = 0;
+static SemaphoreHandle_t energy_mutex = NULL;
+
+static void lock(void)
+{
+    xSemaphoreTake(energy_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(energy_mutex);
+}
+
+// adds the time since the last change to the current state and the features that are on
+static void settle(int64_t now_ms)
+{
+    uint32_t elapsed_ms = (uint32_t)(now_ms - settled_ms);
+    settled_ms = now_ms;
+    pending_state_ms[current_state] += elapsed_ms;
+    for (int i = 0; i < ENERGY_FEATURES; i++)
+    {
+        if (feature_on[i])
+            pending_feature_ms[i] += elapsed_ms;
+    }
+}
+
+static void add_charge(energy_total_t *total, uint32_t *pending_ms, float load_ma)
+{
+    total->time_ms += *pending_ms;
+    total->charge_mah += load_ma * *pending_ms / 3600000.0f;
+    *pending_ms = 0;
+}
+
+static esp_err_t save(const energy_totals_t *saved)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK)
+        return err;
+    err = nvs_set_blob(nvs_handle, NVS_KEY_TOTALS, saved, sizeof(energy_totals_t));
+    if (err == ESP_OK)
+        err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    return err;
+}
+
+void energy_init(void)
+{
+    energy_mutex = xSemaphoreCreateMutex();
+    feature_on[ENERGY_FEATURE_DISPLAY] = true; // on from boot, the backlight policy switches it later
+    settled_ms = hal_time_ms();
+}
+
+void energy_load(void)
+{
+    energy_totals_t saved;
+    size_t len = sizeof(saved);
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK)
+    {
+        err = nvs_get_blob(nvs_handle, NVS_KEY_TOTALS, &saved, &len);
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK || len != sizeof(saved))
+    {
+        ESP_LOGI(TAG, "No energy totals stored, starting from zero");
+        return;
+    }
+
+    // samples may already have come in since boot
+    lock();
+    for (int i = 0; i < ENERGY_STATES; i++)
+    {
+        totals.states[i].time_ms += saved.states[i].time_ms;
+        totals.states[i].charge_mah += saved.states[i].charge_mah;
+    }
+    for (int i = 0; i < ENERGY_FEATURES; i++)
+    {
+        totals.features[i].time_ms += saved.features[i].time_ms;
+        totals.features[i].charge_mah += saved.features[i].charge_mah;
+    }
+    totals.samples += saved.samples;
+    unlock();
+    ESP_LOGI(TAG, "Energy totals loaded, %lu samples", (unsigned long)totals.samples);
+}
+
+void energy_set_state(uint8_t state)
+{
+    if (state >= ENERGY_STATES)
+        return;
+    lock();
+    settle(hal_time_ms());
+    current_state = state;
+    unlock();
+}
+
+void energy_set_feature(energy_feature_t feature, bool on)
+{
+    lock();
+    settle(hal_time_ms());
+    feature_on[feature] = on;
+    unlock();
+}
+
+void energy_add_sample(float load_ma)
+{
+    static energy_totals_t to_save;
+    int64_t now_ms = hal_time_ms();
+    if (load_ma < 0.0f)
+        load_ma = 0.0f;
+
+    lock();
+    settle(now_ms);
+    for (int i = 0; i < ENERGY_STATES; i++)
+        add_charge(&totals.states[i], &pending_state_ms[i], load_ma);
+    for (int i = 0; i < ENERGY_FEATURES; i++)
+        add_charge(&totals.features[i], &pending_feature_ms[i], load_ma);
+    totals.samples++;
+    bool due = now_ms - last_save_ms >= ENERGY_SAVE_PERIOD_S * 1000;
+    if (due)
+    {
+        last_save_ms = now_ms;
+        to_save = totals;
+    }
+    unlock();
+
+    if (due)
+    {
+        esp_err_t err = save(&to_save);
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Failed to save energy totals: %s", esp_err_to_name(err));
+    }
+}
+
+void energy_get_totals(energy_totals_t *out)
+{
+    lock();
+    *out = totals;
+    unlock();
+}
+
+esp_err_t energy_reset(void)
+{
+    lock();
+    memset(&totals, 0, sizeof(totals));
+    memset(pending_state_ms, 0, sizeof(pending_state_ms));
+    memset(pending_feature_ms, 0, sizeof(pending_feature_ms));
+    settled_ms = hal_time_ms();
+    unlock();
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK)
+        return err;
+    err = nvs_erase_key(nvs_handle, NVS_KEY_TOTALS);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        err = ESP_OK;
+    if (err == ESP_OK)
+        err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    return err;
+}
+
+const char *energy_state_name(uint8_t state)
+{
+    return state < ENERGY_STATES ? state_names[state] : "unknown";
+}
+
+const char *energy_feature_name(energy_feature_t feature)
+{
+    return feature < ENERGY_FEATURES ? feature_names[feature] : "unknown";
+}
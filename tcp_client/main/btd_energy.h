@@ -0,0 +1,94 @@
+#ifndef BTD_ENERGY_H
+#define BTD_ENERGY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Energy accounting per controller state and per feature.
+// The state and the features report their changes, the time in each is kept
+// in ms. Every battery sample (btd_battery) brings the measured load current,
+// the charge since the previous sample is split over the states by their time
+// in the interval and added to every feature by its on time. A feature's charge
+// is what the device drew while it was on, its cost is the difference of its
+// mean current to the state it runs in.
+// The totals survive reboots in NVS and are served at /energy.
+// Any task, a mutex guards the totals.
+
+#define ENERGY_STATES 4 // btd_state_t
+#define ENERGY_SAVE_PERIOD_S 600
+
+typedef enum
+{
+    ENERGY_FEATURE_DISPLAY,
+    ENERGY_FEATURE_MIC,
+    ENERGY_FEATURE_WIFI_AP,
+    ENERGY_FEATURE_WIFI_SCAN,
+    ENERGY_FEATURES,
+} energy_feature_t;
+
+typedef struct
+{
+    uint64_t time_ms;
+    float charge_mah;
+} energy_total_t;
+
+typedef struct
+{
+    energy_total_t states[ENERGY_STATES];
+    energy_total_t features[ENERGY_FEATURES];
+    uint32_t samples;
+} energy_totals_t;
+
+/*
+    creates the lock, before any task uses the other functions
+*/
+void energy_init(void);
+
+/*
+    adds the totals stored in NVS, after nvs_flash_init()
+*/
+void energy_load(void);
+
+/*
+    In: btd_state_t the controller enters
+*/
+void energy_set_state(uint8_t state);
+
+/*
+    In: feature and whether it is on from now on
+*/
+void energy_set_feature(energy_feature_t feature, bool on);
+
+/*
+    In: load current of the device in mA since the previous sample
+    attributes the charge of the interval, saves the totals every ENERGY_SAVE_PERIOD_S
+*/
+void energy_add_sample(float load_ma);
+
+/*
+    Out: copy of the totals
+*/
+void energy_get_totals(energy_totals_t *totals);
+
+/*
+    clears the totals, also in NVS
+*/
+esp_err_t energy_reset(void);
+
+/*
+    In: index below ENERGY_STATES or an energy_feature_t
+    Out: name for the csv
+*/
+const char *energy_state_name(uint8_t state);
+const char *energy_feature_name(energy_feature_t feature);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_ENERGY_H
@@ -0,0 +1,171 @@
+#include <math.h>
+#include <string.h>
+
+#include "btd_features.h"
+
+#define FLAG_CROSSING 0x01 // the signal crossed the mean between the previous sample and this one
+#define FLAG_PEAK 0x02     // this sample is a peak
+
+bool features_init(btd_feature_window_t *window, const btd_feature_config_t *config)
+{
+    if (config->length < 3 || config->length > FEATURES_MAX_LENGTH || config->sample_frequency <= 0)
+        return false;
+
+    memset(window, 0, sizeof(btd_feature_window_t));
+    window->config = *config;
+    if (config->max_frequency > 0)
+    {
+        float resolution = config->sample_frequency / config->length;
+        int first = (int)ceilf(config->min_frequency / resolution);
+        int last = (int)floorf(config->max_frequency / resolution);
+        if (first < 1)
+            first = 1; // bin 0 is the mean
+        if (last > config->length / 2)
+            last = config->length / 2;
+        if (last < first || last - first + 1 > FEATURES_MAX_BINS)
+            return false;
+
+        window->first_bin = first;
+        window->bin_count = last - first + 1;
+        for (int i = 0; i < window->bin_count; i++)
+        {
+            float angle = 2.0f * (float)M_PI * (first + i) / config->length;
+            window->twiddle_re[i] = cosf(angle);
+            window->twiddle_im[i] = sinf(angle);
+        }
+    }
+    return true;
+}
+
+void features_reset(btd_feature_window_t *window)
+{
+    btd_feature_config_t config = window->config;
+    features_init(window, &config);
+}
+
+// exact DFT of the window in the sliding DFT's phase (oldest sample at index 0)
+static void refresh_bins(btd_feature_window_t *window)
+{
+    uint16_t length = window->config.length;
+    for (int i = 0; i < window->bin_count; i++)
+    {
+        float step_re = window->twiddle_re[i], step_im = -window->twiddle_im[i];
+        float w_re = 1.0f, w_im = 0.0f;
+        float re = 0.0f, im = 0.0f;
+        uint16_t slot = window->head;
+        for (uint16_t m = 0; m < length; m++)
+        {
+            float x = window->samples[slot];
+            re += x * w_re;
+            im += x * w_im;
+            float next_re = w_re * step_re - w_im * step_im;
+            w_im = w_re * step_im + w_im * step_re;
+            w_re = next_re;
+            if (++slot == length)
+                slot = 0;
+        }
+        window->bin_re[i] = re;
+        window->bin_im[i] = im;
+    }
+    window->since_refresh = 0;
+}
+
+void features_push(btd_feature_window_t *window, int16_t sample)
+{
+    uint16_t length = window->config.length;
+    uint16_t slot = window->head;
+
+    // the oldest sample leaves the window
+    int16_t old = window->samples[slot];
+    if (window->count == length)
+    {
+        window->sum -= old;
+        window->sum_sq -= (int32_t)old * old;
+        if (window->flags[slot] & FLAG_CROSSING)
+            window->crossings--;
+        if (window->flags[slot] & FLAG_PEAK)
+            window->peaks--;
+    }
+    else
+    {
+        old = 0; // the sliding DFT sees an empty slot as 0
+    }
+
+    // crossing and peak against the mean of the window before this sample
+    uint8_t flags = 0;
+    if (window->count > 0)
+    {
+        bool above = (int32_t)sample * window->count > window->sum;
+        if (above != window->last_above)
+            flags |= FLAG_CROSSING;
+        window->last_above = above;
+
+        if (window->count >= 2 && window->prev > window->prev2 && window->prev >= sample &&
+            ((int32_t)window->prev - window->config.peak_threshold) * window->count > window->sum)
+        {
+            uint16_t prev_slot = slot == 0 ? length - 1 : slot - 1;
+            window->flags[prev_slot] |= FLAG_PEAK;
+            window->peaks++;
+        }
+    }
+    else
+    {
+        window->last_above = false;
+    }
+    if (flags & FLAG_CROSSING)
+        window->crossings++;
+
+    window->samples[slot] = sample;
+    window->flags[slot] = flags;
+    window->sum += sample;
+    window->sum_sq += (int32_t)sample * sample;
+    if (window->count < length)
+        window->count++;
+    window->head = slot + 1 == length ? 0 : slot + 1;
+    window->prev2 = window->prev;
+    window->prev = sample;
+
+    if (window->bin_count == 0)
+        return;
+    if (++window->since_refresh >= length)
+    {
+        refresh_bins(window);
+        return;
+    }
+    float delta = (float)sample - old;
+    for (int i = 0; i < window->bin_count; i++)
+    {
+        float re = window->bin_re[i] + delta;
+        float im = window->bin_im[i];
+        window->bin_re[i] = re * window->twiddle_re[i] - im * window->twiddle_im[i];
+        window->bin_im[i] = re * window->twiddle_im[i] + im * window->twiddle_re[i];
+    }
+}
+
+void features_get(const btd_feature_window_t *window, btd_features_t *features)
+{
+    memset(features, 0, sizeof(btd_features_t));
+    uint16_t count = window->count;
+    features->count = count;
+    if (count == 0)
+        return;
+
+    features->mean = (float)window->sum / count;
+    features->energy = (float)window->sum_sq / count;
+    int64_t spread = (int64_t)count * window->sum_sq - (int64_t)window->sum * window->sum; // exact
+    features->variance = (float)spread / ((float)count * count);
+    features->zero_crossing_rate = window->crossings * window->config.sample_frequency / count;
+    features->peak_count = window->peaks;
+
+    float best = 0.0f;
+    for (int i = 0; i < window->bin_count; i++)
+    {
+        float power = window->bin_re[i] * window->bin_re[i] + window->bin_im[i] * window->bin_im[i];
+        if (power > best)
+        {
+            best = power;
+            features->dominant_frequency = (window->first_bin + i) * window->config.sample_frequency / window->config.length;
+        }
+    }
+    features->dominant_amplitude = 2.0f * sqrtf(best) / count;
+}
@@ -0,0 +1,99 @@
+#ifndef BTD_FEATURES_H
+#define BTD_FEATURES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Features of a sliding window over one IMU signal (e.g. the accelerometer
+// magnitude in mg), for the detectors of btd_movement.
+// Every feature is updated when a sample enters or leaves the window, nothing
+// is recomputed over the whole window per sample:
+// - mean, variance and energy from exact integer sums
+// - zero crossings (of the window mean at the time of the sample) and peaks
+//   (local maxima more than peak_threshold above the mean) as per-sample flags
+//   that are counted in and out
+// - dominant frequency with a sliding DFT over a band of bins, O(bins) per
+//   sample; the bins are recomputed from the window once per window length so
+//   rounding errors do not build up
+// Single task only, like the filters of btd_bandpass.
+
+#define FEATURES_MAX_LENGTH 256
+#define FEATURES_MAX_BINS 16
+
+typedef struct
+{
+    uint16_t count;           // samples in the window, less than the length until it is full
+    float mean;               // input units
+    float variance;           // input units squared
+    float energy;             // mean of the squared samples
+    float zero_crossing_rate; // crossings of the mean per second
+    uint16_t peak_count;      // local maxima more than peak_threshold above the mean
+    float dominant_frequency; // Hz, bin with the largest amplitude in the band, 0 without bins
+    float dominant_amplitude; // input units, amplitude of the sine at dominant_frequency
+} btd_features_t;
+
+typedef struct
+{
+    uint16_t length;        // samples per window, at most FEATURES_MAX_LENGTH
+    float sample_frequency; // Hz
+    int16_t peak_threshold; // input units above the mean
+    float min_frequency;    // band of the dominant frequency, Hz; max 0 = no frequency features
+    float max_frequency;
+} btd_feature_config_t;
+
+typedef struct
+{
+    btd_feature_config_t config;
+    int16_t samples[FEATURES_MAX_LENGTH];
+    uint8_t flags[FEATURES_MAX_LENGTH]; // crossing and peak flag of each sample
+    uint16_t head;                      // next slot to write
+    uint16_t count;
+    int32_t sum;
+    int64_t sum_sq;
+    uint16_t crossings;
+    uint16_t peaks;
+    bool last_above; // previous sample was above the mean
+    int16_t prev, prev2;
+
+    uint8_t first_bin;
+    uint8_t bin_count;
+    uint16_t since_refresh; // samples since the bins were recomputed
+    float twiddle_re[FEATURES_MAX_BINS];
+    float twiddle_im[FEATURES_MAX_BINS];
+    float bin_re[FEATURES_MAX_BINS];
+    float bin_im[FEATURES_MAX_BINS];
+} btd_feature_window_t;
+
+/*
+    In: window and its configuration
+    Out: false if the length (3..FEATURES_MAX_LENGTH) or the band (FEATURES_MAX_BINS bins
+    of sample_frequency / length) do not fit
+*/
+bool features_init(btd_feature_window_t *window, const btd_feature_config_t *config);
+
+/*
+    In: window
+    empties the window, keeps the configuration
+*/
+void features_reset(btd_feature_window_t *window);
+
+/*
+    In: window and the next sample
+*/
+void features_push(btd_feature_window_t *window, int16_t sample);
+
+/*
+    In: window
+    Out: features of the samples in the window
+*/
+void features_get(const btd_feature_window_t *window, btd_features_t *features);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_FEATURES_H
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "btd_fuelgauge.h"
+
+typedef struct
+{
+    float voltage;
+    float percent;
+} ocv_point_t;
+
+// resting voltage of a single LiPo cell over its charge
+static const ocv_point_t ocv_curve[] = {
+    {3.27f, 0.0f},
+    {3.61f, 5.0f},
+    {3.69f, 10.0f},
+    {3.73f, 20.0f},
+    {3.77f, 30.0f},
+    {3.80f, 40.0f},
+    {3.84f, 50.0f},
+    {3.87f, 60.0f},
+    {3.95f, 70.0f},
+    {4.02f, 80.0f},
+    {4.11f, 90.0f},
+    {4.20f, 100.0f},
+};
+
+#define OCV_POINTS (sizeof(ocv_curve) / sizeof(ocv_curve[0]))
+
+static float clamp_percent(float percent)
+{
+    if (percent < 0.0f)
+        return 0.0f;
+    if (percent > 100.0f)
+        return 100.0f;
+    return percent;
+}
+
+void fuelgauge_init(btd_fuelgauge_t *gauge, float capacity_mah)
+{
+    gauge->capacity_mah = capacity_mah;
+    gauge->initialized = false;
+    gauge->percent = 0.0f;
+    gauge->coulomb_mah = 0.0f;
+    gauge->discharge_ma = 0.0f;
+}
+
+float fuelgauge_ocv_percent(float ocv_v)
+{
+    if (ocv_v <= ocv_curve[0].voltage)
+        return 0.0f;
+    for (size_t i = 1; i < OCV_POINTS; i++)
+    {
+        if (ocv_v < ocv_curve[i].voltage)
+        {
+            const ocv_point_t *low = &ocv_curve[i - 1];
+            const ocv_point_t *high = &ocv_curve[i];
+            return low->percent + (ocv_v - low->voltage) / (high->voltage - low->voltage) * (high->percent - low->percent);
+        }
+    }
+    return 100.0f;
+}
+
+void fuelgauge_update(btd_fuelgauge_t *gauge, float voltage_v, float current_ma, float coulomb_mah)
+{
+    // the terminal voltage is below the open circuit voltage while discharging, above while charging
+    float ocv_percent = fuelgauge_ocv_percent(voltage_v - current_ma / 1000.0f * FUELGAUGE_RESISTANCE_OHM);
+    float discharge_ma = current_ma < 0.0f ? -current_ma : 0.0f;
+
+    if (!gauge->initialized)
+    {
+        gauge->initialized = true;
+        gauge->percent = ocv_percent;
+        gauge->coulomb_mah = coulomb_mah;
+        gauge->discharge_ma = discharge_ma;
+        return;
+    }
+
+    float charged_mah = coulomb_mah - gauge->coulomb_mah;
+    gauge->coulomb_mah = coulomb_mah;
+    if (fabsf(charged_mah) > gauge->capacity_mah)
+        charged_mah = 0.0f; // the counter was cleared or overflowed, the voltage takes over
+
+    float predicted = gauge->percent + charged_mah / gauge->capacity_mah * 100.0f;
+    float weight = fabsf(current_ma) < FUELGAUGE_REST_MA ? FUELGAUGE_REST_WEIGHT : FUELGAUGE_LOAD_WEIGHT;
+    gauge->percent = clamp_percent(predicted + weight * (ocv_percent - predicted));
+    gauge->discharge_ma += FUELGAUGE_CURRENT_SMOOTHING * (discharge_ma - gauge->discharge_ma);
+}
+
+int fuelgauge_percent(const btd_fuelgauge_t *gauge)
+{
+    return (int)lroundf(gauge->percent);
+}
+
+int fuelgauge_time_to_empty_min(const btd_fuelgauge_t *gauge)
+{
+    if (!gauge->initialized || gauge->discharge_ma < 1.0f)
+        return -1;
+    return (int)(gauge->percent / 100.0f * gauge->capacity_mah / gauge->discharge_ma * 60.0f);
+}
@@ -0,0 +1,67 @@
+#ifndef BTD_FUELGAUGE_H
+#define BTD_FUELGAUGE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// State of charge of the LiPo from the AXP192 readings, for btd_battery.
+// Two estimates are fused: the coulomb counter follows every change of the
+// charge exactly but drifts with its gain error and knows no starting point,
+// the open circuit voltage (the terminal voltage corrected by the drop over the
+// internal resistance) is absolute but noisy and off under load. The counter
+// predicts the charge from sample to sample and the voltage pulls it slowly
+// towards the lookup curve, harder while the current is low.
+// Single task only, like the filters of btd_bandpass.
+
+#define FUELGAUGE_CAPACITY_MAH 120.0f  // M5StickC Plus cell
+#define FUELGAUGE_RESISTANCE_OHM 0.3f  // cell and AXP192 path
+#define FUELGAUGE_REST_MA 20.0f        // below this the voltage is close to the open circuit voltage
+#define FUELGAUGE_REST_WEIGHT 0.05f    // pull towards the voltage estimate per update at rest
+#define FUELGAUGE_LOAD_WEIGHT 0.01f    // and under load
+#define FUELGAUGE_CURRENT_SMOOTHING 0.2f
+
+typedef struct
+{
+    float capacity_mah;
+    bool initialized;
+    float percent;       // fused state of charge, 0..100
+    float coulomb_mah;   // counter at the last update
+    float discharge_ma;  // smoothed discharge current, 0 while charging
+} btd_fuelgauge_t;
+
+/*
+    In: gauge and the capacity of the cell
+*/
+void fuelgauge_init(btd_fuelgauge_t *gauge, float capacity_mah);
+
+/*
+    In: open circuit voltage in V
+    Out: state of charge in percent from the lookup curve
+*/
+float fuelgauge_ocv_percent(float ocv_v);
+
+/*
+    In: gauge, terminal voltage in V, battery current in mA (positive while charging),
+        coulomb counter in mAh (charged minus discharged since it was enabled)
+    the first update starts from the voltage alone
+*/
+void fuelgauge_update(btd_fuelgauge_t *gauge, float voltage_v, float current_ma, float coulomb_mah);
+
+/*
+    Out: state of charge in percent, 0..100
+*/
+int fuelgauge_percent(const btd_fuelgauge_t *gauge);
+
+/*
+    Out: minutes until empty at the smoothed discharge current, -1 while charging or idle
+*/
+int fuelgauge_time_to_empty_min(const btd_fuelgauge_t *gauge);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_FUELGAUGE_H
@@ -0,0 +1,95 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "btd_fusion.h"
+#include "btd_mahony.h"
+
+#define ORIENTATION_ENTER 0.906f  // cos(25 degrees)
+
+static MahonyFilter filter;
+static bool initialized = false;
+
+static float linear[3] = {0.0f, 0.0f, 0.0f};
+static float rotation_rate = 0.0f;
+static btd_orientation_t orientation = ORIENTATION_FACE_UP;
+
+static const char *orientation_names[] = {"face up", "face down", "upright", "upside down", "left", "right"};
+
+void fusion_init(float sample_frequency)
+{
+    filter = MahonyFilter(sample_frequency);
+    initialized = false;
+    linear[0] = linear[1] = linear[2] = 0.0f;
+    rotation_rate = 0.0f;
+    orientation = ORIENTATION_FACE_UP;
+}
+
+static void update_orientation(const float gravity[3])
+{
+    float ax = fabsf(gravity[0]), ay = fabsf(gravity[1]), az = fabsf(gravity[2]);
+    if (az >= ORIENTATION_ENTER)
+        orientation = gravity[2] > 0 ? ORIENTATION_FACE_UP : ORIENTATION_FACE_DOWN;
+    else if (ay >= ORIENTATION_ENTER)
+        orientation = gravity[1] > 0 ? ORIENTATION_UPRIGHT : ORIENTATION_UPSIDE_DOWN;
+    else if (ax >= ORIENTATION_ENTER)
+        orientation = gravity[0] > 0 ? ORIENTATION_LEFT : ORIENTATION_RIGHT;
+    // in between: keep the last one
+}
+
+void fusion_update(float ax, float ay, float az, float gx, float gy, float gz)
+{
+    rotation_rate = sqrtf(gx * gx + gy * gy + gz * gz);
+    if (!initialized && (ax != 0.0f || ay != 0.0f || az != 0.0f))
+    {
+        // skips the slow convergence from the identity
+        filter.initFromAccel(ax, ay, az);
+        initialized = true;
+    }
+    filter.update(gx, gy, gz, ax, ay, az);
+
+    float gravity[3];
+    filter.getGravity(gravity);
+    linear[0] = ax - gravity[0];
+    linear[1] = ay - gravity[1];
+    linear[2] = az - gravity[2];
+    update_orientation(gravity);
+}
+
+void fusion_get_quaternion(float q[4])
+{
+    filter.getQuaternion(q);
+}
+
+void fusion_get_gravity(float gravity[3])
+{
+    filter.getGravity(gravity);
+}
+
+void fusion_get_linear_accel(float accel[3])
+{
+    accel[0] = linear[0];
+    accel[1] = linear[1];
+    accel[2] = linear[2];
+}
+
+float fusion_get_linear_magnitude(void)
+{
+    return sqrtf(linear[0] * linear[0] + linear[1] * linear[1] + linear[2] * linear[2]);
+}
+
+float fusion_get_rotation_rate(void)
+{
+    return rotation_rate;
+}
+
+btd_orientation_t fusion_get_orientation(void)
+{
+    return orientation;
+}
+
+const char *fusion_orientation_name(btd_orientation_t orientation)
+{
+    if ((size_t)orientation >= sizeof(orientation_names) / sizeof(orientation_names[0]))
+        return "unknown";
+    return orientation_names[orientation];
+}
@@ -0,0 +1,79 @@
+#ifndef BTD_FUSION_H
+#define BTD_FUSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Orientation of the device from accelerometer and gyroscope (Mahony filter,
+// without magnetometer, so the heading drifts and only the direction of gravity
+// is used). Runs once per IMU sample at a fixed rate, the cost per sample does
+// not depend on the data. The results are read by the detectors of btd_movement
+// after fusion_update(); single task only.
+// Axes are the ones of the MPU6886: z points out of the display.
+
+typedef enum
+{
+    ORIENTATION_FACE_UP,   // lying on the back, display up
+    ORIENTATION_FACE_DOWN, // lying on the display
+    ORIENTATION_UPRIGHT,   // standing on the bottom edge, buttons up
+    ORIENTATION_UPSIDE_DOWN,
+    ORIENTATION_LEFT,  // on the left edge
+    ORIENTATION_RIGHT, // on the right edge
+} btd_orientation_t;
+
+/*
+    In: sampling frequency of fusion_update() calls
+    the orientation is taken from the first accelerometer sample
+*/
+void fusion_init(float sample_frequency);
+
+/*
+    In: acceleration in g and rotation rate in degrees per second, sensor axes
+*/
+void fusion_update(float ax, float ay, float az, float gx, float gy, float gz);
+
+/*
+    Out: orientation quaternion w, x, y, z of the sensor frame
+*/
+void fusion_get_quaternion(float q[4]);
+
+/*
+    Out: direction of gravity in the sensor frame, unit vector
+*/
+void fusion_get_gravity(float gravity[3]);
+
+/*
+    Out: acceleration without gravity in g, sensor frame
+*/
+void fusion_get_linear_accel(float accel[3]);
+
+/*
+    Out: magnitude of fusion_get_linear_accel()
+*/
+float fusion_get_linear_magnitude(void);
+
+/*
+    Out: magnitude of the last rotation rate in degrees per second
+*/
+float fusion_get_rotation_rate(void);
+
+/*
+    Out: orientation from the gravity direction, it only changes once gravity is
+    within 25 degrees of another axis
+*/
+btd_orientation_t fusion_get_orientation(void);
+
+/*
+    Out: name of the orientation for logs
+*/
+const char *fusion_orientation_name(btd_orientation_t orientation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_FUSION_H
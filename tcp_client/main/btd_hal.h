@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Board services used by the controller. The peripherals themselves are behind
+// their module headers (btd_imu.h, btd_display.h, btd_button.h, btd_audio.h,
+// btd_battery.h, btd_vibrator.h, btd_http.h, btd_wifi.h).
+// btd_hal_m5.cpp implements them on the M5StickC Plus, btd_sim.cpp on the
+// linux target with a virtual clock.
+
+/*
+    initializes the board (Arduino core, M5 peripherals)
+*/
+void hal_board_init(void);
+
+/*
+    Out: milliseconds since boot
+*/
+int64_t hal_time_ms(void);
+
+/*
+    Out: microseconds since boot
+*/
+int64_t hal_time_us(void);
+
+/*
+    In: time to block the calling task
+*/
+void hal_delay_ms(uint32_t ms);
+
+/*
+    In: wake time of the previous period, period length
+    Out: false if the wake time had already passed, i.e. the period's deadline was missed
+    Blocks until last_wake_ms + period_ms and advances last_wake_ms by one period,
+    returns immediately if that time has already passed (like xTaskDelayUntil)
+*/
+bool hal_delay_until(int64_t *last_wake_ms, uint32_t period_ms);
+
+/*
+    switches the device off, does not return
+*/
+void hal_power_off(void);
+
+#ifdef __cplusplus
+}
+#endif
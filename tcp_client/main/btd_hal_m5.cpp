@@ -0,0 +1,46 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "Arduino.h"
+#include "M5StickCPlus.h"
+
+#include "btd_hal.h"
+#include "btd_battery.h"
+
+void hal_board_init(void)
+{
+    initArduino();
+    M5.begin();
+}
+
+int64_t hal_time_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+int64_t hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void hal_delay_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+bool hal_delay_until(int64_t *last_wake_ms, uint32_t period_ms)
+{
+    *last_wake_ms += period_ms;
+    int64_t remaining_ms = *last_wake_ms - hal_time_ms();
+    // round up to whole ticks, the next period catches up since last_wake_ms is absolute
+    if (remaining_ms > 0)
+        vTaskDelay((remaining_ms * configTICK_RATE_HZ + 999) / 1000);
+    return remaining_ms >= 0;
+}
+
+void hal_power_off(void)
+{
+    battery_pmic_lock(); // not given back, the power is cut
+    M5.Axp.PowerOff();
+}
@@ -1,30 +1,94 @@
 #include <string.h>
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h" // FreeRTOS API
 #include "freertos/task.h"     // Task management
 #include "esp_wifi.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_http_server.h"
-#include "cJSON.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 
 #include "btd_config.h"
+#include "btd_config_json.h"
 #include "btd_http.h"
 #include "btd_webui.h"
 #include "btd_wifi.h"
 #include "btd_stats.h"
+#include "btd_imu.h"
+#include "btd_imulog.h"
+#include "btd_looptime.h"
+#include "btd_button.h"
+#include "btd_battery.h"
+#include "btd_display.h"
+#include "btd_energy.h"
+#include "btd_telemetry.h"
 #include "freertos/semphr.h"
 
 static const char *TAG = "BTD_HTTP";
 
+#define HTTP_MAX_OPEN_SOCKETS 4
+
 static esp_netif_t *netif = NULL; // Pointer to the network interface, if needed
 static httpd_handle_t server = NULL;
 
+// set when someone connects to the AP, for the automatic QR code switch
+static volatile bool someone_connected = false;
+
 // --- forward declarations of the handler functions
 esp_err_t get_config_handler(httpd_req_t *req);
 esp_err_t save_config_handler(httpd_req_t *req);
 esp_err_t factoryreset_handler(httpd_req_t *req);
-esp_err_t root_handler(httpd_req_t *req);
 esp_err_t stats_handler(httpd_req_t *req);
+esp_err_t imulog_handler(httpd_req_t *req);
+esp_err_t looptime_handler(httpd_req_t *req);
+esp_err_t battery_handler(httpd_req_t *req);
+esp_err_t display_handler(httpd_req_t *req);
+esp_err_t get_energy_handler(httpd_req_t *req);
+esp_err_t reset_energy_handler(httpd_req_t *req);
+#if CONFIG_BTD_WS_TELEMETRY
+esp_err_t ws_handler(httpd_req_t *req);
+static esp_err_t start_ws_telemetry(void);
+static void stop_ws_telemetry(void);
+#endif
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base,
+                               int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED)
+    {
+        someone_connected = true;
+        ESP_LOGI(TAG, "A station connected to the AP");
+    }
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STADISCONNECTED)
+    {
+        someone_connected = false;
+        ESP_LOGI(TAG, "A station disconnected from the AP");
+    }
+}
+
+esp_err_t init_http_server(void)
+{
+    static bool initialized = false; // on the first start_http_server(), not at boot
+    if (initialized)
+        return ESP_OK;
+    initialized = true;
+    // apparently its still needed??? even tho it errors? heck if I know
+    // but yea, dont check if it errors - it just worksTM, sorry for the hack
+    esp_event_loop_create_default();
+    ESP_ERROR_CHECK(esp_netif_init());
+    return esp_event_handler_instance_register(
+        WIFI_EVENT,
+        ESP_EVENT_ANY_ID,
+        &wifi_event_handler,
+        NULL,
+        NULL);
+}
+
+bool http_station_connected(void)
+{
+    return someone_connected;
+}
 
 esp_err_t start_wifi_ap(const char *ssid, const char *password)
 {
@@ -49,6 +113,7 @@ esp_err_t start_wifi_ap(const char *ssid, const char *password)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    energy_set_feature(ENERGY_FEATURE_WIFI_AP, true);
 
     ESP_LOGI(TAG, "Wi-Fi AP configured. SSID: %s, PW: %s", ssid, password);
     return ESP_OK;
@@ -64,17 +129,19 @@ esp_err_t stop_wifi_ap()
     }
     ESP_ERROR_CHECK(esp_wifi_stop());
     ESP_ERROR_CHECK(esp_wifi_deinit());
+    energy_set_feature(ENERGY_FEATURE_WIFI_AP, false);
     ESP_LOGI(TAG, "Wi-Fi AP stopped and deinitialized");
     return ESP_OK;
 }
 
 esp_err_t start_http_server(const char *ssid, const char *password)
 {
+    ESP_ERROR_CHECK(init_http_server());
     ESP_ERROR_CHECK(start_wifi_ap(ssid, password));
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_open_sockets = 4;
-    config.max_uri_handlers = 8;
+    config.max_open_sockets = HTTP_MAX_OPEN_SOCKETS;
+    config.max_uri_handlers = 13;
 
     // Start the HTTP server
     esp_err_t ret = httpd_start(&server, &config);
@@ -104,14 +171,53 @@ esp_err_t start_http_server(const char *ssid, const char *password)
         {.uri = "/stats",
          .method = HTTP_GET,
          .handler = stats_handler,
-         .user_ctx = NULL}};
+         .user_ctx = NULL},
+        {.uri = "/imulog",
+         .method = HTTP_GET,
+         .handler = imulog_handler,
+         .user_ctx = NULL},
+        {.uri = "/looptime",
+         .method = HTTP_GET,
+         .handler = looptime_handler,
+         .user_ctx = NULL},
+        {.uri = "/battery",
+         .method = HTTP_GET,
+         .handler = battery_handler,
+         .user_ctx = NULL},
+        {.uri = "/display",
+         .method = HTTP_GET,
+         .handler = display_handler,
+         .user_ctx = NULL},
+        {.uri = "/energy",
+         .method = HTTP_GET,
+         .handler = get_energy_handler,
+         .user_ctx = NULL},
+        {.uri = "/energy",
+         .method = HTTP_POST,
+         .handler = reset_energy_handler,
+         .user_ctx = NULL},
+#if CONFIG_BTD_WS_TELEMETRY
+        {.uri = "/ws",
+         .method = HTTP_GET,
+         .handler = ws_handler,
+         .user_ctx = NULL,
+         .is_websocket = true},
+#endif
+    };
     // Register URI handlers
     for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
     {
         ESP_ERROR_CHECK(httpd_register_uri_handler(server, &uris[i]));
     }
 
-    ESP_LOGI(TAG, "HTTP server started successfully");
+#if CONFIG_BTD_WS_TELEMETRY
+    ESP_ERROR_CHECK(start_ws_telemetry());
+#endif
+
+    size_t web_ui_len = 0;
+    get_web_ui_gz(&web_ui_len);
+    ESP_LOGI(TAG, "HTTP server started successfully, web UI %u B gzip of %u B",
+             (unsigned)web_ui_len, (unsigned)get_web_ui_raw_size());
     return ESP_OK;
 }
 
@@ -119,6 +225,9 @@ esp_err_t stop_http_server()
 {
     if (server)
     {
+#if CONFIG_BTD_WS_TELEMETRY
+        stop_ws_telemetry();
+#endif
         httpd_stop(server);
         server = NULL;
         ESP_LOGI(TAG, "HTTP server stopped successfully");
@@ -130,59 +239,33 @@ esp_err_t stop_http_server()
 
 esp_err_t get_config_handler(httpd_req_t *req)
 {
+    static char response[CONFIG_JSON_MAX_LEN];
     btd_config_t config;
-    cJSON *json = cJSON_CreateObject();
-    char *response = NULL;
-    esp_err_t resp_err = ESP_OK;
-
-    // Create a JSON response with the configuration
-    resp_err = btd_read_config(&config);
-    if (resp_err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to read configuration: %s", esp_err_to_name(resp_err));
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read configuration");
-        goto cleanup;
-    }
 
-    if (!json)
+    esp_err_t err = btd_read_config(&config);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to create JSON object");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON object");
-        resp_err = ESP_ERR_NO_MEM;
-        goto cleanup;
+        ESP_LOGE(TAG, "Failed to read configuration: %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read configuration");
     }
 
-    cJSON_AddNumberToObject(json, "workTimeSeconds", config.workTimeSeconds);
-    cJSON_AddNumberToObject(json, "breakTimeSeconds", config.breakTimeSeconds);
-    cJSON_AddNumberToObject(json, "longBreakTimeSeconds", config.longBreakTimeSeconds);
-    cJSON_AddNumberToObject(json, "longBreakSessionCount", config.longBreakSessionCount);
-    cJSON_AddNumberToObject(json, "timeoutSeconds", config.timeoutSeconds);
-    cJSON_AddBoolToObject(json, "breakGestureEnabled", config.breakGestureEnabled);
-
-    response = cJSON_PrintUnformatted(json);
-    if (!response)
+    size_t len = config_json_write(&config, response, sizeof(response));
+    if (len == 0)
     {
-        ESP_LOGE(TAG, "Failed to print JSON object");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to print JSON object");
-        resp_err = ESP_ERR_NO_MEM;
-        goto cleanup;
+        ESP_LOGE(TAG, "Configuration does not fit the response buffer");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write configuration");
     }
 
-    resp_err = httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-    if (resp_err != ESP_OK)
+    httpd_resp_set_type(req, "application/json");
+    err = httpd_resp_send(req, response, len);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to send response: %s", esp_err_to_name(resp_err));
-        goto cleanup;
+        ESP_LOGE(TAG, "Failed to send response: %s", esp_err_to_name(err));
+        return err;
     }
 
     ESP_LOGI(TAG, "Configuration sent successfully");
-
-cleanup:
-    if (response)
-        free(response);
-    if (json)
-        cJSON_Delete(json);
-    return resp_err;
+    return ESP_OK;
 }
 
 esp_err_t factoryreset_handler(httpd_req_t *req)
@@ -200,51 +283,53 @@ esp_err_t factoryreset_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-esp_err_t root_handler(httpd_req_t *req)
-{
-    // const char *response = "<html><body><h1>Welcome to the BTD HTTP Server</h1>"
-    //                       "<p>Use /config to get the current configuration.</p>"
-    //                       "<p>Use /factoryreset to reset to factory defaults.</p></body></html>";
-
-    const char *response = get_web_ui_html();
-    return httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-}
-
+// takes a json object with some or all fields of btd_config_t, the others keep their value
 esp_err_t save_config_handler(httpd_req_t *req)
 {
-    char content[256];
-    int ret = httpd_req_recv(req, content, sizeof(content) - 1);
-    if (ret <= 0)
+    static char content[CONFIG_JSON_MAX_LEN];
+    static char error[CONFIG_JSON_ERROR_LEN];
+    if (req->content_len > sizeof(content))
     {
-        ESP_LOGE(TAG, "Failed to receive request body");
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive request body");
+        ESP_LOGE(TAG, "Request body too large: %u bytes", (unsigned)req->content_len);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Request body too large");
     }
-    content[ret] = '\0'; // Null-terminate the received data
 
-    cJSON *json = cJSON_Parse(content);
-    if (!json)
+    // the body can arrive in several pieces
+    size_t received = 0;
+    while (received < req->content_len)
     {
-        ESP_LOGE(TAG, "Failed to parse JSON: %s", cJSON_GetErrorPtr());
-        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON format");
+        int ret = httpd_req_recv(req, content + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            continue;
+        if (ret <= 0)
+        {
+            ESP_LOGE(TAG, "Failed to receive request body");
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive request body");
+        }
+        received += ret;
     }
 
     btd_config_t config;
-    config.workTimeSeconds = cJSON_GetObjectItem(json, "workTimeSeconds")->valueint;
-    config.breakTimeSeconds = cJSON_GetObjectItem(json, "breakTimeSeconds")->valueint;
-    config.longBreakTimeSeconds = cJSON_GetObjectItem(json, "longBreakTimeSeconds")->valueint;
-    config.longBreakSessionCount = cJSON_GetObjectItem(json, "longBreakSessionCount")->valueint;
-    config.timeoutSeconds = cJSON_GetObjectItem(json, "timeoutSeconds")->valueint;
-    config.breakGestureEnabled = cJSON_IsTrue(cJSON_GetObjectItem(json, "breakGestureEnabled"));
-
-    esp_err_t err = btd_save_config(&config);
+    esp_err_t err = btd_read_config(&config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read configuration: %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read configuration");
+    }
+
+    if (config_json_parse(content, received, &config, error) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Invalid configuration: %s", error);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, error);
+    }
+
+    err = btd_save_config(&config);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to save configuration: %s", esp_err_to_name(err));
-        cJSON_Delete(json);
         return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save configuration");
     }
 
-    cJSON_Delete(json);
     httpd_resp_send(req, "Configuration saved successfully", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
@@ -252,8 +337,8 @@ esp_err_t save_config_handler(httpd_req_t *req)
 // retuns all sessions as csv
 esp_err_t stats_handler(httpd_req_t *req)
 {
-    static session_stats_t stats[32];
-    static char response[2048];
+    static session_stats_t stats[STATS_MAX_SESSIONS];
+    static char response[3072]; // STATS_MAX_SESSIONS rows with a full name
     size_t count = sizeof(stats) / sizeof(stats[0]);
     if (nvs_mutex)
         xSemaphoreTake(nvs_mutex, portMAX_DELAY);
@@ -272,15 +357,18 @@ esp_err_t stats_handler(httpd_req_t *req)
     }
     // Create a CSV response
     size_t response_len = 0;
-    response_len += snprintf(response, sizeof(response), "Session ID,Duration (s),Name,Mic Level\n");
+    response_len += snprintf(response, sizeof(response), "Session ID,Duration (s),Name,Mic Level,Steps,Cadence (steps/min),Display On (s)\n");
     for (size_t i = 0; i < count; i++)
     {
         response_len += snprintf(response + response_len, sizeof(response) - response_len,
-                                 "%lu,%lu,%s,%u\n",
-                                 stats[i].session_id,
-                                 stats[i].duration_seconds,
+                                 "%lu,%lu,%s,%u,%lu,%u,%u\n",
+                                 (unsigned long)stats[i].session_id,
+                                 (unsigned long)stats[i].duration_seconds,
                                  stats[i].name,
-                                 stats[i].mic_level);
+                                 stats[i].mic_level,
+                                 (unsigned long)stats[i].steps,
+                                 stats[i].cadence_spm,
+                                 stats[i].display_on_s);
         if (response_len >= sizeof(response))
         {
             ESP_LOGE(TAG, "Response buffer overflow");
@@ -297,3 +385,370 @@ esp_err_t stats_handler(httpd_req_t *req)
     ESP_LOGI(TAG, "Work sessions sent successfully");
     return ESP_OK;
 }
+
+// returns the cached battery estimate and the AXP192 readings behind it as csv
+esp_err_t battery_handler(httpd_req_t *req)
+{
+    btd_battery_status_t status;
+    char response[160];
+    battery_get_status(&status);
+    int len = snprintf(response, sizeof(response),
+                       "Percent,Time to empty (min),Voltage (V),Current (mA),Load (mA),Coulomb (mAh),Samples\n"
+                       "%d,%d,%.3f,%.1f,%.1f,%.2f,%lu\n",
+                       status.percent, status.time_to_empty_min, status.voltage_v, status.current_ma,
+                       status.load_ma, status.coulomb_mah, (unsigned long)status.samples);
+    httpd_resp_set_type(req, "text/csv");
+    return httpd_resp_send(req, response, len);
+}
+
+// runs the pixel throughput benchmark on the state loop and returns it as csv, the screen is cleared
+esp_err_t display_handler(httpd_req_t *req)
+{
+    display_bench_t bench;
+    char response[224];
+    if (!display_request_benchmark(&bench, 2000))
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Benchmark not run");
+    float fill_mpx_s = bench.fill_screen_us > 0 ? 240.0f * 135.0f / bench.fill_screen_us : 0.0f;
+    int len = snprintf(response, sizeof(response),
+                       "SPI clock (MHz),Verified,Fill screen (us),Fill (Mpx/s),%d rects (us),%d rects batched (us)\n"
+                       "%.2f,%d,%lu,%.2f,%lu,%lu\n",
+                       DISPLAY_BENCH_RECTS, DISPLAY_BENCH_RECTS, bench.spi_hz / 1e6f, bench.spi_verified,
+                       (unsigned long)bench.fill_screen_us, fill_mpx_s, (unsigned long)bench.rects_us,
+                       (unsigned long)bench.rects_batched_us);
+    httpd_resp_set_type(req, "text/csv");
+    return httpd_resp_send(req, response, len);
+}
+
+static size_t format_energy_row(char *out, size_t size, const char *kind, const char *name, const energy_total_t *total)
+{
+    float hours = total->time_ms / 3600000.0f;
+    return snprintf(out, size, "%s,%s,%.1f,%.3f,%.1f\n", kind, name, total->time_ms / 1000.0f,
+                    total->charge_mah, hours > 0.0f ? total->charge_mah / hours : 0.0f);
+}
+
+// returns the charge drawn per state and while each feature was on as csv, summed over reboots
+esp_err_t get_energy_handler(httpd_req_t *req)
+{
+    static energy_totals_t totals;
+    static char response[768];
+    energy_get_totals(&totals);
+    size_t len = snprintf(response, sizeof(response), "samples,%lu\n\nkind,name,time_s,charge_mah,mean_ma\n",
+                          (unsigned long)totals.samples);
+    for (int i = 0; i < ENERGY_STATES; i++)
+        len += format_energy_row(response + len, sizeof(response) - len, "state", energy_state_name(i), &totals.states[i]);
+    for (int i = 0; i < ENERGY_FEATURES; i++)
+        len += format_energy_row(response + len, sizeof(response) - len, "feature", energy_feature_name(i), &totals.features[i]);
+    if (len >= sizeof(response))
+    {
+        ESP_LOGE(TAG, "Response buffer overflow");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response buffer overflow");
+    }
+    httpd_resp_set_type(req, "text/csv");
+    return httpd_resp_send(req, response, len);
+}
+
+// clears the energy totals, for measuring from a known point
+esp_err_t reset_energy_handler(httpd_req_t *req)
+{
+    esp_err_t err = energy_reset();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to reset energy totals: %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to reset energy totals");
+    }
+    return httpd_resp_send(req, "Energy totals reset", HTTPD_RESP_USE_STRLEN);
+}
+
+#define IMULOG_CSV_BATCH 32
+
+typedef struct
+{
+    httpd_req_t *req;
+    btd_delta_decoder_t decoder;
+    float resolution;
+    esp_err_t err;
+} imulog_csv_ctx_t;
+
+static void send_imulog_csv(const uint8_t *data, size_t len, void *arg)
+{
+    static int16_t samples[IMULOG_CSV_BATCH][BTD_DELTA_AXES];
+    static char chunk[IMULOG_CSV_BATCH * 40];
+    imulog_csv_ctx_t *ctx = (imulog_csv_ctx_t *)arg;
+
+    while (len > 0 && ctx->err == ESP_OK)
+    {
+        size_t used = 0;
+        int count = delta_decode(&ctx->decoder, data, len, samples, IMULOG_CSV_BATCH, &used);
+        if (count < 0)
+        {
+            ESP_LOGE(TAG, "IMU log is corrupted");
+            ctx->err = ESP_FAIL;
+            return;
+        }
+        data += used;
+        len -= used;
+
+        size_t chunk_len = 0;
+        for (int i = 0; i < count; i++)
+        {
+            chunk_len += snprintf(chunk + chunk_len, sizeof(chunk) - chunk_len, "%f,%f,%f\n",
+                                  samples[i][0] * ctx->resolution,
+                                  samples[i][1] * ctx->resolution,
+                                  samples[i][2] * ctx->resolution);
+        }
+        if (chunk_len > 0)
+            ctx->err = httpd_resp_send_chunk(ctx->req, chunk, chunk_len);
+    }
+}
+
+// returns the accelerometer log of the last working session as csv (x,y,z in g, 100 Hz), 409 during a session
+esp_err_t imulog_handler(httpd_req_t *req)
+{
+    static imulog_csv_ctx_t ctx;
+    ctx.req = req;
+    ctx.resolution = getAccelResolution();
+    ctx.err = ESP_OK;
+    delta_decoder_init(&ctx.decoder, IMULOG_KEYFRAME_INTERVAL);
+
+    httpd_resp_set_type(req, "text/csv");
+    if (!imulog_read(send_imulog_csv, &ctx))
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_sendstr(req, "A working session is recording, the log can be read after it");
+    }
+    if (ctx.err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to send IMU log: %s", esp_err_to_name(ctx.err));
+        return ctx.err;
+    }
+
+    ESP_LOGI(TAG, "IMU log with %u samples sent successfully", (unsigned)imulog_sample_count());
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static size_t format_looptime_summary(char *out, size_t size, const char *name, const looptime_hist_t *hist)
+{
+    uint32_t mean_us = hist->count ? hist->sum_us / hist->count : 0;
+    return snprintf(out, size, "%s,%lu,%lu,%lu,%lu,%lu,%lu\n", name,
+                    (unsigned long)hist->count, (unsigned long)mean_us,
+                    (unsigned long)looptime_percentile(hist, 50), (unsigned long)looptime_percentile(hist, 99),
+                    (unsigned long)looptime_percentile(hist, 99.9f), (unsigned long)hist->max_us);
+}
+
+#define LOOPTIME_LINE_MAX 40
+
+static esp_err_t send_looptime_buckets(httpd_req_t *req, char *buffer, size_t size,
+                                       const char *name, const looptime_hist_t *hist)
+{
+    size_t len = 0;
+    for (int i = 0; i < LOOPTIME_BUCKETS; i++)
+    {
+        if (hist->buckets[i] == 0)
+            continue;
+        len += snprintf(buffer + len, size - len, "%s,%lu,%lu\n", name,
+                        (unsigned long)looptime_bucket_upper_us(i), (unsigned long)hist->buckets[i]);
+        if (len + LOOPTIME_LINE_MAX > size)
+        {
+            esp_err_t err = httpd_resp_send_chunk(req, buffer, len);
+            if (err != ESP_OK)
+                return err;
+            len = 0;
+        }
+    }
+    return len > 0 ? httpd_resp_send_chunk(req, buffer, len) : ESP_OK;
+}
+
+// returns the sampling loop timing of the last working session as csv:
+// a summary per stage, then the non-empty histogram buckets (durations below upper_us);
+// the button row is the latency from the button edge to the state loop since boot
+esp_err_t looptime_handler(httpd_req_t *req)
+{
+    static looptime_stats_t stats;
+    static looptime_hist_t button_latency;
+    static char response[1024];
+    uint32_t button_dropped;
+    looptime_snapshot(&stats);
+    btn_latency_snapshot(&button_latency, &button_dropped);
+
+    httpd_resp_set_type(req, "text/csv");
+    size_t len = snprintf(response, sizeof(response),
+                          "iterations,%lu\ndeadline_misses,%lu\nperiod_us,%lu\nbutton_events_dropped,%lu\n\n"
+                          "stage,count,mean_us,p50_us,p99_us,p999_us,max_us\n",
+                          (unsigned long)stats.iterations, (unsigned long)stats.deadline_misses,
+                          (unsigned long)stats.period_us, (unsigned long)button_dropped);
+    len += format_looptime_summary(response + len, sizeof(response) - len, "period", &stats.period);
+    for (int i = 0; i < LOOP_STAGE_COUNT; i++)
+        len += format_looptime_summary(response + len, sizeof(response) - len,
+                                       looptime_stage_name(i), &stats.stages[i]);
+    len += format_looptime_summary(response + len, sizeof(response) - len, "button", &button_latency);
+    len += snprintf(response + len, sizeof(response) - len, "\nstage,upper_us,count\n");
+    esp_err_t err = httpd_resp_send_chunk(req, response, len);
+
+    if (err == ESP_OK)
+        err = send_looptime_buckets(req, response, sizeof(response), "period", &stats.period);
+    for (int i = 0; i < LOOP_STAGE_COUNT && err == ESP_OK; i++)
+        err = send_looptime_buckets(req, response, sizeof(response), looptime_stage_name(i), &stats.stages[i]);
+    if (err == ESP_OK)
+        err = send_looptime_buckets(req, response, sizeof(response), "button", &button_latency);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to send loop timing: %s", esp_err_to_name(err));
+        return err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+#if CONFIG_BTD_WS_TELEMETRY
+// Live telemetry at /ws: binary btd_telemetry_frame_t frames at CONFIG_BTD_WS_RATE_HZ.
+// A periodic esp_timer queues the broadcast onto the server task, which serializes
+// one frame and sends the same buffer to every websocket client. Nothing is
+// allocated per frame: the frame is static and httpd_ws_send_frame_async writes
+// the header from the stack (unlike httpd_ws_send_data_async, which mallocs a job).
+
+#define WS_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+static esp_timer_handle_t ws_timer = NULL;
+static volatile bool ws_broadcast_queued = false;
+
+static struct
+{
+    uint32_t broadcasts; // frames serialized
+    uint32_t frames;     // frames sent, one per client and broadcast
+    uint32_t errors;     // failed sends, the client is closed
+    uint32_t skipped;    // timer ticks while the previous broadcast was still queued
+    int clients;         // websocket clients at the last broadcast
+    uint32_t free_heap;  // at the start of the stats interval
+    int64_t since_us;
+} ws_stats;
+
+static void log_ws_stats(int64_t now_us)
+{
+    uint32_t free_heap = esp_get_free_heap_size();
+    float seconds = (now_us - ws_stats.since_us) / 1e6f;
+    ESP_LOGI(TAG, "ws: %d clients, %.1f frames/s, %lu sends, %lu errors, %lu skipped, heap %ld B (min free %lu B)",
+             ws_stats.clients, ws_stats.broadcasts / seconds, (unsigned long)ws_stats.frames,
+             (unsigned long)ws_stats.errors, (unsigned long)ws_stats.skipped,
+             (long)free_heap - (long)ws_stats.free_heap, (unsigned long)esp_get_minimum_free_heap_size());
+
+    ws_stats.broadcasts = 0;
+    ws_stats.frames = 0;
+    ws_stats.errors = 0;
+    ws_stats.skipped = 0;
+    ws_stats.free_heap = free_heap;
+    ws_stats.since_us = now_us;
+}
+
+// runs on the server task
+static void ws_broadcast(void *arg)
+{
+    static btd_telemetry_frame_t frame;
+    static int fds[HTTP_MAX_OPEN_SOCKETS];
+    ws_broadcast_queued = false;
+    if (!server)
+        return;
+
+    size_t count = sizeof(fds) / sizeof(fds[0]);
+    if (httpd_get_client_list(server, &count, fds) != ESP_OK)
+        return;
+
+    int clients = 0;
+    httpd_ws_frame_t ws_frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_BINARY,
+        .payload = (uint8_t *)&frame,
+        .len = sizeof(frame),
+    };
+    for (size_t i = 0; i < count; i++)
+    {
+        if (httpd_ws_get_fd_info(server, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET)
+            continue;
+        if (clients++ == 0)
+            telemetry_serialize(&frame); // only when someone listens, keeps seq gap free per client
+
+        if (httpd_ws_send_frame_async(server, fds[i], &ws_frame) == ESP_OK)
+        {
+            ws_stats.frames++;
+        }
+        else
+        {
+            ws_stats.errors++;
+            httpd_sess_trigger_close(server, fds[i]);
+        }
+    }
+    ws_stats.clients = clients;
+    if (clients > 0)
+        ws_stats.broadcasts++;
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - ws_stats.since_us >= WS_STATS_INTERVAL_US)
+        log_ws_stats(now_us);
+}
+
+static void ws_timer_callback(void *arg)
+{
+    if (ws_broadcast_queued)
+    {
+        ws_stats.skipped++;
+        return;
+    }
+    ws_broadcast_queued = true;
+    if (httpd_queue_work(server, ws_broadcast, NULL) != ESP_OK)
+        ws_broadcast_queued = false;
+}
+
+static esp_err_t start_ws_telemetry(void)
+{
+    memset(&ws_stats, 0, sizeof(ws_stats));
+    ws_stats.free_heap = esp_get_free_heap_size();
+    ws_stats.since_us = esp_timer_get_time();
+    ws_broadcast_queued = false;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = ws_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ws_telemetry",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &ws_timer);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create telemetry timer: %s", esp_err_to_name(err));
+        return err;
+    }
+    return esp_timer_start_periodic(ws_timer, 1000000 / CONFIG_BTD_WS_RATE_HZ);
+}
+
+static void stop_ws_telemetry(void)
+{
+    if (ws_timer)
+    {
+        esp_timer_stop(ws_timer);
+        esp_timer_delete(ws_timer);
+        ws_timer = NULL;
+    }
+}
+
+// the handshake and frames sent by clients end up here, the stream is send only
+esp_err_t ws_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET)
+    {
+        ESP_LOGI(TAG, "Telemetry client connected");
+        return ESP_OK;
+    }
+
+    // read and drop the payload so the socket stays in sync
+    static uint8_t discard[64];
+    httpd_ws_frame_t ws_frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &ws_frame, 0);
+    if (err != ESP_OK || ws_frame.len == 0)
+        return err;
+    if (ws_frame.len > sizeof(discard))
+        return ESP_ERR_INVALID_SIZE; // closes the connection
+    ws_frame.payload = discard;
+    return httpd_ws_recv_frame(req, &ws_frame, ws_frame.len);
+}
+#endif
@@ -3,10 +3,28 @@
 #define BT_HTTP_H
 
 #include "freertos/semphr.h"
+#include <stdbool.h>
 #include "esp_err.h"
 
 extern SemaphoreHandle_t nvs_mutex;
 
+/*
+ * @brief Initializes the event loop and netif and registers the Wi-Fi AP event handler.
+ *
+ * start_http_server() calls it on its first start, later calls do nothing; call it
+ * directly before using Wi-Fi without the server (location fingerprint).
+ *
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t init_http_server(void);
+
+/*
+ * @brief Reports whether a station is connected to the access point.
+ *
+ * @return true while at least one client is connected to the AP.
+ */
+bool http_station_connected(void);
+
 /*
  * @brief Starts the HTTP server with the given SSID and password.
  *
@@ -2,6 +2,9 @@
 #include "esp_log.h"
 #include <math.h>
 
+#include "btd_imu.h"
+#include "btd_rates.h"
+
 static const char *TAG = "IMU";
 
 float getAccelMagnitude(void)
@@ -11,8 +14,72 @@ float getAccelMagnitude(void)
     return sqrtf(ax * ax + ay * ay + az * az);
 }
 
+void getAccelAdc(int16_t *ax, int16_t *ay, int16_t *az)
+{
+    M5.IMU.getAccelAdc(ax, ay, az);
+}
+
+float getAccelResolution(void)
+{
+    return M5.IMU.aRes;
+}
+
+float getAccelMagnitudeFromAdc(int16_t ax, int16_t ay, int16_t az)
+{
+    float x = ax * M5.IMU.aRes;
+    float y = ay * M5.IMU.aRes;
+    float z = az * M5.IMU.aRes;
+    return sqrtf(x * x + y * y + z * z);
+}
+
+void getGyroAdc(int16_t *gx, int16_t *gy, int16_t *gz)
+{
+    M5.IMU.getGyroAdc(gx, gy, gz);
+}
+
+float getGyroResolution(void)
+{
+    return M5.IMU.gRes;
+}
+
+int getImuSamples(btd_imu_raw_t *samples, int max)
+{
+    if (max < 1)
+        return 0;
+#if IMU_RATE_HZ > LOOP_RATE_HZ
+    int16_t data[7]; // ax, ay, az, gx, gy, gz, temperature
+    int count = 0;
+    while (count < max && M5.IMU.getFIFOData(data) == 0) // an empty FIFO reads 0x7F7F
+    {
+        btd_imu_raw_t *sample = &samples[count++];
+        sample->ax = data[0];
+        sample->ay = data[1];
+        sample->az = data[2];
+        sample->gx = data[3];
+        sample->gy = data[4];
+        sample->gz = data[5];
+    }
+    return count;
+#else
+    M5.IMU.getAccelAdc(&samples->ax, &samples->ay, &samples->az);
+    M5.IMU.getGyroAdc(&samples->gx, &samples->gy, &samples->gz);
+    return 1;
+#endif
+}
+
+void resetImuSamples(void)
+{
+#if IMU_RATE_HZ > LOOP_RATE_HZ
+    M5.IMU.resetFIFO();
+#endif
+}
+
 void init_imu(void)
 {
     M5.Imu.Init();
-    ESP_LOGI(TAG, "MPU6866 intialized successfully");
+#if IMU_RATE_HZ > LOOP_RATE_HZ
+    // sample rate divider of the 1 kHz internal rate, accel, gyro and temperature go into the FIFO
+    M5.IMU.enableFIFO((MPU6886::Fodr)(1000 / IMU_RATE_HZ - 1));
+#endif
+    ESP_LOGI(TAG, "MPU6866 intialized successfully, %d Hz", IMU_RATE_HZ);
 }
@@ -1,5 +1,62 @@
 #pragma once
 
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    int16_t ax, ay, az; // ADC counts, see getAccelResolution()
+    int16_t gx, gy, gz; // ADC counts, see getGyroResolution()
+} btd_imu_raw_t;
+
+/*
+    sets up the MPU6886 for IMU_RATE_HZ (btd_rates.h), with the FIFO above the loop rate
+*/
 void init_imu(void);
 void getAccelData(float *ax, float *ay, float *az);
-float getAccelMagnitude(void);
\ No newline at end of file
+float getAccelMagnitude(void);
+
+/*
+    Out: raw accelerometer reading in ADC counts
+*/
+void getAccelAdc(int16_t *ax, int16_t *ay, int16_t *az);
+
+/*
+    Out: g per ADC count for the configured accelerometer range
+*/
+float getAccelResolution(void);
+
+/*
+    In: raw accelerometer reading in ADC counts
+    Out: magnitude of the acceleration in g
+*/
+float getAccelMagnitudeFromAdc(int16_t ax, int16_t ay, int16_t az);
+
+/*
+    Out: raw gyroscope reading in ADC counts
+*/
+void getGyroAdc(int16_t *gx, int16_t *gy, int16_t *gz);
+
+/*
+    Out: degrees per second per ADC count for the configured gyroscope range
+*/
+float getGyroResolution(void);
+
+/*
+    In: buffer for at most max samples
+    Out: samples taken since the last call, oldest first, at IMU_RATE_HZ from the FIFO;
+    one current reading when the IMU runs at the loop rate
+*/
+int getImuSamples(btd_imu_raw_t *samples, int max);
+
+/*
+    drops the samples collected so far, e.g. the FIFO overflowing between working sessions
+*/
+void resetImuSamples(void);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
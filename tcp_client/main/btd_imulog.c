@@ -0,0 +1,116 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "btd_imulog.h"
+
+// Delta coded flight recorder of the raw accelerometer stream.
+// The bytes live in a ring buffer, split into blocks that each start at a
+// keyframe. When the ring is full the oldest block is dropped, so a reader can
+// always start decoding at the tail.
+// The state loop appends without a lock: reads are refused while a session
+// records, and starting a session waits for a read in progress.
+
+#define IMULOG_CAPACITY (CONFIG_BTD_IMULOG_SIZE_KB * 1024)
+// a block needs at least one byte per axis and sample
+#define IMULOG_MAX_BLOCKS (IMULOG_CAPACITY / (IMULOG_KEYFRAME_INTERVAL * BTD_DELTA_AXES) + 2)
+
+static uint8_t buffer[IMULOG_CAPACITY];
+static uint32_t head = 0; // total bytes written
+static uint32_t tail = 0; // start of the oldest block
+
+static uint32_t block_start[IMULOG_MAX_BLOCKS]; // byte position of each block, ring
+static int first_block = 0;
+static int block_count = 0;
+
+static size_t sample_count = 0;
+static btd_delta_encoder_t encoder = {.keyframe_interval = IMULOG_KEYFRAME_INTERVAL};
+static SemaphoreHandle_t read_mutex = NULL; // recording and imulog_read()
+static bool recording = false;
+
+void imulog_init(void)
+{
+    read_mutex = xSemaphoreCreateMutex();
+}
+
+void imulog_start(void)
+{
+    xSemaphoreTake(read_mutex, portMAX_DELAY);
+    recording = true;
+    head = 0;
+    tail = 0;
+    first_block = 0;
+    block_count = 0;
+    sample_count = 0;
+    delta_encoder_init(&encoder, IMULOG_KEYFRAME_INTERVAL);
+    xSemaphoreGive(read_mutex);
+}
+
+void imulog_stop(void)
+{
+    xSemaphoreTake(read_mutex, portMAX_DELAY);
+    recording = false;
+    xSemaphoreGive(read_mutex);
+}
+
+static void drop_oldest_block(void)
+{
+    first_block = (first_block + 1) % IMULOG_MAX_BLOCKS;
+    block_count--;
+    tail = block_start[first_block];
+    sample_count -= IMULOG_KEYFRAME_INTERVAL;
+}
+
+void imulog_append(int16_t ax, int16_t ay, int16_t az)
+{
+    if (encoder.since_keyframe == 0)
+    {
+        if (block_count == IMULOG_MAX_BLOCKS)
+            drop_oldest_block();
+        block_start[(first_block + block_count) % IMULOG_MAX_BLOCKS] = head;
+        block_count++;
+    }
+
+    const int16_t sample[BTD_DELTA_AXES] = {ax, ay, az};
+    uint8_t encoded[BTD_DELTA_MAX_SAMPLE_BYTES];
+    size_t len = delta_encode_sample(&encoder, sample, encoded);
+
+    // the block being written is never dropped, the ring holds many blocks
+    while (head + len - tail > IMULOG_CAPACITY)
+        drop_oldest_block();
+
+    for (size_t i = 0; i < len; i++)
+        buffer[(head + i) % IMULOG_CAPACITY] = encoded[i];
+    head += len;
+    sample_count++;
+}
+
+size_t imulog_sample_count(void)
+{
+    return sample_count;
+}
+
+bool imulog_read(void (*consume)(const uint8_t *data, size_t len, void *ctx), void *ctx)
+{
+    xSemaphoreTake(read_mutex, portMAX_DELAY);
+    if (recording)
+    {
+        xSemaphoreGive(read_mutex);
+        return false;
+    }
+
+    uint32_t start = tail % IMULOG_CAPACITY;
+    uint32_t len = head - tail;
+    if (start + len <= IMULOG_CAPACITY)
+    {
+        consume(&buffer[start], len, ctx);
+    }
+    else
+    {
+        consume(&buffer[start], IMULOG_CAPACITY - start, ctx);
+        consume(&buffer[0], start + len - IMULOG_CAPACITY, ctx);
+    }
+    xSemaphoreGive(read_mutex);
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef BTD_IMULOG_H
+#define BTD_IMULOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "btd_delta.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the log drops whole keyframe blocks (one second at 100 Hz) when it is full
+#define IMULOG_KEYFRAME_INTERVAL BTD_DELTA_KEYFRAME_INTERVAL
+
+/*
+    creates the lock, call once before the HTTP server can read the log
+*/
+void imulog_init(void);
+
+/*
+    Clears the log, call at the start of a session
+    waits for a running imulog_read()
+*/
+void imulog_start(void);
+
+/*
+    ends the recording of the session, the log can be read from now on
+*/
+void imulog_stop(void);
+
+/*
+    In: raw accelerometer sample in ADC counts
+    Appends the sample, overwriting the oldest keyframe block when the log is full
+*/
+void imulog_append(int16_t ax, int16_t ay, int16_t az);
+
+/*
+    Out: number of samples currently held in the log
+*/
+size_t imulog_sample_count(void);
+
+/*
+    In: callback that gets the encoded log in order, possibly in two parts (ring wrap-around)
+    Out: false while a session records, the callback is not called then
+    The first part always starts at a keyframe, decode with delta_decode()
+    and IMULOG_KEYFRAME_INTERVAL.
+*/
+bool imulog_read(void (*consume)(const uint8_t *data, size_t len, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_IMULOG_H
@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "btd_looptime.h"
+
+static const char *TAG = "BTD_LOOPTIME";
+
+static const char *stage_names[LOOP_STAGE_COUNT] = {"imu", "fusion", "audio", "detectors", "display"};
+
+static looptime_stats_t stats;
+static int64_t last_iteration_us = -1;
+
+static int bucket_index(uint32_t value_us)
+{
+    if (value_us < (1 << LOOPTIME_SUB_BITS))
+        return value_us;
+    if (value_us >= LOOPTIME_MAX_US)
+        return LOOPTIME_BUCKETS - 1;
+
+    int exponent = 31 - __builtin_clz(value_us);
+    int shift = exponent - LOOPTIME_SUB_BITS;
+    int sub_bucket = (value_us >> shift) & ((1 << LOOPTIME_SUB_BITS) - 1);
+    return ((shift + 1) << LOOPTIME_SUB_BITS) + sub_bucket;
+}
+
+uint32_t looptime_bucket_upper_us(int bucket)
+{
+    if (bucket < (1 << LOOPTIME_SUB_BITS))
+        return bucket + 1;
+
+    int shift = (bucket >> LOOPTIME_SUB_BITS) - 1;
+    int sub_bucket = bucket & ((1 << LOOPTIME_SUB_BITS) - 1);
+    return (((1 << LOOPTIME_SUB_BITS) + sub_bucket + 1) << shift);
+}
+
+void looptime_record(looptime_hist_t *hist, uint32_t value_us)
+{
+    hist->buckets[bucket_index(value_us)]++;
+    hist->sum_us += value_us;
+    if (value_us > hist->max_us)
+        hist->max_us = value_us;
+    hist->count++;
+}
+
+void looptime_reset(uint32_t period_us)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.period_us = period_us;
+    last_iteration_us = -1;
+}
+
+void looptime_iteration(int64_t now_us, bool deadline_missed)
+{
+    if (last_iteration_us >= 0)
+        looptime_record(&stats.period, now_us - last_iteration_us);
+    last_iteration_us = now_us;
+    stats.iterations++;
+    if (deadline_missed)
+        stats.deadline_misses++;
+}
+
+void looptime_stage(loop_stage_t stage, uint32_t duration_us)
+{
+    looptime_record(&stats.stages[stage], duration_us);
+}
+
+void looptime_snapshot(looptime_stats_t *out)
+{
+    memcpy(out, &stats, sizeof(looptime_stats_t));
+}
+
+uint32_t looptime_percentile(const looptime_hist_t *hist, float percentile)
+{
+    if (hist->count == 0)
+        return 0;
+
+    uint32_t rank = (uint32_t)(percentile / 100.0f * hist->count + 0.999f);
+    if (rank == 0)
+        rank = 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < LOOPTIME_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+            return looptime_bucket_upper_us(i);
+    }
+    return looptime_bucket_upper_us(LOOPTIME_BUCKETS - 1);
+}
+
+const char *looptime_stage_name(loop_stage_t stage)
+{
+    return stage_names[stage];
+}
+
+static void log_hist(const char *name, const looptime_hist_t *hist)
+{
+    if (hist->count == 0)
+        return;
+    ESP_LOGI(TAG, "%-9s n=%lu mean=%lu us p50<%lu us p99<%lu us max=%lu us", name,
+             (unsigned long)hist->count, (unsigned long)(hist->sum_us / hist->count),
+             (unsigned long)looptime_percentile(hist, 50), (unsigned long)looptime_percentile(hist, 99),
+             (unsigned long)hist->max_us);
+}
+
+void looptime_log(void)
+{
+    static looptime_stats_t snapshot;
+    looptime_snapshot(&snapshot);
+
+    log_hist("period", &snapshot.period);
+    for (int i = 0; i < LOOP_STAGE_COUNT; i++)
+        log_hist(stage_names[i], &snapshot.stages[i]);
+    ESP_LOGI(TAG, "deadline misses: %lu of %lu iterations (period %lu us)",
+             (unsigned long)snapshot.deadline_misses, (unsigned long)snapshot.iterations,
+             (unsigned long)snapshot.period_us);
+}
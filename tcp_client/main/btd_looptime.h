@@ -0,0 +1,104 @@
+#ifndef BTD_LOOPTIME_H
+#define BTD_LOOPTIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timing instrumentation of the 100 Hz sampling loop.
+// Durations go into log-linear histograms: 8 buckets per power of two, so a
+// bucket is at most 12.5% wide (1 ms around the 10 ms period). Values of
+// LOOPTIME_MAX_US and above land in the last bucket.
+// The sampling loop is the only writer. Readers (HTTP server, logging) take
+// snapshots without locking; a snapshot taken during an update can be off by
+// the sample being recorded.
+
+#define LOOPTIME_SUB_BITS 3
+#define LOOPTIME_MAX_BITS 17 // 131 ms
+#define LOOPTIME_MAX_US (1 << LOOPTIME_MAX_BITS)
+#define LOOPTIME_BUCKETS ((LOOPTIME_MAX_BITS - LOOPTIME_SUB_BITS + 1) << LOOPTIME_SUB_BITS)
+
+typedef enum
+{
+    LOOP_STAGE_IMU,       // accelerometer and gyroscope read, IMU log
+    LOOP_STAGE_FUSION,    // orientation and linear acceleration, see btd_fusion.h
+    LOOP_STAGE_AUDIO,     // microphone read
+    LOOP_STAGE_DETECTORS, // walking, break gesture, auto off
+    LOOP_STAGE_DISPLAY,   // working time update
+    LOOP_STAGE_COUNT
+} loop_stage_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LOOPTIME_BUCKETS];
+} looptime_hist_t;
+
+typedef struct
+{
+    looptime_hist_t period; // time between the starts of two iterations
+    looptime_hist_t stages[LOOP_STAGE_COUNT];
+    uint32_t iterations;
+    uint32_t deadline_misses; // iterations that started after their wake time had passed
+    uint32_t period_us;       // nominal period
+} looptime_stats_t;
+
+/*
+    In: nominal loop period
+    clears all histograms, call from the sampling loop's task
+*/
+void looptime_reset(uint32_t period_us);
+
+/*
+    In: start time of the iteration, and whether the wait before it missed its deadline
+*/
+void looptime_iteration(int64_t now_us, bool deadline_missed);
+
+/*
+    In: stage and its duration in this iteration
+*/
+void looptime_stage(loop_stage_t stage, uint32_t duration_us);
+
+/*
+    In: histogram and a value
+    adds the value, for histograms outside the loop statistics (e.g. button latency)
+*/
+void looptime_record(looptime_hist_t *hist, uint32_t value_us);
+
+/*
+    Out: copy of the current statistics
+*/
+void looptime_snapshot(looptime_stats_t *stats);
+
+/*
+    In: histogram and percentile (0..100)
+    Out: upper bound of the bucket holding the percentile in us, 0 if the histogram is empty
+*/
+uint32_t looptime_percentile(const looptime_hist_t *hist, float percentile);
+
+/*
+    Out: upper bound of a bucket in us
+*/
+uint32_t looptime_bucket_upper_us(int bucket);
+
+/*
+    Out: short name of the stage
+*/
+const char *looptime_stage_name(loop_stage_t stage);
+
+/*
+    logs a summary line per histogram with ESP_LOGI
+*/
+void looptime_log(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_LOOPTIME_H
@@ -0,0 +1,133 @@
+#include <math.h>
+
+#include "btd_mahony.h"
+
+#define DEG_TO_RAD_F 0.017453293f
+#define RAD_TO_DEG_F 57.29578f
+
+MahonyFilter::MahonyFilter(float sampleFrequency, float kp, float ki)
+{
+    float dt = 1.0f / sampleFrequency;
+    halfDt = 0.5f * dt;
+    gyroScale = DEG_TO_RAD_F * halfDt;
+    kpHalfDt = 2.0f * kp * halfDt;
+    kiDt = 2.0f * ki * dt;
+    reset();
+}
+
+void MahonyFilter::reset()
+{
+    q0 = 1.0f;
+    q1 = q2 = q3 = 0.0f;
+    integralX = integralY = integralZ = 0.0f;
+    eulerValid = false;
+}
+
+void MahonyFilter::initFromAccel(float ax, float ay, float az)
+{
+    float r = atan2f(ay, az);
+    float p = atan2f(-ax, sqrtf(ay * ay + az * az));
+    float cr = cosf(0.5f * r), sr = sinf(0.5f * r);
+    float cp = cosf(0.5f * p), sp = sinf(0.5f * p);
+    q0 = cr * cp;
+    q1 = sr * cp;
+    q2 = cr * sp;
+    q3 = -sr * sp;
+    eulerValid = false;
+}
+
+inline void MahonyFilter::step(float gx, float gy, float gz, float ax, float ay, float az)
+{
+    gx *= gyroScale;
+    gy *= gyroScale;
+    gz *= gyroScale;
+
+    float normSq = ax * ax + ay * ay + az * az;
+    if (normSq > 0.0f) {
+        float recipNorm = 1.0f / sqrtf(normSq);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        // estimated direction of gravity, halved
+        float halfvx = q1 * q3 - q0 * q2;
+        float halfvy = q0 * q1 + q2 * q3;
+        float halfvz = q0 * q0 - 0.5f + q3 * q3;
+
+        // error between the measured and the estimated direction of gravity
+        float halfex = ay * halfvz - az * halfvy;
+        float halfey = az * halfvx - ax * halfvz;
+        float halfez = ax * halfvy - ay * halfvx;
+
+        if (kiDt > 0.0f) {
+            integralX += kiDt * halfex;
+            integralY += kiDt * halfey;
+            integralZ += kiDt * halfez;
+            gx += integralX * halfDt;
+            gy += integralY * halfDt;
+            gz += integralZ * halfDt;
+        }
+        gx += kpHalfDt * halfex;
+        gy += kpHalfDt * halfey;
+        gz += kpHalfDt * halfez;
+    }
+
+    float qa = q0, qb = q1, qc = q2;
+    q0 += -qb * gx - qc * gy - q3 * gz;
+    q1 += qa * gx + qc * gz - q3 * gy;
+    q2 += qa * gy - qb * gz + q3 * gx;
+    q3 += qa * gz + qb * gy - qc * gx;
+
+    // the norm moves away from 1 by about (rate * dt)^2 per step, so one Newton
+    // step from 1 is as good as the square root
+    float recipNorm = 1.5f - 0.5f * (q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q0 *= recipNorm;
+    q1 *= recipNorm;
+    q2 *= recipNorm;
+    q3 *= recipNorm;
+}
+
+void MahonyFilter::update(float gx, float gy, float gz, float ax, float ay, float az)
+{
+    step(gx, gy, gz, ax, ay, az);
+    eulerValid = false;
+}
+
+void MahonyFilter::updateBatch(const btd_imu_sample_t *samples, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const btd_imu_sample_t *s = &samples[i];
+        step(s->gx, s->gy, s->gz, s->ax, s->ay, s->az);
+    }
+    eulerValid = false;
+}
+
+void MahonyFilter::getQuaternion(float q[4]) const
+{
+    q[0] = q0;
+    q[1] = q1;
+    q[2] = q2;
+    q[3] = q3;
+}
+
+void MahonyFilter::getGravity(float gravity[3]) const
+{
+    gravity[0] = 2.0f * (q1 * q3 - q0 * q2);
+    gravity[1] = 2.0f * (q0 * q1 + q2 * q3);
+    gravity[2] = 2.0f * (q0 * q0 - 0.5f + q3 * q3);
+}
+
+void MahonyFilter::getEuler(float *pitchOut, float *rollOut, float *yawOut)
+{
+    if (!eulerValid) {
+        // same angles as MahonyAHRSupdateIMU(), without its fixed declination
+        float sinPitch = fminf(fmaxf(-2.0f * q1 * q3 + 2.0f * q0 * q2, -1.0f), 1.0f);
+        pitch = asinf(sinPitch) * RAD_TO_DEG_F;
+        roll = atan2f(2.0f * q2 * q3 + 2.0f * q0 * q1, -2.0f * q1 * q1 - 2.0f * q2 * q2 + 1.0f) * RAD_TO_DEG_F;
+        yaw = atan2f(2.0f * (q1 * q2 + q0 * q3), q0 * q0 + q1 * q1 - q2 * q2 - q3 * q3) * RAD_TO_DEG_F;
+        eulerValid = true;
+    }
+    *pitchOut = pitch;
+    *rollOut = roll;
+    *yawOut = yaw;
+}
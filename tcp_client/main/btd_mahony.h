@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Mahony's IMU filter (gyroscope and accelerometer, no magnetometer) with its
+// state in the object, so several filters can run side by side, unlike the
+// globals of the vendored MahonyAHRS.cpp. The sample rate is fixed per filter:
+// all factors that depend on dt are computed once in the constructor.
+// Euler angles are only computed when asked for, the update keeps the quaternion.
+
+// one sample of a FIFO batch
+typedef struct
+{
+    float ax, ay, az; // g
+    float gx, gy, gz; // degrees per second
+} btd_imu_sample_t;
+
+class MahonyFilter {
+   public:
+    /*
+        In: sample rate of the updates in Hz, proportional and integral gain
+        (the vendored filter uses kp 1, ki 0)
+    */
+    MahonyFilter(float sampleFrequency = 100.0f, float kp = 1.0f, float ki = 0.0f);
+
+    /*
+        back to the identity quaternion, clears the integral feedback
+    */
+    void reset();
+
+    /*
+        In: acceleration of a device at rest
+        sets the orientation to the measured gravity (yaw 0), so the filter does
+        not have to converge from the identity
+    */
+    void initFromAccel(float ax, float ay, float az);
+
+    /*
+        In: rotation rate in degrees per second and acceleration in any unit
+    */
+    void update(float gx, float gy, float gz, float ax, float ay, float az);
+
+    /*
+        In: count samples taken at the sample rate, oldest first
+    */
+    void updateBatch(const btd_imu_sample_t *samples, size_t count);
+
+    /*
+        Out: quaternion w, x, y, z
+    */
+    void getQuaternion(float q[4]) const;
+
+    /*
+        Out: direction of gravity in the sensor frame, unit vector
+    */
+    void getGravity(float gravity[3]) const;
+
+    /*
+        Out: angles in degrees, computed on the first call after an update
+    */
+    void getEuler(float *pitch, float *roll, float *yaw);
+
+   private:
+    void step(float gx, float gy, float gz, float ax, float ay, float az);
+
+    float q0, q1, q2, q3;
+    float integralX, integralY, integralZ;
+    float gyroScale;  // degrees to radians, times dt / 2
+    float kpHalfDt;   // 2 * kp * dt / 2
+    float kiDt;       // 2 * ki * dt
+    float halfDt;
+    bool eulerValid;
+    float pitch, roll, yaw;
+};
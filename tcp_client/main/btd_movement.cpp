@@ -1,56 +1,122 @@
 #include "btd_movement.h"
-#include "btd_bandpass.h"
+#include "btd_rates.h"
 #include <cmath>
+#include <cstdio>
 #include <chrono>
 
 extern "C" {
-    #include "esp_timer.h" 
-    #include "btd_bandpass.h"
+    #include "btd_steps.h"
+    #include "btd_fusion.h"
+    #include "btd_features.h"
+    #include "btd_activity.h"
+    #include "btd_decimator.h"
 }
+#include "btd_activity_model.h" // ACTIVITY_MODEL_RATE_HZ
 
-#define SAMPLING_FREQUENCY 100
+static_assert(MOTION_RATE_HZ == ACTIVITY_MODEL_RATE_HZ,
+              "the activity model is trained for another rate, run tools/train_classifier.py --rate");
+static_assert(2 * MOTION_RATE_HZ <= FEATURES_MAX_LENGTH, "the 2 sec motion window does not fit");
 
 static uint64_t last_movement_time_ms = 0;
-static const float MOVEMENT_THRESHOLD = 0.15f; 
+static const float MOVEMENT_STDDEV_MG = 50.0f; // at rest the magnitude varies by about 10 mg
+static const float MOVEMENT_ROTATION_THRESHOLD_DPS = 30.0f; // turning the device without shaking it
 static const uint64_t TIMEOUT_MS = 5 * 60 * 1000; 
 
-static const float WALKING_THRESHOLD = 0.08f;
-static const float HPF_CUTOFF = 1.5f;
-static const float LPF_CUTOFF = 2.0f;
-static const float mean_magnitude = 1.0449f;
-
-static bool was_stepping = false;
-static const int MIN_STEP_INTERVAL_MS = 500; // at least 500ms between 2 steps
-static uint64_t last_step_time_ms = 0;
-static uint64_t fist_step_time_ms = 0;
-int steps = 0;
-
-static BandPassFilter lp, hp;
-static BandPassFilter break_filter_lp, break_filter_hp;
-
-static int peak_count = 0;
-static uint64_t first_peak_time = 0;
-static const float BREAK_GESTURE_LOWPASS = 6.5f;
-static const float BREAK_GESTURE_HIGHPASS = 2.0f;
-static const float BREAK_PEAK_THRESHOLD = 0.15f; 
-static const int BREAK_GESTURE_WINDOW_MS = 1500; // 1500ms 
-
-bool detect_movement(float magnitude) {
-    return fabs(magnitude - 1.0f) > MOVEMENT_THRESHOLD; 
+static const uint32_t WALKING_MIN_STEPS = 5;
+static const int64_t WALKING_MIN_DURATION_MS = 3000;
+static bool walking_reported = false; // is_walking() reports each bout once
+
+static const uint16_t BREAK_MIN_SAMPLES = MOTION_RATE_HZ / 4; // 0.25 secs of gesture classifications, single windows can flicker
+static const float BREAK_ROTATION_DPS = 150.0f; // mean over the window, twisting the wrist
+static bool break_reported = false; // detect_break_gesture() reports each gesture once
+
+// magnitude minus 1 g in mg over 2 secs, classified by btd_activity for walking and shaking
+static const btd_feature_config_t MOTION_WINDOW = {
+    .length = 2 * MOTION_RATE_HZ,
+    .sample_frequency = MOTION_RATE_HZ,
+    .peak_threshold = 150,
+    .min_frequency = 0.5f,
+    .max_frequency = 6.0f,
+};
+// rotation rate in degrees per second over 1.5 secs
+static const btd_feature_config_t ROTATION_WINDOW = {
+    .length = 3 * MOTION_RATE_HZ / 2,
+    .sample_frequency = MOTION_RATE_HZ,
+    .peak_threshold = 100,
+    .min_frequency = 0.0f,
+    .max_frequency = 0.0f,
+};
+
+static btd_decimator_t motion_decimator, rotation_decimator, steps_decimator;
+static int64_t steps_delay_ms = 0; // of the steps decimator, taken off the step timestamps
+static bool decimators_primed = false;
+static btd_feature_window_t motion_window, rotation_window;
+static btd_features_t motion, rotation;
+static btd_activity_t activity = ACTIVITY_STILL;
+static uint16_t gesture_samples = 0; // samples classified as gesture in a row
+
+static int16_t clamp_int16(float value) {
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return (int16_t)lrintf(value);
+}
+
+void update_movement_features(float magnitude, float rotation_rate, int64_t timestamp_ms) {
+    if (!decimators_primed) {
+        decimator_prime(&motion_decimator, magnitude);
+        decimator_prime(&rotation_decimator, rotation_rate);
+        decimator_prime(&steps_decimator, magnitude);
+        decimators_primed = true;
+    }
+    float decimated;
+    if (decimator_push(&steps_decimator, magnitude, &decimated)) {
+        steps_update(decimated, timestamp_ms - steps_delay_ms);
+    }
+    float decimated_rotation;
+    decimator_push(&rotation_decimator, rotation_rate, &decimated_rotation); // in step with the motion decimator
+    if (!decimator_push(&motion_decimator, magnitude, &decimated)) {
+        return;
+    }
+
+    features_push(&motion_window, clamp_int16((decimated - 1.0f) * 1000.0f));
+    features_push(&rotation_window, clamp_int16(decimated_rotation));
+    features_get(&motion_window, &motion);
+    features_get(&rotation_window, &rotation);
+    // the tree is trained on full windows, a partial one at the start can look like anything
+    activity = motion.count < MOTION_WINDOW.length ? ACTIVITY_STILL : activity_classify(&motion);
+    if (activity != ACTIVITY_GESTURE) {
+        gesture_samples = 0;
+    } else if (gesture_samples < UINT16_MAX) {
+        gesture_samples++;
+    }
+}
+
+bool detect_movement() {
+    return sqrtf(motion.variance) > MOVEMENT_STDDEV_MG || rotation.mean > MOVEMENT_ROTATION_THRESHOLD_DPS;
 }
 
 void init_movement_detection() {
-     //for Walking:
-    init_lowpass(&lp, LPF_CUTOFF, (float)SAMPLING_FREQUENCY);
-    init_highpass(&hp, HPF_CUTOFF, (float)SAMPLING_FREQUENCY);
+    fusion_init((float)IMU_RATE_HZ);
+    decimator_init(&motion_decimator, MOTION_DECIMATION);
+    decimator_init(&rotation_decimator, MOTION_DECIMATION);
+    decimator_init(&steps_decimator, STEPS_DECIMATION);
+    steps_delay_ms = lrintf(decimator_delay(&steps_decimator) * 1000.0f / IMU_RATE_HZ);
+    decimators_primed = false;
+    features_init(&motion_window, &MOTION_WINDOW);
+    features_init(&rotation_window, &ROTATION_WINDOW);
+    features_get(&motion_window, &motion);
+    features_get(&rotation_window, &rotation);
+    activity = ACTIVITY_STILL;
+    gesture_samples = 0;
 
-    //for Break Gesture:
-    init_lowpass(&break_filter_lp, BREAK_GESTURE_LOWPASS, (float)SAMPLING_FREQUENCY);
-    init_highpass(&break_filter_hp, BREAK_GESTURE_HIGHPASS, (float)SAMPLING_FREQUENCY);
+     //for Walking:
+    steps_init((float)STEPS_RATE_HZ);
+    walking_reported = false;
+    break_reported = false;
 }
 
-bool should_auto_off(float magnitude, int64_t current_time_ms){
-    if (detect_movement(magnitude)) {
+bool should_auto_off(int64_t current_time_ms){
+    if (detect_movement()) {
         last_movement_time_ms = current_time_ms;
         return false;  
     }
@@ -64,62 +130,41 @@ bool should_auto_off(float magnitude, int64_t current_time_ms){
     return false;
 }
 
-bool is_walking(float magnitude, int64_t current_time_ms) {
-    float rawValue = magnitude - mean_magnitude;
-    float filteredValue = apply_filter(&hp, rawValue);
-    filteredValue = apply_filter(&lp, filteredValue);
-
-    bool is_stepping = fabs(filteredValue) > WALKING_THRESHOLD;
-
-    if (is_stepping && !was_stepping) {
-        if (current_time_ms - last_step_time_ms > MIN_STEP_INTERVAL_MS) {
-            last_step_time_ms = current_time_ms;
-            if (steps == 0) {
-                fist_step_time_ms = current_time_ms;
-            }
-            steps++;
-        }
+void reset_auto_off(int64_t current_time_ms) {
+    last_movement_time_ms = current_time_ms;
+}
+
+uint32_t get_step_count() {
+    return steps_total();
+}
+
+bool is_walking(int64_t current_time_ms) {
+    if (steps_bout_count() == 0) {
+        walking_reported = false;
+        return false;
     }
-    was_stepping = is_stepping;
-
-    if (steps >= 5 ) {
-        if((current_time_ms - fist_step_time_ms) <= 5000 && (current_time_ms - fist_step_time_ms) >= 3000){
-            printf("walking detected!\n");
-            steps = 0;
-            fist_step_time_ms = 0;
-            return true;
-        } else {
-            //reset steps if they did not happen in more than 3 secs and less than 5 secs
-            steps = 0;
-            fist_step_time_ms = 0;
-        }
+    if (!walking_reported && steps_bout_count() >= WALKING_MIN_STEPS &&
+        steps_bout_duration(current_time_ms) >= WALKING_MIN_DURATION_MS &&
+        activity == ACTIVITY_WALKING) {
+        printf("walking detected!\n");
+        walking_reported = true;
+        return true;
     }
     return false;
 }
 
-bool detect_break_gesture(float magnitude, int64_t current_time_ms) {
-    float rawValue = magnitude - mean_magnitude;
-    float filteredValue = apply_filter(&break_filter_hp, rawValue);
-    filteredValue = apply_filter(&break_filter_lp, filteredValue);
-
-    if (fabs(filteredValue) > BREAK_PEAK_THRESHOLD) {
-        if (peak_count == 0) {
-            first_peak_time = current_time_ms;
-        }
-        if ((current_time_ms - first_peak_time) <= BREAK_GESTURE_WINDOW_MS) {
-            peak_count++;
-        } else {
-            if (peak_count >= 20) {
-                peak_count = 0;
-                first_peak_time = 0;
-                printf("break-gesture detected! \n");
-                return true;
-            }
-            peak_count = 1;
-            first_peak_time = current_time_ms;
-        }
+bool detect_break_gesture() {
+    // shaking shows in the magnitude, twisting only in the rotation rate (no gyro training data yet)
+    bool shaking = gesture_samples >= BREAK_MIN_SAMPLES;
+    bool twisting = rotation.mean >= BREAK_ROTATION_DPS;
+    if (!shaking && !twisting) {
+        break_reported = false;
+        return false;
     }
-    return false;
+    if (break_reported) {
+        return false;
+    }
+    printf("break-gesture detected! \n");
+    break_reported = true;
+    return true;
 }
-
-
@@ -9,33 +9,52 @@ extern "C" {
 #endif
 
 /*
-    In: magnitude
-    Out: is true if movement is detected (detect over Movement threshold)
+    In: magnitude in g, rotation rate in deg/s (fusion_get_rotation_rate()) and timestamp of an
+    IMU sample, call for every sample at IMU_RATE_HZ (btd_rates.h) before the detectors below
+    decimates the sample to the rates of the feature windows (btd_features.h) and the step
+    detection (btd_steps.h) and updates them
 */
-bool detect_movement(float magnitude);
+void update_movement_features(float magnitude, float rotation_rate, int64_t timestamp_ms);
 
 /*
-    initializes the movement bandpass filter
+    Out: is true if the last 2 secs show movement (spread of the magnitude or rotation)
+*/
+bool detect_movement();
+
+/*
+    initializes the feature windows, the step detection and the sensor fusion
 */
 void init_movement_detection();
 
 /*
-    In: current timestamp and magnitude
-    Out: is true if 5 steps occur in more than 3 secs and less than 5 secs
+    In: current timestamp
+    Out: is true once per walking bout, when it has 5 steps over at least 3 secs
+    and the activity classifier (btd_activity.h) sees walking
+*/
+bool is_walking(int64_t current_time_ms);
+
+/*
+    Out: is true once per gesture, when the activity classifier sees shaking for 0.25 secs,
+    or the device twists at 150 deg/s on average over 1,5 secs
+*/
+bool detect_break_gesture();
+
+/*
+    In: current timestamp
+    Out: is true if no movement (acceleration or rotation) was detected in the last 5 mins
 */
-bool is_walking(float magnitude, int64_t current_time_ms);
+bool should_auto_off(int64_t timestamp);
 
 /*
-    In: current timestamp and magnitude
-    Out: is true if more than 20 times over break gesture threshold in 1,5 secs
+    In: current timestamp
+    restarts the auto off timeout, e.g. at the start of a working session
 */
-bool detect_break_gesture(float magnitude, int64_t timestamp);
+void reset_auto_off(int64_t timestamp);
 
 /*
-    In: current timestamp and magnitude
-    Out: is true if no movement was detected in the last 5 mins
+    Out: number of steps detected since boot, see steps_total()
 */
-bool should_auto_off(float magnitude, int64_t timestamp);
+uint32_t get_step_count();
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,102 @@
+#include <stddef.h>
+
+#include "btd_pattern.h"
+
+#define LENGTH(steps) (sizeof(steps) / sizeof(steps[0]))
+
+#define NOTE_C7 2093
+#define NOTE_E7 2637
+#define NOTE_G7 3136
+
+static const pattern_step_t PATTERN_A_STEPS[] = {
+    PATTERN_STEP(PATTERN_LEVEL_MAX, 200),
+    PATTERN_STEP(0, 200),
+    PATTERN_STEP(PATTERN_LEVEL_MAX, 200),
+    PATTERN_STEP(0, 200),
+    PATTERN_STEP(PATTERN_LEVEL_MAX, 400),
+};
+
+static const pattern_step_t CUE_WORK_START_STEPS[] = {
+    PATTERN_TONE(NOTE_C7, PATTERN_LEVEL_MAX, 90),
+    PATTERN_TONE(NOTE_E7, PATTERN_LEVEL_MAX, 90),
+    PATTERN_FADE(NOTE_G7, PATTERN_LEVEL_MAX, 0, 240),
+};
+
+static const pattern_step_t CUE_BREAK_START_STEPS[] = {
+    PATTERN_TONE(NOTE_G7, PATTERN_LEVEL_MAX, 90),
+    PATTERN_TONE(NOTE_E7, PATTERN_LEVEL_MAX, 90),
+    PATTERN_FADE(NOTE_C7, PATTERN_LEVEL_MAX, 0, 240),
+};
+
+static const pattern_step_t CUE_BREAK_END_STEPS[] = {
+    PATTERN_FADE(NOTE_G7, PATTERN_LEVEL_MAX, 0, 120),
+    PATTERN_STEP(0, 80),
+    PATTERN_FADE(NOTE_G7, PATTERN_LEVEL_MAX, 0, 120),
+};
+
+const pattern_t PATTERN_A = {PATTERN_A_STEPS, LENGTH(PATTERN_A_STEPS)};
+const pattern_t CUE_WORK_START = {CUE_WORK_START_STEPS, LENGTH(CUE_WORK_START_STEPS)};
+const pattern_t CUE_BREAK_START = {CUE_BREAK_START_STEPS, LENGTH(CUE_BREAK_START_STEPS)};
+const pattern_t CUE_BREAK_END = {CUE_BREAK_END_STEPS, LENGTH(CUE_BREAK_END_STEPS)};
+
+void pattern_player_init(pattern_player_t *player)
+{
+    player->head = 0;
+    player->count = 0;
+    player->pattern = NULL;
+    player->step = 0;
+}
+
+bool pattern_play(pattern_player_t *player, const pattern_t *pattern)
+{
+    if (player->count == PATTERN_QUEUE_LEN || pattern->length == 0)
+        return false;
+    player->queue[(player->head + player->count) % PATTERN_QUEUE_LEN] = pattern;
+    player->count++;
+    return true;
+}
+
+bool pattern_is_idle(const pattern_player_t *player)
+{
+    return player->pattern == NULL && player->count == 0;
+}
+
+uint32_t pattern_duration_ms(const pattern_t *pattern)
+{
+    uint32_t ms = 0;
+    for (uint8_t i = 0; i < pattern->length; i++)
+        ms += pattern->steps[i].ms;
+    return ms;
+}
+
+const pattern_step_t *pattern_current(const pattern_player_t *player)
+{
+    return player->pattern == NULL ? NULL : &player->pattern->steps[player->step];
+}
+
+void pattern_stop(pattern_player_t *player)
+{
+    player->count = 0;
+    player->pattern = NULL;
+}
+
+uint32_t pattern_next(pattern_player_t *player, uint8_t *level)
+{
+    if (player->pattern != NULL && ++player->step >= player->pattern->length)
+        player->pattern = NULL;
+    if (player->pattern == NULL && player->count > 0)
+    {
+        player->pattern = player->queue[player->head];
+        player->head = (player->head + 1) % PATTERN_QUEUE_LEN;
+        player->count--;
+        player->step = 0;
+    }
+    if (player->pattern == NULL)
+    {
+        *level = 0;
+        return 0;
+    }
+    const pattern_step_t *step = &player->pattern->steps[player->step];
+    *level = step->level;
+    return step->ms;
+}
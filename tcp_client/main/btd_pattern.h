@@ -0,0 +1,106 @@
+#ifndef BTD_PATTERN_H
+#define BTD_PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Non-blocking player for vibration patterns and the audio cues of the buzzer.
+// A pattern is a constant array of steps, an output level held for a time or
+// faded to another level, with the tone for the buzzer.
+// pattern_play() only queues it; the owner of the output (btd_vibrator.cpp,
+// btd_buzzer.c) runs pattern_next() from a one-shot esp_timer, applies the
+// level to its LEDC channel and arms the timer again for the returned time.
+// Patterns queued while one plays follow it without a gap. The player has no
+// locking, the owner serializes the calls.
+
+#define PATTERN_QUEUE_LEN 4
+#define PATTERN_LEVEL_MAX 255
+
+typedef struct
+{
+    uint8_t level;   // 0 (off) .. PATTERN_LEVEL_MAX, at the start of the step
+    uint8_t fade_to; // level at the end, faded by the LEDC of the buzzer, ignored by the vibrator
+    uint16_t hz;     // tone of the buzzer, 0 keeps the last one, ignored by the vibrator
+    uint16_t ms;     // at least 1
+} pattern_step_t;
+
+#define PATTERN_STEP(level, ms) {(level), (level), 0, (ms)}
+#define PATTERN_TONE(hz, level, ms) {(level), (level), (hz), (ms)}
+#define PATTERN_FADE(hz, from, to, ms) {(from), (to), (hz), (ms)}
+
+typedef struct
+{
+    const pattern_step_t *steps;
+    uint8_t length;
+} pattern_t;
+
+typedef struct
+{
+    const pattern_t *queue[PATTERN_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    const pattern_t *pattern; // NULL while idle
+    uint8_t step;
+} pattern_player_t;
+
+// on 200, off 200, on 200, off 200, on 400 ms, the former blocking vibration_pattern_a()
+extern const pattern_t PATTERN_A;
+
+// audio cues, short tone sequences around the 2-4 kHz where the buzzer is loud
+extern const pattern_t CUE_WORK_START;  // rising C7 E7 G7
+extern const pattern_t CUE_BREAK_START; // falling G7 E7 C7
+extern const pattern_t CUE_BREAK_END;   // two short G7
+
+/*
+    In: player
+    idle with an empty queue
+*/
+void pattern_player_init(pattern_player_t *player);
+
+/*
+    In: player, pattern
+    Out: false if the queue is full
+    queues the pattern, the owner kicks its timer if the player was idle
+*/
+bool pattern_play(pattern_player_t *player, const pattern_t *pattern);
+
+/*
+    In: player
+    Out: true if no pattern is playing or queued
+*/
+bool pattern_is_idle(const pattern_player_t *player);
+
+/*
+    In: pattern
+    Out: time until the pattern has played, the sum of its steps
+*/
+uint32_t pattern_duration_ms(const pattern_t *pattern);
+
+/*
+    In: player
+    Out: the step started by the last pattern_next(), NULL while idle
+*/
+const pattern_step_t *pattern_current(const pattern_player_t *player);
+
+/*
+    In: player
+    drops the playing and the queued patterns, the next pattern_next() turns the output off
+*/
+void pattern_stop(pattern_player_t *player);
+
+/*
+    In: player
+    Out: the level to output from now on and the ms until the next call, 0 once idle (level 0)
+    advances to the next step, or to the next queued pattern after the last step
+*/
+uint32_t pattern_next(pattern_player_t *player, uint8_t *level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef BTD_RATES_H
+#define BTD_RATES_H
+
+#include "sdkconfig.h"
+
+// Sample rates of the working loop and its detectors, one place for all of them.
+// The IMU rate and the detector rates are configuration (menuconfig, ti:ma
+// Configuration); the detectors get their samples through the decimation
+// filters of btd_decimator.
+//
+//   IMU (100/200/500 Hz) -> fusion, rotation rate
+//        |-> decimator -> MOTION_RATE_HZ -> feature windows, activity classifier
+//        '-> decimator -> STEPS_RATE_HZ  -> step detection
+//
+// The sample stream (btd_sender.c) stays at the loop rate, the server and values.csv expect 100 Hz.
+
+#define LOOP_RATE_HZ 100 // handle_working() iterations, display, audio, the IMU log and the stream
+#define LOOP_PERIOD_MS (1000 / LOOP_RATE_HZ)
+
+#define IMU_RATE_HZ CONFIG_BTD_IMU_RATE_HZ
+#define IMU_SAMPLES_PER_LOOP (IMU_RATE_HZ / LOOP_RATE_HZ)
+#define IMU_MAX_BATCH (2 * IMU_SAMPLES_PER_LOOP) // a late loop catches up with the next batch
+
+#define MOTION_RATE_HZ CONFIG_BTD_MOTION_RATE_HZ
+#define MOTION_DECIMATION (IMU_RATE_HZ / MOTION_RATE_HZ)
+
+#define STEPS_RATE_HZ CONFIG_BTD_STEPS_RATE_HZ
+#define STEPS_DECIMATION (IMU_RATE_HZ / STEPS_RATE_HZ)
+
+#if IMU_RATE_HZ % LOOP_RATE_HZ != 0 || 1000 % IMU_RATE_HZ != 0
+#error "the IMU rate must be a multiple of the loop rate and divide the MPU6886's 1 kHz"
+#endif
+#if IMU_RATE_HZ % MOTION_RATE_HZ != 0 || IMU_RATE_HZ % STEPS_RATE_HZ != 0
+#error "the detector rates must divide the IMU rate"
+#endif
+
+#endif // BTD_RATES_H
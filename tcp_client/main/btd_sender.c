@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <arpa/inet.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "btd_sender.h"
+#include "btd_imu.h"
+#include "btd_rates.h"
+#include "btd_stream.h"
+#include "btd_delta.h"
+#include "btd_conn.h"
+
+#define HOST_IP_ADDR CONFIG_EXAMPLE_IPV4_ADDR
+#define PORT CONFIG_EXAMPLE_PORT
+#define POLL_PERIOD_MS 10 // transports with a poll callback run it at least this often
+
+static const char *TAG = "BTD_SENDER";
+
+typedef struct
+{
+    int16_t x, y, z;
+    bool end; // marks the end of a working session, no sample
+    int64_t timestamp_us;
+} sender_item_t;
+
+// one per transport, selected in menuconfig
+typedef struct
+{
+    void (*open)(void);
+    void (*sample)(const sender_item_t *item);
+    void (*end)(void); // end of a working session
+    void (*poll)(int64_t now_ms); // optional, for work between the samples
+} sender_transport_t;
+
+static QueueHandle_t items = NULL;
+static volatile uint32_t dropped_samples = 0;
+
+static bool parse_address(struct sockaddr_in *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(PORT);
+    return inet_pton(AF_INET, HOST_IP_ADDR, &addr->sin_addr) == 1;
+}
+
+#if CONFIG_BTD_STREAM_UDP
+// sequence numbered batches of raw samples, no acks (server/udp_server.py)
+static int sock = -1;
+static bool open_failed = false; // logged once, the open is retried per sample
+static struct sockaddr_in dest_addr;
+static btd_stream_packet_t packet;
+static uint32_t seq = 0;
+static uint32_t send_errors = 0;
+
+static void udp_open(void)
+{
+    if (!parse_address(&dest_addr))
+    {
+        if (!open_failed)
+            ESP_LOGE(TAG, "Invalid IP address format");
+        open_failed = true;
+        return;
+    }
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0)
+    {
+        if (!open_failed)
+            ESP_LOGE(TAG, "Unable to create socket: errno %d, retrying with the next sample", errno);
+        open_failed = true;
+        return;
+    }
+    open_failed = false;
+    stream_batch_reset(&packet, seq, LOOP_PERIOD_MS * 1000);
+    ESP_LOGI(TAG, "UDP socket created, streaming to %s:%d", HOST_IP_ADDR, PORT);
+}
+
+static void send_batch(void)
+{
+    int err = sendto(sock, &packet, stream_packet_size(&packet), 0,
+                     (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    if (err < 0)
+    {
+        // datagrams are fire and forget, the receiver accounts for the gap
+        send_errors++;
+        ESP_LOGW(TAG, "Error occurred during sending: errno %d (%lu errors)", errno, (unsigned long)send_errors);
+    }
+    seq++;
+    stream_batch_reset(&packet, seq, LOOP_PERIOD_MS * 1000);
+}
+
+static void udp_sample(const sender_item_t *item)
+{
+    if (sock < 0)
+        udp_open();
+    if (sock < 0)
+        return;
+    btd_stream_sample_t sample = {.x = item->x, .y = item->y, .z = item->z};
+    if (stream_batch_push(&packet, &sample, item->timestamp_us, CONFIG_BTD_STREAM_UDP_BATCH_SIZE))
+        send_batch();
+}
+
+static void udp_end(void)
+{
+    // a batch never spans two sessions, its timestamp and period place every sample
+    if (sock >= 0 && packet.header.count > 0)
+        send_batch();
+}
+
+static const sender_transport_t transport = {
+    .open = udp_open,
+    .sample = udp_sample,
+    .end = udp_end,
+    .poll = NULL,
+};
+
+#elif CONFIG_BTD_STREAM_TCP_RESUME
+// one stream for the whole uptime through the reconnecting connection manager (btd_conn.c,
+// server/resume_server.py). A record is the uint32 timestamp (ms) of its first sample followed
+// by delta coded samples, the encoder restarts per record so every record decodes on its own.
+#define RECORD_HEADER 4
+static btd_conn_record_t resend_records[CONFIG_BTD_CONN_RESEND_RECORDS];
+static btd_conn_t conn;
+static btd_delta_encoder_t encoder;
+static uint8_t record[BTD_CONN_MAX_PAYLOAD];
+static size_t record_len = 0;
+
+static void resume_open(void)
+{
+    conn_init(&conn, resend_records, CONFIG_BTD_CONN_RESEND_RECORDS,
+              HOST_IP_ADDR, PORT, esp_random(), esp_random());
+    conn_set_backoff(&conn, CONFIG_BTD_CONN_BACKOFF_MIN_MS, CONFIG_BTD_CONN_BACKOFF_MAX_MS);
+    ESP_LOGI(TAG, "Streaming session %lu to %s:%d", (unsigned long)conn.session_id, HOST_IP_ADDR, PORT);
+}
+
+static void submit_record(void)
+{
+    conn_submit(&conn, record, record_len);
+    record_len = 0;
+}
+
+static void resume_sample(const sender_item_t *item)
+{
+    if (record_len == 0)
+    {
+        delta_encoder_init(&encoder, 0);
+        uint32_t timestamp = item->timestamp_us / 1000;
+        memcpy(record, &timestamp, RECORD_HEADER);
+        record_len = RECORD_HEADER;
+    }
+
+    int16_t sample[BTD_DELTA_AXES] = {item->x, item->y, item->z};
+    record_len += delta_encode_sample(&encoder, sample, record + record_len);
+    if (record_len + BTD_DELTA_MAX_SAMPLE_BYTES > BTD_CONN_MAX_PAYLOAD)
+        submit_record();
+}
+
+static void resume_end(void)
+{
+    // a record never spans two sessions, its timestamp places the samples
+    if (record_len > 0)
+        submit_record();
+}
+
+static void resume_poll(int64_t now_ms)
+{
+    // sampling goes on while disconnected, the resend buffer covers the outage
+    conn_poll(&conn, now_ms);
+}
+
+static const sender_transport_t transport = {
+    .open = resume_open,
+    .sample = resume_sample,
+    .end = resume_end,
+    .poll = resume_poll,
+};
+
+#else
+// one connection per working session (server/server2.py), text messages "x, y, z, " in g and "end",
+// or with CONFIG_BTD_STREAM_TCP_DELTA frames of delta coded raw samples and an empty frame.
+// The connect runs in the background, samples until it completes are dropped.
+#define CONNECT_TIMEOUT_MS 3000
+#define RECONNECT_DELAY_MS 5000
+#define IO_TIMEOUT_MS 2000 // sends and the final response, once connected
+
+#define MAX_RX_SIZE 128
+#define MAX_TX_SIZE 128
+
+static int sock = -1;
+static bool connecting = false;
+static int64_t deadline_ms = 0;     // of the current connect
+static int64_t next_attempt_ms = 0; // earliest time of the next connect
+static char tx_buffer[MAX_TX_SIZE];
+static char rx_buffer[MAX_RX_SIZE];
+
+#if CONFIG_BTD_STREAM_TCP_DELTA
+// frames are a little endian uint16 payload length followed by delta coded samples
+#define DELTA_FRAME_HEADER 2
+static btd_delta_encoder_t encoder;
+static size_t tx_len = DELTA_FRAME_HEADER;
+#endif
+
+static void tcp_open(void)
+{
+    ESP_LOGI(TAG, "Streaming working sessions to %s:%d over TCP", HOST_IP_ADDR, PORT);
+}
+
+static void close_connection(void)
+{
+    shutdown(sock, 0);
+    close(sock);
+    sock = -1;
+    connecting = false;
+}
+
+static void connect_failed(int64_t now_ms)
+{
+    close_connection();
+    next_attempt_ms = now_ms + RECONNECT_DELAY_MS;
+}
+
+static void start_connect(int64_t now_ms)
+{
+    struct sockaddr_in dest_addr;
+    if (!parse_address(&dest_addr))
+    {
+        ESP_LOGE(TAG, "Invalid IP address format");
+        next_attempt_ms = now_ms + RECONNECT_DELAY_MS;
+        return;
+    }
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sock < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        next_attempt_ms = now_ms + RECONNECT_DELAY_MS;
+        return;
+    }
+
+    // connect in the background, tcp_poll() checks for completion
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int err = connect(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    if (err != 0 && errno != EINPROGRESS)
+    {
+        ESP_LOGE(TAG, "Socket unable to connect: errno %d", errno);
+        connect_failed(now_ms);
+        return;
+    }
+    connecting = true;
+    deadline_ms = now_ms + CONNECT_TIMEOUT_MS;
+}
+
+static void tcp_poll(int64_t now_ms)
+{
+    if (!connecting)
+        return;
+
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(sock, &writable);
+    struct timeval no_wait = {0, 0};
+    if (select(sock + 1, NULL, &writable, NULL, &no_wait) <= 0)
+    {
+        if (now_ms >= deadline_ms)
+        {
+            ESP_LOGE(TAG, "Connect to %s:%d timed out", HOST_IP_ADDR, PORT);
+            connect_failed(now_ms);
+        }
+        return;
+    }
+
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len);
+    if (error != 0)
+    {
+        ESP_LOGE(TAG, "Socket unable to connect: errno %d", error);
+        connect_failed(now_ms);
+        return;
+    }
+
+    // the sender task may block on the socket from here on, the working loop never does
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+    struct timeval timeout = {IO_TIMEOUT_MS / 1000, (IO_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    connecting = false;
+#if CONFIG_BTD_STREAM_TCP_DELTA
+    // the server decodes every connection from scratch
+    delta_encoder_init(&encoder, BTD_DELTA_KEYFRAME_INTERVAL);
+    tx_len = DELTA_FRAME_HEADER;
+#endif
+    ESP_LOGI(TAG, "Successfully connected to server");
+}
+
+static void send_bytes(const void *data, size_t len)
+{
+    if (send(sock, data, len, 0) < 0)
+    {
+        ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+        close_connection();
+    }
+}
+
+#if CONFIG_BTD_STREAM_TCP_DELTA
+static void flush_delta_frame(void)
+{
+    size_t payload = tx_len - DELTA_FRAME_HEADER;
+    tx_buffer[0] = payload & 0xFF;
+    tx_buffer[1] = (payload >> 8) & 0xFF;
+    send_bytes(tx_buffer, tx_len);
+    tx_len = DELTA_FRAME_HEADER;
+}
+#endif
+
+static void tcp_sample(const sender_item_t *item)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (sock < 0 && now_ms >= next_attempt_ms)
+        start_connect(now_ms);
+    if (sock < 0 || connecting)
+        return;
+
+#if CONFIG_BTD_STREAM_TCP_DELTA
+    int16_t sample[BTD_DELTA_AXES] = {item->x, item->y, item->z};
+    tx_len += delta_encode_sample(&encoder, sample, (uint8_t *)tx_buffer + tx_len);
+    if (tx_len + BTD_DELTA_MAX_SAMPLE_BYTES > MAX_TX_SIZE)
+        flush_delta_frame();
+#else
+    float a_res = getAccelResolution();
+    snprintf(tx_buffer, MAX_TX_SIZE, "%f, %f, %f, ", item->x * a_res, item->y * a_res, item->z * a_res);
+    send_bytes(tx_buffer, strlen(tx_buffer));
+#endif
+}
+
+static void tcp_end(void)
+{
+    next_attempt_ms = 0; // the next session tries at once
+    if (connecting)
+        close_connection();
+    if (sock < 0)
+        return;
+#if CONFIG_BTD_STREAM_TCP_DELTA
+    // flush the pending samples, an empty frame marks the end
+    if (tx_len > DELTA_FRAME_HEADER)
+        flush_delta_frame();
+    if (sock >= 0)
+        flush_delta_frame();
+#else
+    send_bytes("end", 3);
+#endif
+    if (sock < 0)
+        return;
+    int len = recv(sock, rx_buffer, MAX_RX_SIZE - 1, 0);
+    if (len > 0)
+    {
+        rx_buffer[len] = '\0';
+        ESP_LOGI(TAG, "Received %d bytes: %s", len, rx_buffer);
+    }
+    close_connection();
+}
+
+static const sender_transport_t transport = {
+    .open = tcp_open,
+    .sample = tcp_sample,
+    .end = tcp_end,
+    .poll = tcp_poll,
+};
+#endif
+
+static void sender_task(void *arg)
+{
+    TickType_t wait = transport.poll ? pdMS_TO_TICKS(POLL_PERIOD_MS) : portMAX_DELAY;
+    transport.open();
+    while (true)
+    {
+        sender_item_t item;
+        if (xQueueReceive(items, &item, wait) == pdTRUE)
+        {
+            if (item.end)
+            {
+                transport.end();
+                if (dropped_samples > 0)
+                    ESP_LOGW(TAG, "%lu samples dropped so far, the queue was full", (unsigned long)dropped_samples);
+            }
+            else
+                transport.sample(&item);
+        }
+        if (transport.poll)
+            transport.poll(esp_timer_get_time() / 1000);
+    }
+}
+
+void sender_start(void)
+{
+    if (items != NULL)
+        return;
+    items = xQueueCreate(SENDER_QUEUE_LENGTH, sizeof(sender_item_t));
+    xTaskCreate(sender_task, "sender", 4096, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
+
+void sender_push(int16_t ax, int16_t ay, int16_t az, int64_t timestamp_us)
+{
+    sender_item_t item = {.x = ax, .y = ay, .z = az, .end = false, .timestamp_us = timestamp_us};
+    if (items != NULL && xQueueSend(items, &item, 0) != pdTRUE)
+        dropped_samples++;
+}
+
+void sender_stop(void)
+{
+    sender_item_t item = {.end = true};
+    // the end marker waits for room, the session has to close on the server
+    if (items != NULL)
+        xQueueSend(items, &item, pdMS_TO_TICKS(100));
+}
@@ -0,0 +1,37 @@
+#ifndef BTD_SENDER_H
+#define BTD_SENDER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streams the accelerometer of the working sessions to the server (CONFIG_BTD_STREAM),
+// over the transport chosen in menuconfig (Example Configuration).
+// The working loop posts one sample per iteration into a queue and never waits on
+// the network; a sender task owns the socket. Samples that do not fit into the
+// queue while the task waits on a send are dropped and counted.
+
+#define SENDER_QUEUE_LENGTH 64 // samples, 640 ms at the loop rate
+
+/*
+    starts the sender task on the first call, Wi-Fi has to be up (start_http_server())
+*/
+void sender_start(void);
+
+/*
+    In: raw accelerometer sample in ADC counts and its capture time
+*/
+void sender_push(int16_t ax, int16_t ay, int16_t az, int64_t timestamp_us);
+
+/*
+    ends the stream of the working session, pending samples are sent
+*/
+void sender_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_SENDER_H
@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "btd_hal.h"
+#include "btd_imu.h"
+#include "btd_rates.h"
+#include "btd_display.h"
+#include "btd_battery.h"
+#include "btd_button.h"
+#include "btd_audio.h"
+#include "btd_vibrator.h"
+#include "btd_buzzer.h"
+#include "btd_energy.h"
+
+extern "C"
+{
+#include "btd_http.h"
+#include "btd_wifi.h"
+}
+
+// Linux backend of the HAL and the peripheral modules, see btd_hal.h.
+// Time is virtual: delays advance the clock instead of sleeping, so the hours
+// of the scenario below run in a fraction of a second. The scenario scripts
+// button presses, movement and noise; the run ends when the controller powers
+// the device off (auto off after 5 minutes without movement) or at SIM_END_MS.
+
+static const char *TAG = "BTD_SIM";
+
+#define SIM_END_MS (3 * 60 * 60 * 1000LL) // safety net, the scenario powers off well before
+#define SIM_A_RES (16.0f / 32768.0f)      // same range as the MPU6886 setup on the device
+#define SIM_G_RES (2000.0f / 32768.0f)    // degrees per second, same range as on the device
+
+typedef enum
+{
+    SIM_PRESS_A,
+    SIM_PRESS_B,
+    SIM_FIDGET, // short bumps every minute, keeps auto off away
+    SIM_WALK,   // 1 Hz steps, triggers is_walking()
+    SIM_SHAKE,  // 4 Hz shaking and twisting, triggers detect_break_gesture()
+    SIM_NOISE,  // loud environment for the microphone
+} sim_event_type_t;
+
+typedef struct
+{
+    int64_t start_ms;
+    int64_t duration_ms;
+    sim_event_type_t type;
+} sim_event_t;
+
+#define MIN(m) ((int64_t)(m) * 60 * 1000)
+
+// default config: 25 min work, 5 min break, 15 min long break after 3 sessions
+static const sim_event_t scenario[] = {
+    {1000, 0, SIM_PRESS_A}, // QR code -> link code
+    {2000, 0, SIM_PRESS_A}, // -> working, session 1 runs until the timer ends
+    {0, MIN(100), SIM_FIDGET},
+    {MIN(10), MIN(2), SIM_NOISE},
+    {MIN(40), 8000, SIM_WALK},   // session 2 ends early by walking away
+    {MIN(50), 3000, SIM_SHAKE},  // session 3 ends early by the break gesture, long break follows
+    {MIN(80), 0, SIM_PRESS_B},   // session 4 interrupted, back to awake
+    {MIN(81), 0, SIM_PRESS_A},
+    {MIN(81) + 1000, 0, SIM_PRESS_A}, // session 5, fidgeting stops at 100 min -> auto off
+};
+
+static int64_t now_ms = 0;
+static int64_t last_button_ms = -1;
+static uint32_t rng = 0x12345678;
+
+static struct
+{
+    uint64_t delays;
+    uint64_t imu_reads;
+    int working_screens;
+    int break_screens;
+    int http_starts;
+    int backlight_changes;
+} counters;
+static looptime_hist_t button_latency; // scripted press to btn_get_event()
+static bool ap_on = false;
+static int64_t next_battery_sample_ms = 0;
+
+static bool event_active(sim_event_type_t type)
+{
+    for (size_t i = 0; i < sizeof(scenario) / sizeof(scenario[0]); i++)
+    {
+        const sim_event_t *event = &scenario[i];
+        if (event->type == type && now_ms >= event->start_ms && now_ms < event->start_ms + event->duration_ms)
+            return true;
+    }
+    return false;
+}
+
+static float noise(float amplitude)
+{
+    // xorshift32, the simulation is deterministic
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return amplitude * ((rng & 0xFFFF) / 32768.0f - 1.0f);
+}
+
+static void sim_finish(const char *reason)
+{
+    double cpu_ms = clock() * 1000.0 / CLOCKS_PER_SEC;
+    printf("SIM DONE: %s at %.1f virtual min, %.1f ms cpu, %llu delays, %llu imu samples, "
+           "%d work sessions, %d breaks, %d awake phases\n",
+           reason, now_ms / 60000.0, cpu_ms, (unsigned long long)counters.delays,
+           (unsigned long long)counters.imu_reads, counters.working_screens, counters.break_screens,
+           counters.http_starts);
+    printf("SIM BUTTONS: %lu presses, latency max %lu us\n", (unsigned long)button_latency.count,
+           (unsigned long)button_latency.max_us);
+    energy_totals_t energy;
+    energy_get_totals(&energy);
+    for (int i = 0; i < ENERGY_STATES; i++)
+        printf("SIM ENERGY: %s %.1f min %.2f mAh\n", energy_state_name(i), energy.states[i].time_ms / 60000.0,
+               energy.states[i].charge_mah);
+    for (int i = 0; i < ENERGY_FEATURES; i++)
+        printf("SIM ENERGY: %s %.1f min %.2f mAh\n", energy_feature_name((energy_feature_t)i),
+               energy.features[i].time_ms / 60000.0, energy.features[i].charge_mah);
+    fflush(stdout);
+    exit(0);
+}
+
+// rough M5StickC Plus draw: the display and the ESP32 running, plus the access point
+static float sim_load_ma(void)
+{
+    return 45.0f + (ap_on ? 80.0f : 0.0f);
+}
+
+static void advance(int64_t ms)
+{
+    now_ms += ms;
+    counters.delays++;
+    if (now_ms >= next_battery_sample_ms)
+    {
+        // the battery task of the device
+        energy_add_sample(sim_load_ma());
+        next_battery_sample_ms = now_ms + BATTERY_SAMPLE_PERIOD_S * 1000;
+    }
+    if (now_ms >= SIM_END_MS)
+        sim_finish("end of scenario");
+}
+
+// HAL -------------------------------------------
+
+void hal_board_init(void)
+{
+    ESP_LOGI(TAG, "Simulated board, virtual time");
+}
+
+int64_t hal_time_ms(void)
+{
+    return now_ms;
+}
+
+int64_t hal_time_us(void)
+{
+    return now_ms * 1000;
+}
+
+void hal_delay_ms(uint32_t ms)
+{
+    advance(ms);
+}
+
+bool hal_delay_until(int64_t *last_wake_ms, uint32_t period_ms)
+{
+    *last_wake_ms += period_ms;
+    bool on_time = *last_wake_ms >= now_ms;
+    advance(on_time ? *last_wake_ms - now_ms : 0);
+    return on_time;
+}
+
+void hal_power_off(void)
+{
+    sim_finish("power off");
+}
+
+// IMU -------------------------------------------
+
+void init_imu(void) {}
+
+static int64_t imu_samples_read = -1; // samples at IMU_RATE_HZ since 0, -1 = FIFO empty
+
+static void sim_accel(float t, int16_t *ax, int16_t *ay, int16_t *az)
+{
+    float x = noise(0.01f);
+    float y = noise(0.01f);
+    float z = 1.0f + noise(0.01f); // lying flat
+
+    if (event_active(SIM_WALK))
+        z += 0.3f * sinf(2 * M_PI * 1.0f * t);
+    if (event_active(SIM_SHAKE))
+        z += 0.8f * sinf(2 * M_PI * 4.0f * t);
+    if (event_active(SIM_FIDGET) && now_ms % 60000 < 200)
+        z += 0.3f;
+
+    *ax = x / SIM_A_RES;
+    *ay = y / SIM_A_RES;
+    *az = z / SIM_A_RES;
+    counters.imu_reads++;
+}
+
+static void sim_gyro(float t, int16_t *gx, int16_t *gy, int16_t *gz)
+{
+    float x = noise(0.5f);
+    float y = noise(0.5f);
+    float z = noise(0.5f);
+
+    if (event_active(SIM_WALK))
+        x += 20.0f * sinf(2 * M_PI * 1.0f * t); // the device swings a little with the steps
+    if (event_active(SIM_SHAKE))
+        y += 400.0f * sinf(2 * M_PI * 4.0f * t); // twisting the wrist back and forth
+
+    *gx = x / SIM_G_RES;
+    *gy = y / SIM_G_RES;
+    *gz = z / SIM_G_RES;
+}
+
+void getAccelAdc(int16_t *ax, int16_t *ay, int16_t *az)
+{
+    sim_accel(now_ms / 1000.0f, ax, ay, az);
+}
+
+void getAccelData(float *ax, float *ay, float *az)
+{
+    int16_t x, y, z;
+    getAccelAdc(&x, &y, &z);
+    *ax = x * SIM_A_RES;
+    *ay = y * SIM_A_RES;
+    *az = z * SIM_A_RES;
+}
+
+float getAccelResolution(void)
+{
+    return SIM_A_RES;
+}
+
+float getAccelMagnitudeFromAdc(int16_t ax, int16_t ay, int16_t az)
+{
+    float x = ax * SIM_A_RES;
+    float y = ay * SIM_A_RES;
+    float z = az * SIM_A_RES;
+    return sqrtf(x * x + y * y + z * z);
+}
+
+float getAccelMagnitude(void)
+{
+    int16_t x, y, z;
+    getAccelAdc(&x, &y, &z);
+    return getAccelMagnitudeFromAdc(x, y, z);
+}
+
+void getGyroAdc(int16_t *gx, int16_t *gy, int16_t *gz)
+{
+    sim_gyro(now_ms / 1000.0f, gx, gy, gz);
+}
+
+float getGyroResolution(void)
+{
+    return SIM_G_RES;
+}
+
+// samples at IMU_RATE_HZ up to the virtual time, like the MPU6886 FIFO
+int getImuSamples(btd_imu_raw_t *samples, int max)
+{
+    int64_t taken = now_ms * IMU_RATE_HZ / 1000 + 1;
+    if (imu_samples_read < 0)
+        imu_samples_read = taken - 1;
+    int count = 0;
+    while (count < max && imu_samples_read < taken)
+    {
+        float t = (float)imu_samples_read / IMU_RATE_HZ;
+        btd_imu_raw_t *sample = &samples[count++];
+        sim_accel(t, &sample->ax, &sample->ay, &sample->az);
+        sim_gyro(t, &sample->gx, &sample->gy, &sample->gz);
+        imu_samples_read++;
+    }
+    return count;
+}
+
+void resetImuSamples(void)
+{
+    imu_samples_read = -1;
+}
+
+// Microphone -------------------------------------------
+
+void init_microphone() {}
+
+int read_microphone_sample()
+{
+    // normal quietness at about 1700, see btd_audio.cpp
+    return (event_active(SIM_NOISE) ? 4000 : 1700) + noise(200);
+}
+
+// Buttons -------------------------------------------
+
+static bool is_press(const sim_event_t *event)
+{
+    return event->type == SIM_PRESS_A || event->type == SIM_PRESS_B;
+}
+
+void btn_init(void) {}
+
+bool btn_get_event(btn_event_t *event)
+{
+    // a press is reported once, at the first read after its time
+    for (size_t i = 0; i < sizeof(scenario) / sizeof(scenario[0]); i++)
+    {
+        const sim_event_t *press = &scenario[i];
+        if (press->start_ms > last_button_ms && press->start_ms <= now_ms && is_press(press))
+        {
+            last_button_ms = press->start_ms;
+            event->button = press->type == SIM_PRESS_A ? 'A' : 'B';
+            event->type = BTN_PRESS;
+            event->timestamp_us = press->start_ms * 1000;
+            looptime_record(&button_latency, (uint32_t)((now_ms - press->start_ms) * 1000));
+            return true;
+        }
+    }
+    return false;
+}
+
+char btn_detect_press(void)
+{
+    btn_event_t event;
+    if (!btn_get_event(&event))
+        return 'X';
+    return event.type == BTN_LONG_PRESS ? (char)tolower(event.button) : event.button;
+}
+
+void btn_wait(uint32_t timeout_ms)
+{
+    // like the queue on the device: wakes up at the next press
+    int64_t wait_ms = timeout_ms;
+    for (size_t i = 0; i < sizeof(scenario) / sizeof(scenario[0]); i++)
+    {
+        const sim_event_t *press = &scenario[i];
+        if (press->start_ms > last_button_ms && is_press(press) && press->start_ms - now_ms < wait_ms)
+            wait_ms = press->start_ms > now_ms ? press->start_ms - now_ms : 0;
+    }
+    advance(wait_ms);
+}
+
+void btn_latency_snapshot(looptime_hist_t *latency, uint32_t *dropped)
+{
+    memcpy(latency, &button_latency, sizeof(looptime_hist_t));
+    *dropped = 0;
+}
+
+// Battery -------------------------------------------
+
+void battery_init(void) {}
+
+int get_battery_percentage(void)
+{
+    // linear drain, 1% per 3 minutes
+    int percentage = 100 - now_ms / MIN(3);
+    return percentage < 0 ? 0 : percentage;
+}
+
+int get_battery_time_to_empty_min(void)
+{
+    return get_battery_percentage() * 3;
+}
+
+// Display -------------------------------------------
+
+void setup_display(void) {}
+void clear_display(void) {}
+
+void display_set_backlight(backlight_level_t level)
+{
+    counters.backlight_changes++;
+}
+void display_battery_percentage(int percentage) {}
+void display_wifi_code(void) {}
+void display_link_code(void) {}
+void display_time(int sec) {}
+void display_break_msg(void) {}
+void display_break_bar(void) {}
+void display_break_time(int break_sec, int battery) {}
+void display_working_msg(void) {}
+void display_working_bar(void) {}
+void display_working_time(int working_sec, int battery) {}
+void display_poll_benchmark(void) {}
+
+void display_break_info_screen(int battery)
+{
+    counters.break_screens++;
+    ESP_LOGI(TAG, "[%6.1f min] break", now_ms / 60000.0);
+}
+
+void display_working_info_screen(int battery)
+{
+    counters.working_screens++;
+    ESP_LOGI(TAG, "[%6.1f min] working", now_ms / 60000.0);
+}
+
+// Vibrator and buzzer -------------------------------------------
+
+void init_vibrator(void) {}
+void vibration_pattern_a(void) {}
+void init_buzzer(void) {}
+bool buzzer_play(const pattern_t *pattern) { return true; }
+
+// HTTP / Wi-Fi -------------------------------------------
+
+esp_err_t init_http_server(void)
+{
+    return ESP_OK;
+}
+
+bool http_station_connected(void)
+{
+    return false;
+}
+
+esp_err_t start_http_server(const char *ssid, const char *password)
+{
+    counters.http_starts++;
+    ap_on = true;
+    energy_set_feature(ENERGY_FEATURE_WIFI_AP, true);
+    ESP_LOGI(TAG, "[%6.1f min] awake", now_ms / 60000.0);
+    return ESP_OK;
+}
+
+esp_err_t stop_http_server()
+{
+    ap_on = false;
+    energy_set_feature(ENERGY_FEATURE_WIFI_AP, false);
+    return ESP_OK;
+}
+
+esp_err_t get_wifi_location_fingerprint(char *location_name_buffer, size_t buffer_size)
+{
+    strncpy(location_name_buffer, "Simulation", buffer_size - 1);
+    location_name_buffer[buffer_size - 1] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t stop_wifi()
+{
+    return ESP_OK;
+}
@@ -1,5 +1,7 @@
 
 
+#include <string.h>
+
 #include "freertos/FreeRTOS.h" // FreeRTOS API
 #include "freertos/task.h"     // Task management
 #include "esp_log.h"
@@ -15,8 +17,80 @@ static const char *NVS_NAMESPACE = "btd_stats";
 static const char *NVS_KEY_SESSION_COUNT = "session_count";
 static const char *NVS_KEY_SESSION_PREFIX = "session_";
 static const char *NVS_KEY_SESSION_ID = "session_id";
+static const char *NVS_KEY_LAYOUT = "layout";
+
+#define LAYOUT_RING 1 // the records are in a ring of STATS_MAX_SESSIONS keys
 
 static int session_id = -1;
+static bool layout_checked = false; // once per boot
+
+/*
+    In: open handle, number of sessions ever recorded
+    Firmware before the ring stored session n under session_<n>. The newest
+    STATS_MAX_SESSIONS of these move to their ring slot n % STATS_MAX_SESSIONS,
+    the older keys are erased, so the ring continues at count.
+*/
+static esp_err_t migrate_legacy_sessions(nvs_handle_t nvs_handle, uint32_t count)
+{
+    uint8_t layout = 0;
+    if (nvs_get_u8(nvs_handle, NVS_KEY_LAYOUT, &layout) == ESP_OK && layout >= LAYOUT_RING)
+        return ESP_OK;
+
+    // session_<n> below STATS_MAX_SESSIONS already is slot n, the slots written here
+    // only held sessions older than the newest STATS_MAX_SESSIONS
+    for (uint32_t n = STATS_MAX_SESSIONS; n < count; n++)
+    {
+        char key[20];
+        snprintf(key, sizeof(key), "%s%lu", NVS_KEY_SESSION_PREFIX, (unsigned long)n);
+        if (n + STATS_MAX_SESSIONS >= count)
+        {
+            session_stats_t record;
+            size_t size = sizeof(record);
+            if (nvs_get_blob(nvs_handle, key, &record, &size) == ESP_OK)
+            {
+                char slot[20];
+                snprintf(slot, sizeof(slot), "%s%lu", NVS_KEY_SESSION_PREFIX, (unsigned long)(n % STATS_MAX_SESSIONS));
+                esp_err_t err = nvs_set_blob(nvs_handle, slot, &record, size);
+                if (err != ESP_OK)
+                    return err;
+            }
+        }
+        nvs_erase_key(nvs_handle, key);
+    }
+    if (count > STATS_MAX_SESSIONS)
+        ESP_LOGI(TAG, "Moved the last %d of %lu sessions into the ring", STATS_MAX_SESSIONS, (unsigned long)count);
+    return nvs_set_u8(nvs_handle, NVS_KEY_LAYOUT, LAYOUT_RING);
+}
+
+/*
+    In: open handle
+    Out: number of sessions ever recorded
+*/
+static esp_err_t read_session_count(nvs_handle_t nvs_handle, uint32_t *count)
+{
+    esp_err_t err = nvs_get_u32(nvs_handle, NVS_KEY_SESSION_COUNT, count);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        *count = 0; // No sessions recorded yet
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error reading session count: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (!layout_checked)
+    {
+        err = migrate_legacy_sessions(nvs_handle, *count);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Error moving old sessions into the ring: %s", esp_err_to_name(err));
+            return err;
+        }
+        layout_checked = true;
+    }
+    return ESP_OK;
+}
 
 esp_err_t record_work_session(session_stats_t *stats)
 {
@@ -28,10 +102,9 @@ esp_err_t record_work_session(session_stats_t *stats)
         return err;
     }
 
-    // if not set, read and increment session_id
+    // read once per boot, then every recorded session gets the next id
     if (session_id < 0)
     {
-        size_t required_size = sizeof(session_id);
         err = nvs_get_u32(nvs_handle, NVS_KEY_SESSION_ID, (uint32_t *)&session_id);
         if (err == ESP_ERR_NVS_NOT_FOUND)
         {
@@ -40,33 +113,28 @@ esp_err_t record_work_session(session_stats_t *stats)
         else if (err != ESP_OK)
         {
             ESP_LOGE(TAG, "Error reading session ID: %s", esp_err_to_name(err));
+            session_id = -1;
             goto cleanup;
         }
-        session_id++;
-        err = nvs_set_u32(nvs_handle, NVS_KEY_SESSION_ID, session_id);
-        if (err != ESP_OK)
-        {
-            ESP_LOGE(TAG, "Error saving session ID: %s", esp_err_to_name(err));
-            goto cleanup;
-        }
+    }
+    session_id++;
+    err = nvs_set_u32(nvs_handle, NVS_KEY_SESSION_ID, session_id);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error saving session ID: %s", esp_err_to_name(err));
+        goto cleanup;
     }
     // Save the session stats with the current session ID
     stats->session_id = session_id; 
 
     uint32_t count = 0;
-    err = nvs_get_u32(nvs_handle, NVS_KEY_SESSION_COUNT, &count);
-    if (err == ESP_ERR_NVS_NOT_FOUND)
-    {
-        count = 0; // No sessions recorded yet
-    }
-    else if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error reading session count: %s", esp_err_to_name(err));
+    err = read_session_count(nvs_handle, &count);
+    if (err != ESP_OK)
         goto cleanup;
-    }
 
-    char key[16];
-    snprintf(key, sizeof(key), "session_%lu", count);
+    // count is the number of sessions ever recorded, the record goes to its slot of the ring
+    char key[20]; // the prefix and a u32
+    snprintf(key, sizeof(key), "%s%lu", NVS_KEY_SESSION_PREFIX, (unsigned long)(count % STATS_MAX_SESSIONS));
     err = nvs_set_blob(nvs_handle, key, stats, sizeof(session_stats_t));
     if (err != ESP_OK)
     {
@@ -89,7 +157,8 @@ cleanup:
 esp_err_t get_all_work_sessions(session_stats_t *sessions, size_t *count)
 {
     nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    // the first use after an update may move old records, see migrate_legacy_sessions()
+    esp_err_t err = nvs_open(NVS_NAMESPACE, layout_checked ? NVS_READONLY : NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
@@ -97,32 +166,34 @@ esp_err_t get_all_work_sessions(session_stats_t *sessions, size_t *count)
     }
 
     uint32_t session_count = 0;
-    err = nvs_get_u32(nvs_handle, NVS_KEY_SESSION_COUNT, &session_count);
-    if (err == ESP_ERR_NVS_NOT_FOUND)
-    {
-        session_count = 0; // No sessions recorded yet
-    }
-    else if (err != ESP_OK)
+    err = read_session_count(nvs_handle, &session_count);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Error reading session count: %s", esp_err_to_name(err));
         nvs_close(nvs_handle);
         return err;
     }
 
-    for (size_t i = 0; i < session_count && i < *count; i++)
+    // the newest records that fit, oldest first
+    uint32_t stored = session_count < STATS_MAX_SESSIONS ? session_count : STATS_MAX_SESSIONS;
+    if (stored > *count)
+        stored = *count;
+    size_t read = 0;
+    for (uint32_t n = session_count - stored; n < session_count; n++)
     {
-        char key[32];
-        snprintf(key, sizeof(key), "session_%zu", i);
+        char key[20];
+        snprintf(key, sizeof(key), "%s%lu", NVS_KEY_SESSION_PREFIX, (unsigned long)(n % STATS_MAX_SESSIONS));
         size_t required_size = sizeof(session_stats_t);
-        err = nvs_get_blob(nvs_handle, key, &sessions[i], &required_size);
+        memset(&sessions[read], 0, sizeof(session_stats_t)); // sessions of older firmware are shorter
+        err = nvs_get_blob(nvs_handle, key, &sessions[read], &required_size);
         if (err != ESP_OK)
         {
-            ESP_LOGE(TAG, "Error reading session stats for index %zu: %s", i, esp_err_to_name(err));
+            ESP_LOGE(TAG, "Error reading session stats for index %lu: %s", (unsigned long)n, esp_err_to_name(err));
             break; // Stop on error
         }
+        read++;
     }
 
-    *count = session_count; // Return the actual number of sessions read
+    *count = read; // Return the actual number of sessions read
     nvs_close(nvs_handle);
     return ESP_OK;
 }
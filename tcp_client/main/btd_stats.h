@@ -10,10 +10,25 @@ typedef struct
     uint32_t duration_seconds;  // Duration of the session in seconds
     char name[32];              // Name of the location
     uint8_t mic_level;          // Microphone level during the session (0-100)
+    uint32_t steps;             // Steps during the session
+    uint16_t cadence_spm;       // Mean cadence while walking, steps per minute
+    uint16_t display_on_s;      // Backlight on (full or dimmed) during the session
 } session_stats_t;
 
+// NVS keeps the records of the last STATS_MAX_SESSIONS sessions in a ring of keys
+#define STATS_MAX_SESSIONS 32
 
+
+/*
+    In: session to store, its session_id is set
+    overwrites the oldest record once STATS_MAX_SESSIONS are stored
+*/
 esp_err_t record_work_session(session_stats_t *stats);
+
+/*
+    In: room for count sessions
+    Out: the stored sessions, oldest first, and their number in count
+*/
 esp_err_t get_all_work_sessions(session_stats_t *sessions, size_t *count);
 
 #endif // BTDS_STATS_H
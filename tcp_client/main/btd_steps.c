@@ -0,0 +1,246 @@
+#include <math.h>
+#include <string.h>
+
+#include "btd_bandpass.h"
+#include "btd_steps.h"
+
+#define HPF_CUTOFF 0.5f
+#define LPF_CUTOFF 2.0f
+#define FILTER_DELAY_MS 80      // delay of the filtered peaks at walking cadence, subtracted from event times
+#define MIN_PEAK 0.05f          // g, filtered peaks below are never steps
+#define THRESHOLD_RATIO 0.5f    // of the running peak height
+#define PEAK_DECAY_S 2.0f       // time constant of the running peak height without steps
+#define REFRACTORY_MS 300       // shortest step interval, 200 steps/min
+#define MAX_STEP_INTERVAL_MS 2000 // longer gaps end a walking bout
+#define CADENCE_STEPS 4         // intervals averaged for steps_cadence()
+#define SETTLE_MS 1000          // the high-pass filter rings after steps_init(), no peaks are taken before
+
+static BandPassFilter hp, lp;
+static float decay = 1.0f;
+
+// filtered signal of the last two samples, for the peak detection
+static float y_prev = 0.0f, y_prev2 = 0.0f;
+static int64_t t_prev = 0;
+static int64_t t_start = -1;
+static float peak_level = 0.0f;
+
+static bool candidate_pending = false;
+static int64_t candidate_ms = 0;
+static float candidate_height = 0.0f;
+static int64_t last_candidate_ms = INT64_MIN / 2;
+
+// candidates that may start a bout
+static int64_t bout_candidates[STEPS_BOUT_MIN];
+static int bout_pending = 0;
+
+static bool walking = false;
+static int64_t bout_start_ms = 0;
+static int64_t last_step_ms = 0;
+static uint32_t bout_steps = 0;
+static uint16_t intervals[CADENCE_STEPS];
+static int interval_count = 0;
+
+static uint32_t total_steps = 0;
+static uint32_t session_steps = 0;
+static uint32_t session_intervals = 0;
+static int64_t session_walk_ms = 0;
+
+#if STEPS_EVENTS
+static btd_step_event_t events[STEPS_EVENT_BUFFER];
+static size_t event_head = 0; // oldest event
+static size_t event_count = 0;
+static uint32_t dropped_events = 0;
+#endif
+
+void steps_init(float sample_frequency)
+{
+    init_highpass(&hp, HPF_CUTOFF, sample_frequency);
+    init_lowpass(&lp, LPF_CUTOFF, sample_frequency);
+    decay = expf(-1.0f / (PEAK_DECAY_S * sample_frequency));
+
+    y_prev = y_prev2 = 0.0f;
+    t_start = -1;
+    peak_level = 0.0f;
+    candidate_pending = false;
+    last_candidate_ms = INT64_MIN / 2;
+    bout_pending = 0;
+    walking = false;
+    bout_steps = 0;
+    interval_count = 0;
+    total_steps = 0;
+#if STEPS_EVENTS
+    event_head = event_count = 0;
+    dropped_events = 0;
+#endif
+    steps_session_start();
+}
+
+static void emit(int64_t timestamp_ms, uint16_t interval_ms)
+{
+    total_steps++;
+    session_steps++;
+    bout_steps++;
+    last_step_ms = timestamp_ms;
+    if (interval_ms > 0)
+    {
+        intervals[interval_count++ % CADENCE_STEPS] = interval_ms;
+        session_walk_ms += interval_ms;
+        session_intervals++;
+    }
+
+#if STEPS_EVENTS
+    if (event_count == STEPS_EVENT_BUFFER)
+    {
+        event_head = (event_head + 1) % STEPS_EVENT_BUFFER;
+        event_count--;
+        dropped_events++;
+    }
+    btd_step_event_t *event = &events[(event_head + event_count++) % STEPS_EVENT_BUFFER];
+    event->timestamp_ms = timestamp_ms - FILTER_DELAY_MS;
+    event->index = total_steps;
+    event->interval_ms = interval_ms;
+#endif
+}
+
+// a candidate outlived its refractory period, returns the number of new steps
+static int commit_candidate(int64_t timestamp_ms)
+{
+    if (walking)
+    {
+        int64_t interval = timestamp_ms - last_step_ms;
+        if (interval <= MAX_STEP_INTERVAL_MS)
+        {
+            emit(timestamp_ms, interval);
+            return 1;
+        }
+        walking = false;
+    }
+
+    if (bout_pending > 0 && timestamp_ms - bout_candidates[bout_pending - 1] > MAX_STEP_INTERVAL_MS)
+        bout_pending = 0;
+    bout_candidates[bout_pending++] = timestamp_ms;
+    if (bout_pending < STEPS_BOUT_MIN)
+        return 0;
+
+    walking = true;
+    bout_start_ms = bout_candidates[0];
+    bout_steps = 0;
+    interval_count = 0;
+    for (int i = 0; i < STEPS_BOUT_MIN; i++)
+        emit(bout_candidates[i], i > 0 ? bout_candidates[i] - bout_candidates[i - 1] : 0);
+    bout_pending = 0;
+    return STEPS_BOUT_MIN;
+}
+
+int steps_update(float magnitude, int64_t timestamp_ms)
+{
+    float y = apply_filter(&lp, apply_filter(&hp, magnitude - 1.0f));
+    peak_level *= decay;
+    if (t_start < 0)
+        t_start = timestamp_ms;
+    int added = 0;
+
+    if (candidate_pending && timestamp_ms - candidate_ms >= REFRACTORY_MS)
+    {
+        candidate_pending = false;
+        last_candidate_ms = candidate_ms;
+        added += commit_candidate(candidate_ms);
+    }
+    if (walking && timestamp_ms - last_step_ms > MAX_STEP_INTERVAL_MS)
+        walking = false;
+
+    // local maximum at the previous sample
+    if (y_prev > y_prev2 && y_prev >= y && t_prev - t_start >= SETTLE_MS)
+    {
+        float threshold = fmaxf(MIN_PEAK, THRESHOLD_RATIO * peak_level);
+        if (y_prev > threshold)
+        {
+            if (candidate_pending)
+            {
+                // still within the refractory period, keep the higher peak
+                if (y_prev > candidate_height)
+                {
+                    candidate_ms = t_prev;
+                    candidate_height = y_prev;
+                }
+            }
+            else if (t_prev - last_candidate_ms >= REFRACTORY_MS)
+            {
+                candidate_pending = true;
+                candidate_ms = t_prev;
+                candidate_height = y_prev;
+                peak_level += 0.25f * (y_prev - peak_level);
+            }
+        }
+    }
+
+    y_prev2 = y_prev;
+    y_prev = y;
+    t_prev = timestamp_ms;
+    return added;
+}
+
+uint32_t steps_total(void)
+{
+    return total_steps;
+}
+
+void steps_session_start(void)
+{
+    session_steps = 0;
+    session_intervals = 0;
+    session_walk_ms = 0;
+}
+
+uint32_t steps_session_count(void)
+{
+    return session_steps;
+}
+
+uint16_t steps_session_cadence(void)
+{
+    if (session_walk_ms == 0)
+        return 0;
+    return (uint16_t)((int64_t)session_intervals * 60000 / session_walk_ms);
+}
+
+uint16_t steps_cadence(int64_t timestamp_ms)
+{
+    if (!walking || timestamp_ms - last_step_ms > MAX_STEP_INTERVAL_MS || interval_count == 0)
+        return 0;
+
+    int count = interval_count < CADENCE_STEPS ? interval_count : CADENCE_STEPS;
+    uint32_t sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += intervals[i];
+    return (uint16_t)(60000 * count / sum);
+}
+
+int64_t steps_bout_duration(int64_t timestamp_ms)
+{
+    if (!walking || timestamp_ms - last_step_ms > MAX_STEP_INTERVAL_MS)
+        return 0;
+    return last_step_ms - bout_start_ms;
+}
+
+uint32_t steps_bout_count(void)
+{
+    return walking ? bout_steps : 0;
+}
+
+#if STEPS_EVENTS
+size_t steps_read_events(btd_step_event_t *out, size_t max)
+{
+    size_t count = event_count < max ? event_count : max;
+    for (size_t i = 0; i < count; i++)
+        out[i] = events[(event_head + i) % STEPS_EVENT_BUFFER];
+    event_head = (event_head + count) % STEPS_EVENT_BUFFER;
+    event_count -= count;
+    return count;
+}
+
+uint32_t steps_dropped_events(void)
+{
+    return dropped_events;
+}
+#endif
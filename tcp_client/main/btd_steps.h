@@ -0,0 +1,107 @@
+#ifndef BTD_STEPS_H
+#define BTD_STEPS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Step detection on the accelerometer magnitude.
+// The magnitude runs through the high-pass/low-pass pair of btd_bandpass, peaks
+// of the filtered signal are step candidates when they exceed an adaptive
+// threshold (half the running peak height, decaying while no steps come in).
+// Within the refractory period after a candidate only a higher peak replaces it.
+// Candidates count as steps once STEPS_BOUT_MIN of them follow each other at
+// walking intervals, so single bumps are not counted; the steps of a bout that
+// starts are all reported at once, with their original timestamps.
+// Single task only, like the other detectors of btd_movement.
+
+#define STEPS_BOUT_MIN 4      // candidates in a row that start a walking bout
+
+// The timestamped step events are for the offline evaluation (tools/step_eval.py
+// builds with -DSTEPS_EVENTS=1); the firmware only reads the counters.
+#ifndef STEPS_EVENTS
+#define STEPS_EVENTS 0
+#endif
+
+#if STEPS_EVENTS
+#define STEPS_EVENT_BUFFER 32 // events kept until read, older ones are dropped
+
+typedef struct
+{
+    int64_t timestamp_ms; // time of the step, corrected for the filter delay
+    uint32_t index;       // number of the step since boot, starting at 1
+    uint16_t interval_ms; // time since the previous step of the bout, 0 for the first
+} btd_step_event_t;
+#endif
+
+/*
+    In: sampling frequency of steps_update() calls
+    resets all counters
+*/
+void steps_init(float sample_frequency);
+
+/*
+    In: accelerometer magnitude in g and its timestamp
+    Out: number of steps added by this sample (several when a bout starts)
+*/
+int steps_update(float magnitude, int64_t timestamp_ms);
+
+/*
+    Out: steps since steps_init()
+*/
+uint32_t steps_total(void);
+
+/*
+    starts the per session counters, e.g. at the start of a working session
+*/
+void steps_session_start(void);
+
+/*
+    Out: steps since steps_session_start()
+*/
+uint32_t steps_session_count(void);
+
+/*
+    Out: mean cadence in steps per minute while walking in this session, 0 without a bout
+*/
+uint16_t steps_session_cadence(void);
+
+/*
+    In: current timestamp
+    Out: cadence of the last steps in steps per minute, 0 if not walking
+*/
+uint16_t steps_cadence(int64_t timestamp_ms);
+
+/*
+    In: current timestamp
+    Out: duration of the current walking bout in ms, 0 if not walking
+*/
+int64_t steps_bout_duration(int64_t timestamp_ms);
+
+/*
+    Out: steps in the current walking bout
+*/
+uint32_t steps_bout_count(void);
+
+#if STEPS_EVENTS
+/*
+    In: room for max events
+    Out: number of events copied to out, oldest first; they are removed from the buffer
+*/
+size_t steps_read_events(btd_step_event_t *out, size_t max);
+
+/*
+    Out: events dropped because the buffer was full
+*/
+uint32_t steps_dropped_events(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_STEPS_H
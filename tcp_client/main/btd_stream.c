@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "btd_stream.h"
+
+// number of sequence numbers tracked for duplicate detection
+#define SEEN_WINDOW_BITS 64
+
+void stream_batch_reset(btd_stream_packet_t *packet, uint32_t seq, uint32_t period_us)
+{
+    packet->header.magic = BTD_STREAM_MAGIC;
+    packet->header.count = 0;
+    packet->header.seq = seq;
+    packet->header.period_us = period_us;
+    packet->header.timestamp_us = 0;
+}
+
+bool stream_batch_push(btd_stream_packet_t *packet, const btd_stream_sample_t *sample,
+                       int64_t timestamp_us, uint16_t batch_size)
+{
+    if (batch_size > BTD_STREAM_MAX_BATCH)
+        batch_size = BTD_STREAM_MAX_BATCH;
+
+    if (packet->header.count == 0)
+        packet->header.timestamp_us = timestamp_us;
+
+    packet->samples[packet->header.count++] = *sample;
+    return packet->header.count >= batch_size;
+}
+
+size_t stream_packet_size(const btd_stream_packet_t *packet)
+{
+    return sizeof(btd_stream_header_t) + packet->header.count * sizeof(btd_stream_sample_t);
+}
+
+void stream_rx_init(btd_stream_rx_stats_t *stats)
+{
+    memset(stats, 0, sizeof(btd_stream_rx_stats_t));
+}
+
+static void update_jitter(btd_stream_rx_stats_t *stats, int64_t transit_us)
+{
+    // RFC 3550, 6.4.1: J += (|D| - J) / 16, sender and receiver clock offset cancels out
+    int64_t d = transit_us - stats->last_transit_us;
+    if (d < 0)
+        d = -d;
+    stats->jitter_us += ((float)d - stats->jitter_us) / 16.0f;
+    stats->last_transit_us = transit_us;
+}
+
+int stream_rx_packet(btd_stream_rx_stats_t *stats, const uint8_t *data, size_t len, int64_t arrival_us)
+{
+    btd_stream_header_t header;
+    if (len < sizeof(header))
+        return -1;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != BTD_STREAM_MAGIC || header.count > BTD_STREAM_MAX_BATCH)
+        return -1;
+    if (len < sizeof(header) + header.count * sizeof(btd_stream_sample_t))
+        return -1;
+
+    int64_t transit_us = arrival_us - header.timestamp_us;
+
+    if (!stats->started)
+    {
+        stats->started = true;
+        stats->first_seq = header.seq;
+        stats->highest_seq = header.seq;
+        stats->seen_window = 1;
+        stats->received = 1;
+        stats->samples = header.count;
+        stats->last_transit_us = transit_us;
+        return header.count;
+    }
+
+    int32_t ahead = (int32_t)(header.seq - stats->highest_seq);
+    if (ahead > 0)
+    {
+        stats->seen_window = (ahead >= SEEN_WINDOW_BITS) ? 0 : stats->seen_window << ahead;
+        stats->seen_window |= 1;
+        stats->highest_seq = header.seq;
+    }
+    else
+    {
+        uint32_t behind = (uint32_t)(-ahead);
+        if (behind < SEEN_WINDOW_BITS)
+        {
+            if (stats->seen_window & (1ULL << behind))
+            {
+                stats->duplicates++;
+                return header.count;
+            }
+            stats->seen_window |= 1ULL << behind;
+        }
+        stats->reordered++;
+
+        // a late datagram from before the first one we saw extends the expected range
+        if ((int32_t)(header.seq - stats->first_seq) < 0)
+            stats->first_seq = header.seq;
+    }
+
+    stats->received++;
+    stats->samples += header.count;
+
+    uint32_t expected = stats->highest_seq - stats->first_seq + 1;
+    stats->lost = (expected > stats->received) ? expected - stats->received : 0;
+
+    update_jitter(stats, transit_us);
+    return header.count;
+}
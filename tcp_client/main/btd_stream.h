@@ -0,0 +1,90 @@
+#ifndef BTD_STREAM_H
+#define BTD_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BTD_STREAM_MAGIC 0xB7D5
+#define BTD_STREAM_MAX_BATCH 32 // upper bound for samples per datagram
+
+// Wire format of one datagram (little endian, no padding).
+// The header is followed by `count` raw accelerometer samples in ADC counts.
+typedef struct __attribute__((packed))
+{
+    uint16_t magic;       // BTD_STREAM_MAGIC
+    uint16_t count;       // number of samples in this batch
+    uint32_t seq;         // batch sequence number, increments by one per datagram
+    uint32_t period_us;   // time between two samples
+    int64_t timestamp_us; // capture time of the first sample (sender clock)
+} btd_stream_header_t;
+
+typedef struct __attribute__((packed))
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} btd_stream_sample_t;
+
+typedef struct __attribute__((packed))
+{
+    btd_stream_header_t header;
+    btd_stream_sample_t samples[BTD_STREAM_MAX_BATCH];
+} btd_stream_packet_t;
+
+// Receiver side statistics, see stream_rx_packet()
+typedef struct
+{
+    uint32_t received;     // unique datagrams received
+    uint32_t lost;         // datagrams missing between the first and the highest sequence number
+    uint32_t reordered;    // datagrams that arrived after a higher sequence number
+    uint32_t duplicates;   // datagrams received more than once
+    uint32_t samples;      // samples contained in unique datagrams
+    float jitter_us;       // RFC 3550 inter-arrival jitter estimate
+    // internal state
+    bool started;
+    uint32_t first_seq;
+    uint32_t highest_seq;
+    uint64_t seen_window;  // bit i set: highest_seq - i was received
+    int64_t last_transit_us;
+} btd_stream_rx_stats_t;
+
+/*
+    In: packet, sequence number and period of the next batch
+    Resets the packet to an empty batch
+*/
+void stream_batch_reset(btd_stream_packet_t *packet, uint32_t seq, uint32_t period_us);
+
+/*
+    In: packet, raw sample, capture timestamp and the configured batch size
+    Out: is true if the batch is full and should be sent
+*/
+bool stream_batch_push(btd_stream_packet_t *packet, const btd_stream_sample_t *sample,
+                       int64_t timestamp_us, uint16_t batch_size);
+
+/*
+    Out: number of bytes of the packet on the wire
+*/
+size_t stream_packet_size(const btd_stream_packet_t *packet);
+
+/*
+    Resets all receiver statistics
+*/
+void stream_rx_init(btd_stream_rx_stats_t *stats);
+
+/*
+    In: received datagram and its arrival time (receiver clock)
+    Out: number of samples in the datagram, or -1 if it is not a valid stream datagram
+    Updates loss, reordering, duplicate and jitter statistics.
+*/
+int stream_rx_packet(btd_stream_rx_stats_t *stats, const uint8_t *data, size_t len, int64_t arrival_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_STREAM_H
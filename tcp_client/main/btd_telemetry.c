@@ -0,0 +1,43 @@
+#include "btd_telemetry.h"
+
+static volatile uint8_t state = 0;
+static volatile uint16_t remaining_s = 0;
+static volatile uint8_t battery = 0;
+static volatile uint8_t loud = 0;
+static volatile uint16_t mic_level = 0;
+static volatile uint32_t steps = 0;
+static uint32_t seq = 0;
+
+void telemetry_set_state(uint8_t new_state, uint16_t new_remaining_s)
+{
+    state = new_state;
+    remaining_s = new_remaining_s;
+}
+
+void telemetry_set_battery(uint8_t percent)
+{
+    battery = percent;
+}
+
+void telemetry_set_audio(bool is_loud, uint16_t level)
+{
+    loud = is_loud;
+    mic_level = level;
+}
+
+void telemetry_set_steps(uint32_t total_steps)
+{
+    steps = total_steps;
+}
+
+void telemetry_serialize(btd_telemetry_frame_t *frame)
+{
+    frame->version = BTD_TELEMETRY_VERSION;
+    frame->state = state;
+    frame->remaining_s = remaining_s;
+    frame->battery = battery;
+    frame->loud = loud;
+    frame->mic_level = mic_level;
+    frame->steps = steps;
+    frame->seq = seq++;
+}
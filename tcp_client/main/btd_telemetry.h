@@ -0,0 +1,60 @@
+#ifndef BTD_TELEMETRY_H
+#define BTD_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Live device state for the /ws telemetry stream.
+// The controller updates the fields as it runs, the HTTP server serializes
+// them into one frame per period and sends that same frame to every client.
+// Fields are written by a single task and read without locking.
+
+#define BTD_TELEMETRY_VERSION 1
+
+// binary frame, little endian, 16 bytes
+typedef struct __attribute__((packed))
+{
+    uint8_t version;      // BTD_TELEMETRY_VERSION
+    uint8_t state;        // btd_state_t
+    uint16_t remaining_s; // seconds left in the current work or break phase
+    uint8_t battery;      // percent
+    uint8_t loud;         // 1 while the microphone level is above the threshold
+    uint16_t mic_level;   // last average microphone amplitude
+    uint32_t steps;       // steps detected since boot
+    uint32_t seq;         // frame counter
+} btd_telemetry_frame_t;
+
+/*
+    In: current state and the seconds left in it (0 if the state has no timer)
+*/
+void telemetry_set_state(uint8_t state, uint16_t remaining_s);
+
+/*
+    In: battery level in percent
+*/
+void telemetry_set_battery(uint8_t percent);
+
+/*
+    In: loudness flag and microphone level of the last reading
+*/
+void telemetry_set_audio(bool loud, uint16_t mic_level);
+
+/*
+    In: steps detected since boot
+*/
+void telemetry_set_steps(uint32_t steps);
+
+/*
+    Out: frame with the current values and the next sequence number
+*/
+void telemetry_serialize(btd_telemetry_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTD_TELEMETRY_H
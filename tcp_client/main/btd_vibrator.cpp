@@ -1,5 +1,8 @@
 #include <M5StickCPlus.h>
 #include "driver/gpio.h"
+#include "esp_timer.h"
+
+#include "btd_vibrator.h"
 
 #define CTRL_PIN 26
 
@@ -17,35 +20,53 @@ enum Vibrate_mode_t
 };
 static uint8_t mode = stop;
 
+#define VIBRATOR_CHANNEL 2
+
+// the pattern steps run on the esp_timer task, play() only queues
+static pattern_player_t player;
+static portMUX_TYPE player_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t step_timer = NULL;
+
+static void next_step(void *arg)
+{
+    uint8_t level;
+    taskENTER_CRITICAL(&player_lock);
+    uint32_t ms = pattern_next(&player, &level);
+    taskEXIT_CRITICAL(&player_lock);
+    ledcWriteChannel(VIBRATOR_CHANNEL, level);
+    if (ms > 0)
+        esp_timer_start_once(step_timer, ms * 1000);
+}
+
 void init_vibrator()
 {
-    bool status = ledcAttachChannel(CTRL_PIN, 500, 8, 2);
+    bool status = ledcAttachChannel(CTRL_PIN, 500, 8, VIBRATOR_CHANNEL);
+    pattern_player_init(&player);
+    esp_timer_create_args_t step_args = {.callback = next_step, .name = "vibrator"};
+    ESP_ERROR_CHECK(esp_timer_create(&step_args, &step_timer));
+}
+
+bool vibrator_play(const pattern_t *pattern)
+{
+    taskENTER_CRITICAL(&player_lock);
+    bool idle = pattern_is_idle(&player);
+    bool queued = pattern_play(&player, pattern);
+    taskEXIT_CRITICAL(&player_lock);
+    if (queued && idle)
+        esp_timer_start_once(step_timer, 0); // fails harmlessly if a step is already armed
+    return queued;
+}
+
+void vibrator_stop(void)
+{
+    taskENTER_CRITICAL(&player_lock);
+    pattern_stop(&player);
+    taskEXIT_CRITICAL(&player_lock);
+    esp_timer_stop(step_timer);
+    esp_timer_start_once(step_timer, 0); // the output is turned off on the timer task, after a running step
 }
 
 void vibration_pattern_a()
 {
-    printf("Start vibration");
-    M5.update();
-    ledcWriteChannel(2, 255);
-    delay(200);
-    M5.update();
-    ledcWriteChannel(2, 0);
-    delay(200);
-
-    M5.update();
-    ledcWriteChannel(2, 255);
-    delay(200);
-
-    M5.update();
-    ledcWriteChannel(2, 0);
-    delay(200);
-
-    M5.update();
-    ledcWriteChannel(2, 255);
-    delay(400);
-
-    M5.update();
-    ledcWriteChannel(2, 0);
-    M5.update();
-    printf("Stop vibration");
+    vibrator_play(&PATTERN_A);
 }
@@ -1,4 +1,19 @@
 #pragma once
+#include <stdbool.h>
+#include "btd_pattern.h"
 
 void init_vibrator(void);
-void vibration_pattern_a(void);
\ No newline at end of file
+
+/*
+    In: pattern
+    Out: false if PATTERN_QUEUE_LEN patterns are already waiting
+    returns at once, the pattern plays on the esp_timer task after the queued ones
+*/
+bool vibrator_play(const pattern_t *pattern);
+
+/*
+    stops the playing pattern and drops the queued ones
+*/
+void vibrator_stop(void);
+
+void vibration_pattern_a(void); // vibrator_play(&PATTERN_A)
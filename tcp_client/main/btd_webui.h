@@ -3,12 +3,34 @@
 #ifndef WEB_UI_H
 #define WEB_UI_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_http_server.h"
+
 // C++ compatibility guard
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-const char* get_web_ui_html();
+/*
+    Out: gzip compressed html of the config page (main/webui/index.html), len is its size in bytes
+*/
+const uint8_t* get_web_ui_gz(size_t *len);
+
+/*
+    Out: quoted ETag of the compressed page, changes with its content
+*/
+const char* get_web_ui_etag();
+
+/*
+    Out: size of the uncompressed page in bytes
+*/
+size_t get_web_ui_raw_size();
+
+/*
+    GET / handler, serves the compressed page with its ETag, a matching If-None-Match gets 304 without a body
+*/
+esp_err_t root_handler(httpd_req_t *req);
 
 #ifdef __cplusplus
 }
@@ -11,6 +11,7 @@
 #include "nvs.h"
 
 #include "btd_wifi.h"
+#include "btd_energy.h"
 
 static const char *TAG = "BTD_WIFI";
 
@@ -103,6 +104,7 @@ static esp_err_t scan_and_create_fingerprint(wifi_location_fingerprint_t *fp)
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_start());
+    energy_set_feature(ENERGY_FEATURE_WIFI_SCAN, true);
 
     wifi_scan_config_t scan_config = {.show_hidden = true, .scan_type = WIFI_SCAN_TYPE_ACTIVE};
     ESP_ERROR_CHECK(esp_wifi_scan_start(&scan_config, true));
@@ -130,6 +132,7 @@ static esp_err_t scan_and_create_fingerprint(wifi_location_fingerprint_t *fp)
     ESP_LOGI(TAG, "Location fingerprint created: %s", fp->name);
 
     ESP_ERROR_CHECK(stop_wifi());
+    energy_set_feature(ENERGY_FEATURE_WIFI_SCAN, false);
     return ESP_OK;
 }
 
@@ -0,0 +1,99 @@
+import argparse
+import re
+
+# build step of the timer digits (see main/CMakeLists.txt): renders the characters of the
+# timer from the In_eSPI font 2 tables (Fonts/Font16.c) at the text size of display_time()
+# into a 1 bit per pixel atlas, so btd_display.cpp can push a whole glyph in one window
+# instead of a fillRect per font pixel. The pixels are the ones drawChar() would set.
+
+CHARS = '0123456789:'
+FIRST_CHAR = 32  # widtbl_f16 and chrtbl_f16 start at ' '
+HEIGHT = 16  # chr_hgt_f16
+
+
+def parse_font(source):
+    widths = re.search(r'widtbl_f16\[96\]\s*=[^{]*\{(.*?)\};', source, re.S)[1]
+    widths = [int(w) for w in re.findall(r'\b\d+\b', re.sub(r'//[^\n]*', '', widths))]
+    glyphs = {}
+    for char in CHARS:
+        name = 'chr_f16_{:02X}'.format(ord(char))
+        body = re.search(name + r'\[\d+\]\s*=[^{]*\{(.*?)\};', source, re.S)[1]
+        body = re.sub(r'//[^\n]*', '', body)
+        glyphs[char] = [int(b, 16) for b in re.findall(r'0x([0-9A-Fa-f]{2})', body)]
+    return widths, glyphs
+
+
+def render(width, data, scale):
+    # rows of 0/1 at the scaled size; a font row is (width + 6) / 8 bytes, MSB first
+    row_bytes = (width + 6) // 8
+    rows = []
+    for y in range(HEIGHT):
+        bits = []
+        for x in range(width):
+            byte = data[y * row_bytes + x // 8]
+            bits += [(byte >> (7 - x % 8)) & 1] * scale
+        rows += [bits] * scale
+    return rows
+
+
+def pack(rows):
+    data = []
+    for bits in rows:
+        for i in range(0, len(bits), 8):
+            chunk = bits[i:i + 8] + [0] * (8 - len(bits[i:i + 8]))
+            data.append(sum(bit << (7 - n) for n, bit in enumerate(chunk)))
+    return data
+
+
+def header(source, scale):
+    widths, glyphs = parse_font(source)
+    atlas = []
+    entries = []
+    for char in CHARS:
+        width = widths[ord(char) - FIRST_CHAR]
+        entries.append((char, width * scale, len(atlas)))
+        atlas += pack(render(width, glyphs[char], scale))
+    lines = [
+        '// generated by digit_atlas.py from Font16.c, do not edit',
+        '#pragma once',
+        '',
+        '#include <stdint.h>',
+        '',
+        f'#define DIGIT_ATLAS_SCALE {scale}',
+        f'#define DIGIT_ATLAS_HEIGHT {HEIGHT * scale}',
+        f'#define DIGIT_ATLAS_MAX_WIDTH {max(e[1] for e in entries)}',
+        f'#define DIGIT_ATLAS_GLYPHS {len(entries)}',
+        '',
+        'typedef struct',
+        '{',
+        '    char c;',
+        '    uint8_t width;   // pixels, rows are (width + 7) / 8 bytes, MSB first',
+        '    uint16_t offset; // into DIGIT_ATLAS',
+        '} digit_glyph_t;',
+        '',
+        'static const digit_glyph_t DIGIT_GLYPHS[DIGIT_ATLAS_GLYPHS] = {',
+    ]
+    for char, width, offset in entries:
+        lines.append(f"    {{'{char}', {width}, {offset}}},")
+    lines += ['};', '', f'static const uint8_t DIGIT_ATLAS[{len(atlas)}] = {{']
+    for i in range(0, len(atlas), 16):
+        lines.append('    ' + ', '.join(f'0x{b:02x}' for b in atlas[i:i + 16]) + ',')
+    lines.append('};')
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('font')
+    parser.add_argument('output')
+    parser.add_argument('--scale', type=int, default=4)
+    args = parser.parse_args()
+
+    with open(args.font) as fp:
+        source = fp.read()
+    with open(args.output, 'w') as fp:
+        fp.write(header(source, args.scale))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,51 @@
+import argparse
+import gzip
+import hashlib
+
+# build step of the web UI (see main/CMakeLists.txt): compresses index.html into a C header
+# with the gzip bytes and an ETag, so btd_webui.cpp can serve them with Content-Encoding: gzip.
+# mtime is fixed, the output only changes when the html does.
+
+
+def compress(html):
+    return gzip.compress(html, compresslevel=9, mtime=0)
+
+
+def etag(data):
+    # strong validator, quoted as sent in the header
+    return '"' + hashlib.sha256(data).hexdigest()[:16] + '"'
+
+
+def header(html):
+    data = compress(html)
+    lines = [
+        '// generated by gzip_webui.py from index.html, do not edit',
+        '#pragma once',
+        '',
+        '#include <stdint.h>',
+        '',
+        '#define WEB_UI_ETAG "' + etag(data).replace('"', '\\"') + '"',
+        f'#define WEB_UI_RAW_SIZE {len(html)}',
+        '',
+        f'static const uint8_t WEB_UI_GZ[{len(data)}] = {{',
+    ]
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join(f'0x{b:02x}' for b in data[i:i + 16]) + ',')
+    lines.append('};')
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('html')
+    parser.add_argument('output')
+    args = parser.parse_args()
+
+    with open(args.html, 'rb') as fp:
+        html = fp.read()
+    with open(args.output, 'w') as fp:
+        fp.write(header(html))
+
+
+if __name__ == '__main__':
+    main()
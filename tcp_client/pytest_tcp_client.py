@@ -1,7 +1,19 @@
 # SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: Apache-2.0
+import ctypes
+import gzip
+import hashlib
+import json
 import logging
+import math
+import os
+import random
+import re
 import socket
+import struct
+import subprocess
+import sys
+import time
 
 import pytest
 from common_test_methods import get_env_config_variable
@@ -81,3 +93,785 @@ def test_examples_tcp_client_ipv6(dut: Dut) -> None:
         print('Connect tcp client to server IP={}'.format(server_ip))
         dut.write(server_ip)
         dut.expect('OK: Message from ESP32')
+
+
+def build_host_lib(tmp_path: str, *srcs: str, includes: tuple = (), sizes: tuple = ()) -> ctypes.CDLL:
+    # builds sources (paths relative to tcp_client/) into a shared library for the host tests, main/ is on the
+    # include path; each type in sizes gets size_t sizeof_<type>(void) from the headers of the sources
+    here = os.path.dirname(__file__)
+    paths = [os.path.join(here, src) for src in srcs]
+    if sizes:
+        shim = os.path.join(tmp_path, 'sizes.c')
+        with open(shim, 'w') as fp:
+            fp.write('#include <stddef.h>\n')
+            for path in paths:
+                header = os.path.splitext(path)[0] + '.h'
+                if os.path.exists(header):
+                    fp.write('#include "{}"\n'.format(os.path.basename(header)))
+            for name in sizes:
+                fp.write('size_t sizeof_{0}(void) {{ return sizeof({0}); }}\n'.format(name))
+        paths.append(shim)
+    library = os.path.join(tmp_path, os.path.splitext(os.path.basename(srcs[0]))[0] + '.so')
+    flags = [flag for include in includes + ('main',) for flag in ('-I', os.path.join(here, include))]
+    subprocess.check_call([os.environ.get('CC', 'cc'), '-O2', '-shared', '-fPIC'] + flags + ['-o', library] +
+                          paths + ['-lm'])
+    lib = ctypes.CDLL(library)
+    for name in sizes:
+        getattr(lib, 'sizeof_' + name).restype = ctypes.c_size_t
+    return lib
+
+
+def host_object(lib: ctypes.CDLL, name: str) -> ctypes.Array:
+    # zeroed storage for a C type of a build_host_lib() library, sized by its sizeof_<type>()
+    return ctypes.create_string_buffer(getattr(lib, 'sizeof_' + name)())
+
+
+class StreamRxStats(ctypes.Structure):
+    _fields_ = [('received', ctypes.c_uint32), ('lost', ctypes.c_uint32), ('reordered', ctypes.c_uint32),
+                ('duplicates', ctypes.c_uint32), ('samples', ctypes.c_uint32), ('jitter_us', ctypes.c_float),
+                ('started', ctypes.c_bool), ('first_seq', ctypes.c_uint32), ('highest_seq', ctypes.c_uint32),
+                ('seen_window', ctypes.c_uint64), ('last_transit_us', ctypes.c_int64)]
+
+
+class StreamSample(ctypes.Structure):
+    _fields_ = [('x', ctypes.c_int16), ('y', ctypes.c_int16), ('z', ctypes.c_int16)]
+
+
+@pytest.mark.host_test
+def test_stream_loopback(tmp_path: str) -> None:
+    # batches packed by main/btd_stream.c as btd_sender.c does, sent over a loopback UDP socket with two datagrams
+    # dropped, one late and one twice; the receiver statistics of btd_stream.c and of server/udp_server.py
+    here = os.path.dirname(__file__)
+    lib = build_host_lib(tmp_path, 'main/btd_stream.c', sizes=('btd_stream_packet_t', 'btd_stream_rx_stats_t'))
+    assert ctypes.sizeof(StreamRxStats) == lib.sizeof_btd_stream_rx_stats_t()
+    lib.stream_batch_push.restype = ctypes.c_bool
+    lib.stream_packet_size.restype = ctypes.c_size_t
+    lib.stream_rx_packet.restype = ctypes.c_int
+    sys.path.insert(0, os.path.join(here, 'server'))
+    from udp_server import StreamStats
+
+    period_us, batch, batches = 10000, 10, 20
+    datagrams = {}
+    packet = host_object(lib, 'btd_stream_packet_t')
+    for seq in range(batches):
+        lib.stream_batch_reset(packet, seq, period_us)
+        count = batch if seq < batches - 1 else batch // 2  # the end of a session flushes a short batch
+        for i in range(count):
+            n = seq * batch + i
+            sample = StreamSample(n, -n, 1000 + n)
+            full = lib.stream_batch_push(packet, ctypes.byref(sample), ctypes.c_int64(n * period_us), batch)
+            assert full == (i == batch - 1)
+        datagrams[seq] = packet.raw[:lib.stream_packet_size(packet)]
+    order = [s for s in range(batches) if s not in (5, 9, 12)]
+    order.insert(order.index(10) + 1, 9)  # 9 arrives after 10
+    order.insert(order.index(3) + 1, 3)   # 3 arrives twice
+
+    rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    tx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    rx.bind(('127.0.0.1', 0))
+    rx.settimeout(2)
+    for seq in order:
+        tx.sendto(datagrams[seq], rx.getsockname())
+
+    stats = StreamRxStats()
+    lib.stream_rx_init(ctypes.byref(stats))
+    reference = StreamStats()
+    seen = set()
+    for _ in order:
+        data = rx.recv(2048)
+        magic, count, seq, _, timestamp_us = struct.unpack_from('<HHIIq', data)
+        assert magic == 0xB7D5 and len(data) == 20 + 6 * count
+        # the transit of unique datagrams alternates between 5 and 7 ms, whatever the loopback took
+        arrival_us = timestamp_us + (5000 if len(seen) % 2 else 7000)
+        seen.add(seq)
+        assert lib.stream_rx_packet(ctypes.byref(stats), data, len(data), ctypes.c_int64(arrival_us)) == count
+        assert struct.unpack_from('<hhh', data, 20) == (seq * batch, -seq * batch, 1000 + seq * batch)
+        reference.update(seq, timestamp_us, count, arrival_us)
+    rx.close()
+    tx.close()
+
+    assert (stats.received, stats.lost, stats.reordered, stats.duplicates) == (18, 2, 1, 1)
+    assert stats.samples == 17 * batch + batch // 2
+    assert (stats.first_seq, stats.highest_seq) == (0, batches - 1)
+    assert (reference.received, reference.lost, reference.reordered, reference.duplicates, reference.samples) == \
+        (stats.received, stats.lost, stats.reordered, stats.duplicates, stats.samples)
+    # J += (|D| - J) / 16 with a constant |D| of 2 ms, after each unique datagram but the first
+    assert math.isclose(stats.jitter_us, 2000 * (1 - (15 / 16) ** (stats.received - 1)), rel_tol=1e-4)
+    assert math.isclose(stats.jitter_us, reference.jitter_us, rel_tol=1e-4)
+    lib.stream_rx_init(ctypes.byref(stats))
+    assert stats.received == 0 and not stats.started
+
+
+class ConnRecord(ctypes.Structure):
+    _fields_ = [('seq', ctypes.c_uint32), ('len', ctypes.c_uint16), ('data', ctypes.c_uint8 * 128)]
+
+
+class Conn(ctypes.Structure):
+    # btd_conn_t of main/btd_conn.h
+    _fields_ = [('host', ctypes.c_char * 40), ('port', ctypes.c_int), ('session_id', ctypes.c_uint32),
+                ('backoff_min_ms', ctypes.c_uint32), ('backoff_max_ms', ctypes.c_uint32), ('state', ctypes.c_int),
+                ('sock', ctypes.c_int), ('deadline_ms', ctypes.c_int64), ('next_attempt_ms', ctypes.c_int64),
+                ('backoff_ms', ctypes.c_uint32), ('rng', ctypes.c_uint32), ('rx', ctypes.c_uint8 * 32),
+                ('rx_len', ctypes.c_size_t), ('tx', ctypes.c_uint8 * 136), ('tx_len', ctypes.c_size_t),
+                ('tx_sent', ctypes.c_size_t), ('records', ctypes.POINTER(ConnRecord)), ('capacity', ctypes.c_size_t),
+                ('first_seq', ctypes.c_uint32), ('send_seq', ctypes.c_uint32), ('next_seq', ctypes.c_uint32),
+                ('connects', ctypes.c_uint32), ('disconnects', ctypes.c_uint32), ('dropped_records', ctypes.c_uint32),
+                ('replayed_records', ctypes.c_uint32)]
+
+
+@pytest.mark.host_test
+def test_resume_stream(tmp_path: str) -> None:
+    # main/btd_conn.c streams records built like btd_sender.c does to server/resume_server.py, the server is
+    # killed mid-stream and restarted from its journal; every sample has to arrive exactly once, in order
+    here = os.path.dirname(__file__)
+    lib = build_host_lib(tmp_path, 'main/btd_conn.c', 'main/btd_delta.c', includes=('tools/conn_host',),
+                         sizes=('btd_conn_t', 'btd_conn_record_t', 'btd_delta_encoder_t'))
+    assert ctypes.sizeof(Conn) == lib.sizeof_btd_conn_t()
+    assert ctypes.sizeof(ConnRecord) == lib.sizeof_btd_conn_record_t()
+    lib.conn_submit.restype = ctypes.c_int
+    lib.conn_pending.restype = ctypes.c_size_t
+    lib.delta_encode_sample.restype = ctypes.c_size_t
+    sys.path.insert(0, os.path.join(here, 'server'))
+    import resume_server
+
+    with socket.socket() as probe:
+        probe.bind(('127.0.0.1', 0))
+        port = probe.getsockname()[1]
+    journal = os.path.join(tmp_path, 'journal.bin')
+
+    def start_server() -> subprocess.Popen:
+        return subprocess.Popen([sys.executable, os.path.join(here, 'server', 'resume_server.py'), '--port', str(port),
+                                 '--journal', journal], stdout=subprocess.DEVNULL)
+
+    capacity = 128
+    records = (ConnRecord * capacity)()
+    conn = Conn()
+    lib.conn_init(ctypes.byref(conn), records, ctypes.c_size_t(capacity), b'127.0.0.1', port,
+                  ctypes.c_uint32(0x5E55104), ctypes.c_uint32(1))
+    lib.conn_set_backoff(ctypes.byref(conn), 20, 200)
+
+    rng = random.Random(26)
+    samples, sample = [], [0, 0, 2048]
+    for _ in range(3000):
+        sample = [max(-32768, min(32767, v + rng.randint(-300, 300))) for v in sample]
+        samples.append(tuple(sample))
+
+    encoder = host_object(lib, 'btd_delta_encoder_t')
+    record = (ctypes.c_uint8 * 128)()
+    record_len = 0
+    killed_at = pending = None
+    start = time.monotonic()
+    server = start_server()
+    try:
+        for n, sample in enumerate(samples):
+            if killed_at is None and n >= 1000 and lib.conn_pending(ctypes.byref(conn)):
+                server.kill()  # with records in flight that were not acknowledged yet
+                server.wait()
+                killed_at, pending = n, lib.conn_pending(ctypes.byref(conn))
+            elif killed_at is not None and n == killed_at + 600:
+                server = start_server()
+            now_ms = int((time.monotonic() - start) * 1000)
+            if record_len == 0:
+                lib.delta_encoder_init(encoder, 0)
+                struct.pack_into('<I', record, 0, now_ms)
+                record_len = 4
+            out = ctypes.cast(ctypes.addressof(record) + record_len, ctypes.POINTER(ctypes.c_uint8))
+            record_len += lib.delta_encode_sample(encoder, (ctypes.c_int16 * 3)(*sample), out)
+            if record_len + 9 > 128:  # BTD_DELTA_MAX_SAMPLE_BYTES
+                assert lib.conn_submit(ctypes.byref(conn), record, ctypes.c_size_t(record_len)) == 0
+                record_len = 0
+            lib.conn_poll(ctypes.byref(conn), ctypes.c_int64(now_ms))
+            time.sleep(0.001)
+        if record_len:
+            lib.conn_submit(ctypes.byref(conn), record, ctypes.c_size_t(record_len))
+        deadline = time.monotonic() + 10
+        while lib.conn_pending(ctypes.byref(conn)) and time.monotonic() < deadline:
+            lib.conn_poll(ctypes.byref(conn), ctypes.c_int64(int((time.monotonic() - start) * 1000)))
+            time.sleep(0.005)
+        assert lib.conn_pending(ctypes.byref(conn)) == 0
+    finally:
+        lib.conn_close(ctypes.byref(conn))
+        server.kill()
+        server.wait()
+
+    assert killed_at is not None and pending > 0 and conn.disconnects >= 1 and conn.connects >= 2
+    assert conn.dropped_records == 0
+    resume_server.load_journal(journal)
+    session = resume_server.sessions[0x5E55104]
+    assert session.missing == 0
+    assert session.samples == samples  # nothing lost, nothing twice
+    logging.info('resume stream: {} records, {} replayed after {} disconnects'.format(
+        session.records, conn.replayed_records, conn.disconnects))
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_tima_simulation(dut: Dut) -> None:
+    # scripted scenario of btd_sim.cpp, runs ~100 virtual minutes in virtual time
+    dut.expect(r'first frame\s+\d+ ms', timeout=10)  # boot timeline, after the first awake screen
+    dut.expect('walking detected!', timeout=10)
+    dut.expect('break-gesture detected!', timeout=10)
+    res = dut.expect(r'SIM DONE: power off at ([\d.]+) virtual min, ([\d.]+) ms cpu.*?'
+                     r'(\d+) work sessions, (\d+) breaks', timeout=10)
+    assert float(res[1]) > 100
+    assert int(res[3]) == 5
+    assert int(res[4]) == 3
+    logging.info('simulation cpu time: {} ms'.format(res[2].decode()))
+
+
+@pytest.mark.host_test
+def test_webui_gzip(tmp_path: str) -> None:
+    # the build step of main/CMakeLists.txt and root_handler() of main/btd_webui.cpp against a recording httpd
+    here = os.path.dirname(__file__)
+    main = os.path.join(here, 'main')
+    webui = os.path.join(main, 'webui')
+    html_path = os.path.join(webui, 'index.html')
+    header = os.path.join(tmp_path, 'btd_webui_gz.h')
+    subprocess.check_call([sys.executable, os.path.join(webui, 'gzip_webui.py'), html_path, header])
+    with open(header) as fp:
+        text = fp.read()
+    with open(html_path, 'rb') as fp:
+        html = fp.read()
+
+    body = bytes(int(b, 16) for b in re.findall(r'0x([0-9a-f]{2})', text))
+    etag = re.search(r'#define WEB_UI_ETAG "\\"([0-9a-f]+)\\""', text)[1]
+    assert gzip.decompress(body) == html
+    assert body[4:8] == bytes(4)  # no timestamp, the build is reproducible
+    assert etag == hashlib.sha256(body).hexdigest()[:16]
+    assert int(re.search(r'WEB_UI_RAW_SIZE (\d+)', text)[1]) == len(html)
+
+    lib = build_host_lib(tmp_path, 'main/btd_webui.cpp', 'tools/http_host/httpd_fake.c',
+                         includes=(tmp_path, 'tools/http_host', 'tools/conn_host'))
+    lib.httpd_fake_call.restype = ctypes.c_size_t
+    lib.httpd_fake_call.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t]
+
+    def get(request_headers: bytes) -> tuple:
+        response = ctypes.create_string_buffer(len(body) + 1024)
+        length = lib.httpd_fake_call(ctypes.cast(lib.root_handler, ctypes.c_void_p), request_headers, response,
+                                     len(response))
+        head, _, content = response.raw[:length].partition(b'\r\n\r\n')
+        lines = head.decode().split('\r\n')
+        return lines[0], dict(line.split(': ', 1) for line in lines[1:]), content
+
+    for request_headers in (b'', b'If-None-Match: "0000000000000000"\r\n', b'Accept: */*\r\n'):
+        status, headers, content = get(request_headers)
+        assert status == 'HTTP/1.1 200 OK'
+        assert headers['Content-Encoding'] == 'gzip' and headers['Content-Type'] == 'text/html'
+        assert headers['ETag'] == '"{}"'.format(etag) and headers['Cache-Control'] == 'no-cache'
+        assert content == body and int(headers['Content-Length']) == len(body)
+
+    status, headers, content = get('Accept: */*\r\nIf-None-Match: "{}"\r\n'.format(etag).encode())
+    assert status == 'HTTP/1.1 304 Not Modified'
+    assert headers['ETag'] == '"{}"'.format(etag) and 'Content-Encoding' not in headers
+    assert content == b'' and headers['Content-Length'] == '0'
+    logging.info('web UI: {} B gzip of {} B'.format(len(body), len(html)))
+
+
+class Config(ctypes.Structure):
+    _fields_ = [('workTimeSeconds', ctypes.c_uint16), ('breakTimeSeconds', ctypes.c_uint16),
+                ('longBreakTimeSeconds', ctypes.c_uint16), ('longBreakSessionCount', ctypes.c_uint16),
+                ('timeoutSeconds', ctypes.c_uint16), ('breakGestureEnabled', ctypes.c_bool)]
+
+
+CONFIG_RANGES = {'workTimeSeconds': (10, 14400), 'breakTimeSeconds': (10, 3600), 'longBreakTimeSeconds': (10, 7200),
+                 'longBreakSessionCount': (1, 20), 'timeoutSeconds': (0, 3600), 'breakGestureEnabled': None}
+
+
+def config_value_valid(key: str, value: object) -> bool:
+    if CONFIG_RANGES[key] is None:
+        return isinstance(value, bool)
+    low, high = CONFIG_RANGES[key]
+    return type(value) is int and low <= value <= high
+
+
+def random_json_value(depth: int = 0) -> object:
+    kind = random.randrange(7 if depth < 3 else 4)
+    if kind == 0:
+        return random.choice([True, False, None])
+    if kind == 1:
+        return random.choice([random.randrange(-5, 30), random.randrange(0, 70000), -random.randrange(1, 99999)])
+    if kind == 2:
+        return random.choice([1.0, 0.5, -2.5e3, 1e300])
+    if kind == 3:
+        return ''.join(random.choice('ab "\\/\n\u00e9{}[]:,') for _ in range(random.randrange(6)))
+    if kind == 4:
+        return [random_json_value(depth + 1) for _ in range(random.randrange(4))]
+    return {random.choice(list(CONFIG_RANGES) + ['x', 'name']): random_json_value(depth + 1)
+            for _ in range(random.randrange(4))}
+
+
+@pytest.mark.host_test
+def test_config_json(tmp_path: str) -> None:
+    # the config codec of main/btd_config_json.c against Python's json module, with a mutation fuzz of the
+    # invariants (see tools/config_json_bench/ for the ASan build and the timing)
+    lib = build_host_lib(tmp_path, 'main/btd_config_json.c', includes=('tools/conn_host',), sizes=('btd_config_t',))
+    assert ctypes.sizeof(Config) == lib.sizeof_btd_config_t()
+    lib.config_json_parse.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_char_p]
+    lib.config_json_write.restype = ctypes.c_size_t
+    lib.config_json_write.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+    before = Config(1234, 321, 999, 4, 77, True)
+    error = ctypes.create_string_buffer(64)  # CONFIG_JSON_ERROR_LEN
+
+    def parse(text: bytes) -> Config:
+        config = Config.from_buffer_copy(before)
+        error.value = b''
+        if lib.config_json_parse(text, len(text), ctypes.byref(config), error) != 0:
+            assert bytes(config) == bytes(before), text  # nothing applied on error
+            assert error.value, text
+            return None
+        return config
+
+    def write(config: Config, size: int = 512) -> bytes:
+        out = ctypes.create_string_buffer(size)
+        length = lib.config_json_write(ctypes.byref(config), out, size)
+        return out.raw[:length]
+
+    assert json.loads(write(before)) == {key: getattr(before, key) for key in CONFIG_RANGES}
+    assert bytes(parse(write(before))) == bytes(before)
+    assert write(before, len(write(before))) == b''
+    assert parse(b'{"timeoutSeconds": 0, "name": {"a": [1, "}"]}}').timeoutSeconds == 0
+    assert parse(b' {"timeoutSeconds":-0}\n').timeoutSeconds == 0
+    for invalid, message in ((b'{"workTimeSeconds": 9}', b'workTimeSeconds must be 10..14400'),
+                             (b'{"breakTimeSeconds": 60.0}', b'breakTimeSeconds must be an integer'),
+                             (b'{"breakGestureEnabled": 1}', b'breakGestureEnabled must be true or false'),
+                             (b'{"timeoutSeconds": 0} x', b'invalid json at offset 22'),
+                             (b'{"timeoutSeconds": 0', b'unexpected end of json'),
+                             (b'{"a":' + b'[' * 17 + b']' * 17 + b'}', b'json nested too deep')):
+        assert parse(invalid) is None and error.value == message, invalid
+
+    # generated objects: accepted exactly when every known field is valid, with the values Python reads
+    random.seed(3)
+    for _ in range(3000):
+        document = {random.choice(list(CONFIG_RANGES) + ['note', 'list']): random_json_value()
+                    for _ in range(random.randrange(8))}
+        for key in document:
+            if CONFIG_RANGES.get(key) and random.random() < 0.5:  # the edges of the range
+                document[key] = random.choice(CONFIG_RANGES[key]) + random.choice([-1, 0, 1])
+        text = json.dumps(document, separators=random.choice([(',', ':'), (', ', ': ')]),
+                          ensure_ascii=random.random() < 0.5).encode()
+        config = parse(text)
+        known = {key: value for key, value in document.items() if key in CONFIG_RANGES}
+        assert (config is not None) == all(config_value_valid(key, value) for key, value in known.items()), text
+        if config is not None:
+            for key, value in known.items():
+                assert getattr(config, key) == value, text
+            assert bytes(parse(write(config))) == bytes(config)
+
+    # mutations of the valid objects: the reader is lenient in skipped values, so only one direction holds
+    def strict_pairs(text: bytes) -> list:
+        def no_constants(name: str) -> None:
+            raise ValueError(name)
+        try:
+            pairs = json.loads(text.decode(), object_pairs_hook=lambda pairs: pairs, parse_constant=no_constants)
+        except ValueError:
+            return None
+        return pairs if isinstance(pairs, list) and all(isinstance(pair, tuple) for pair in pairs) else None
+
+    seeds = [write(before), b'{ "breakTimeSeconds" : 60 , "breakGestureEnabled" : false, "name": "a\\"b" }',
+             b'{"tags":[1,2.5e3,{"a":[true,null,-1]}],"workTimeSeconds":600}']
+    accepted = 0
+    for _ in range(20000):
+        text = bytearray(random.choice(seeds))
+        for _ in range(random.randrange(1, 4)):
+            at = random.randrange(len(text) + 1)
+            edit = random.randrange(3)
+            if edit == 0:
+                del text[at:at + 1]
+            elif edit == 1:
+                text.insert(at, random.choice(b'{}[]":,.-+0123456789eEtrufalsn \\x'))
+            else:
+                text[at:at] = text[at:at + random.randrange(8)]
+        text = bytes(text)
+        config = parse(text)
+        pairs = strict_pairs(text)
+        if config is not None:
+            accepted += 1
+            assert bytes(parse(write(config))) == bytes(config), text
+        if pairs is None or any('\\' in key for key, value in pairs):
+            continue
+        if all(config_value_valid(key, value) for key, value in pairs if key in CONFIG_RANGES):
+            assert config is not None, text
+            for key, value in dict(pairs).items():  # the last of duplicated keys wins in both readers
+                if key in CONFIG_RANGES:
+                    assert getattr(config, key) == value, text
+    logging.info('config json: {} of 20000 mutations accepted'.format(accepted))
+
+
+@pytest.mark.host_test
+def test_digit_atlas(tmp_path: str) -> None:
+    # the build step of main/CMakeLists.txt, checks the glyphs against the font 2 tables
+    here = os.path.dirname(__file__)
+    font_path = os.path.join(here, 'components', 'M5StickCPlus', 'src', 'Fonts', 'Font16.c')
+    header = os.path.join(tmp_path, 'btd_digit_atlas.h')
+    subprocess.check_call([sys.executable, os.path.join(here, 'main', 'digits', 'digit_atlas.py'), font_path, header])
+    with open(header) as fp:
+        text = fp.read()
+    with open(font_path) as fp:
+        font = fp.read()
+
+    scale = int(re.search(r'DIGIT_ATLAS_SCALE (\d+)', text)[1])
+    height = int(re.search(r'DIGIT_ATLAS_HEIGHT (\d+)', text)[1])
+    atlas = [int(b, 16) for b in re.findall(r'0x([0-9a-f]{2})', text.split('DIGIT_ATLAS[')[1])]
+    widths = re.search(r'widtbl_f16\[96\][^{]*\{(.*?)\};', font, re.S)[1]
+    widths = [int(w) for w in re.findall(r'\b\d+\b', re.sub(r'//[^\n]*', '', widths))]
+    set_bits = 0
+    glyphs = re.findall(r"\{'(.)', (\d+), (\d+)\}", text)
+    for char, width, offset in glyphs:
+        width, offset = int(width), int(offset)
+        assert width == widths[ord(char) - 32] * scale
+        rows = re.search('chr_f16_{:02X}\\[\\d+\\][^{{]*\\{{(.*?)\\}};'.format(ord(char)), font, re.S)[1]
+        rows = [int(b, 16) for b in re.findall(r'0x([0-9A-F]{2})', re.sub(r'//[^\n]*', '', rows))]
+        row_bytes = (width // scale + 6) // 8
+        stride = (width + 7) // 8
+        for y in range(height):
+            for x in range(width):
+                bit = (atlas[offset + y * stride + x // 8] >> (7 - x % 8)) & 1
+                fx, fy = x // scale, y // scale
+                assert bit == (rows[fy * row_bytes + fx // 8] >> (7 - fx % 8)) & 1, (char, x, y)
+                set_bits += bit
+
+    # bus bytes of a timer update that changes one digit: before, the screen was cleared and
+    # drawChar() sent one 4x4 fillRect (11 B of window commands + 32 B) per font pixel of the
+    # five characters; now one glyph window of the changed character
+    font_pixels = set_bits // (scale * scale) * 5 // len(glyphs)
+    before = 240 * 135 * 2 + font_pixels * (11 + 2 * scale * scale)
+    after = 11 + 2 * (8 * scale) * height
+    assert after * 10 < before
+    logging.info('digit atlas: {} B, timer update {} B -> {} B on the bus'.format(len(atlas), before, after))
+
+
+@pytest.mark.host_test
+def test_step_detection() -> None:
+    # replays values.csv through main/btd_steps.c, see tools/step_eval.py
+    tools = os.path.join(os.path.dirname(__file__), 'tools')
+    report = subprocess.check_output([sys.executable, os.path.join(tools, 'step_eval.py')], text=True)
+    res = re.search(r'precision ([\d.]+)  recall ([\d.]+)  F1 ([\d.]+)  detections outside walking segments: (\d+)', report)
+    assert float(res[1]) >= 0.9
+    assert float(res[2]) >= 0.9
+    assert int(res[4]) <= 2
+    logging.info('step detection: {}'.format(report.strip()))
+
+
+@pytest.mark.host_test
+def test_mahony_filter(tmp_path: str) -> None:
+    # MahonyFilter against the vendored MahonyAHRSupdateIMU(), see tools/mahony_bench
+    here = os.path.dirname(__file__)
+    binary = os.path.join(tmp_path, 'mahony_bench')
+    subprocess.check_call([os.environ.get('CXX', 'c++'), '-O2', '-I', os.path.join(here, 'tools', 'mahony_bench'),
+                           '-I', os.path.join(here, 'main'),
+                           '-I', os.path.join(here, 'components', 'M5StickCPlus', 'src', 'utility'),
+                           os.path.join(here, 'tools', 'mahony_bench', 'mahony_bench.cpp'),
+                           os.path.join(here, 'main', 'btd_mahony.cpp'),
+                           os.path.join(here, 'components', 'M5StickCPlus', 'src', 'utility', 'MahonyAHRS.cpp'),
+                           '-o', binary])
+    report = subprocess.check_output([binary], text=True)
+    assert float(re.search(r'max angle difference to MahonyAHRSupdateIMU: ([\d.]+) deg', report)[1]) < 0.5
+    logging.info('mahony filter: {}'.format(report.strip()))
+
+
+class FeatureConfig(ctypes.Structure):
+    _fields_ = [('length', ctypes.c_uint16), ('sample_frequency', ctypes.c_float), ('peak_threshold', ctypes.c_int16),
+                ('min_frequency', ctypes.c_float), ('max_frequency', ctypes.c_float)]
+
+
+class Features(ctypes.Structure):
+    _fields_ = [('count', ctypes.c_uint16), ('mean', ctypes.c_float), ('variance', ctypes.c_float),
+                ('energy', ctypes.c_float), ('zero_crossing_rate', ctypes.c_float), ('peak_count', ctypes.c_uint16),
+                ('dominant_frequency', ctypes.c_float), ('dominant_amplitude', ctypes.c_float)]
+
+
+def naive_features(history: list, length: int, rate: float, threshold: int, bins: range) -> dict:
+    # every feature of the last window recomputed from the whole history, see main/btd_features.h
+    window = history[-length:]
+    n = len(window)
+    start = len(history) - n
+    crossings = peaks = 0
+    last_above = False
+    for i in range(1, len(history)):
+        before = history[max(0, i - length):i]
+        above = history[i] * len(before) > sum(before)
+        if above != last_above and i >= start:
+            crossings += 1
+        last_above = above
+        if i >= 2 and i - 1 >= start and history[i - 2] < history[i - 1] >= history[i] \
+                and (history[i - 1] - threshold) * len(before) > sum(before):
+            peaks += 1
+    mean = sum(window) / n
+    energy = sum(x * x for x in window) / n
+    padded = [0] * (length - n) + window
+    best, frequency = 0.0, 0.0
+    for k in bins:
+        re = sum(x * math.cos(2 * math.pi * k * m / length) for m, x in enumerate(padded))
+        im = sum(x * math.sin(2 * math.pi * k * m / length) for m, x in enumerate(padded))
+        if re * re + im * im > best:
+            best, frequency = re * re + im * im, k * rate / length
+    return {'mean': mean, 'energy': energy, 'variance': energy - mean * mean, 'zero_crossing_rate': crossings * rate / n,
+            'peak_count': peaks, 'dominant_frequency': frequency, 'dominant_amplitude': 2 * math.sqrt(best) / n}
+
+
+@pytest.mark.host_test
+def test_feature_window(tmp_path: str) -> None:
+    # the incremental features of main/btd_features.c against naive_features(), filling and sliding the window
+    lib = build_host_lib(tmp_path, 'main/btd_features.c',
+                         sizes=('btd_feature_window_t', 'btd_feature_config_t', 'btd_features_t'))
+    assert ctypes.sizeof(FeatureConfig) == lib.sizeof_btd_feature_config_t()
+    assert ctypes.sizeof(Features) == lib.sizeof_btd_features_t()
+    lib.features_init.restype = ctypes.c_bool
+    lib.features_push.argtypes = [ctypes.c_void_p, ctypes.c_int16]
+    config = FeatureConfig(100, 50.0, 200, 1.0, 7.5)  # bins 2..15
+    window = host_object(lib, 'btd_feature_window_t')
+    assert lib.features_init(window, ctypes.byref(config))
+
+    random.seed(1)
+    history = []
+    for i in range(700):
+        t = i / 50.0
+        sample = int(800 * math.sin(2 * math.pi * 3.0 * t) + 300 * math.sin(2 * math.pi * t) + random.gauss(0, 150))
+        history.append(sample)
+        lib.features_push(window, sample)
+        if i % 7 == 0 or i < 5:
+            features = Features()
+            lib.features_get(window, ctypes.byref(features))
+            assert features.count == min(len(history), 100)
+            for key, expected in naive_features(history, 100, 50.0, 200, range(2, 16)).items():
+                assert getattr(features, key) == pytest.approx(expected, rel=1e-3, abs=1e-3), (i, key)
+    assert features.dominant_frequency == 3.0
+
+
+@pytest.mark.host_test
+def test_activity_classifier(tmp_path: str) -> None:
+    # retrains the classifier of main/btd_activity.cpp, the checked-in model must be the one the script writes
+    here = os.path.dirname(__file__)
+    model = os.path.join(tmp_path, 'btd_activity_model.h')
+    report = subprocess.check_output([sys.executable, os.path.join(here, 'tools', 'train_classifier.py'), '--output', model],
+                                     text=True)
+    validation = re.search(r'validation: \d+ windows, accuracy ([\d.]+)', report)
+    assert float(validation[1]) >= 0.9
+    with open(model) as generated, open(os.path.join(here, 'main', 'btd_activity_model.h')) as checked_in:
+        assert generated.read() == checked_in.read()
+    logging.info('activity classifier: {}'.format(report.strip()))
+
+
+@pytest.mark.host_test
+def test_decimator(tmp_path: str) -> None:
+    # the polyphase decimator of main/btd_decimator.c: unity gain at DC, passband up to 0.2 and
+    # stopband from 0.6 of the output rate, for the factors of the rates in btd_rates.h
+    lib = build_host_lib(tmp_path, 'main/btd_decimator.c', sizes=('btd_decimator_t',))
+    lib.decimator_init.restype = ctypes.c_bool
+    lib.decimator_push.restype = ctypes.c_bool
+    lib.decimator_push.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.POINTER(ctypes.c_float)]
+    decimator = host_object(lib, 'btd_decimator_t')
+    assert not lib.decimator_init(decimator, 0)
+    assert not lib.decimator_init(decimator, 51)
+
+    for factor in (2, 4, 5, 10, 20):
+        for frequency, low, high in ((0.0, 0.999, 1.001), (0.2, 0.9, 1.01), (0.6, 0.0, 0.01), (0.9, 0.0, 0.01)):
+            assert lib.decimator_init(decimator, factor)
+            output = ctypes.c_float()
+            outputs = []
+            for n in range(300 * factor):
+                if lib.decimator_push(decimator, math.cos(2 * math.pi * frequency / factor * n), ctypes.byref(output)):
+                    outputs.append(output.value)
+            assert len(outputs) == 300
+            gain = max(abs(v) for v in outputs[20:])
+            assert low <= gain <= high, (factor, frequency, gain)
+
+
+OCV_CURVE = [(3.27, 0), (3.61, 5), (3.69, 10), (3.73, 20), (3.77, 30), (3.80, 40), (3.84, 50), (3.87, 60),
+             (3.95, 70), (4.02, 80), (4.11, 90), (4.20, 100)]
+
+
+def ocv_voltage(percent: float) -> float:
+    for (v0, p0), (v1, p1) in zip(OCV_CURVE, OCV_CURVE[1:]):
+        if percent <= p1:
+            return v0 + (percent - p0) / (p1 - p0) * (v1 - v0)
+    return OCV_CURVE[-1][0]
+
+
+@pytest.mark.host_test
+def test_fuel_gauge(tmp_path: str) -> None:
+    # main/btd_fuelgauge.c on a simulated 120 mAh cell: load steps between 60 and 160 mA that pull the
+    # terminal voltage down, a coulomb counter with 5% gain error and a noisy voltage ADC
+    lib = build_host_lib(tmp_path, 'main/btd_fuelgauge.c', sizes=('btd_fuelgauge_t',))
+    lib.fuelgauge_init.argtypes = [ctypes.c_void_p, ctypes.c_float]
+    lib.fuelgauge_update.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.c_float, ctypes.c_float]
+    lib.fuelgauge_ocv_percent.restype = ctypes.c_float
+    lib.fuelgauge_ocv_percent.argtypes = [ctypes.c_float]
+    for voltage, percent in OCV_CURVE:
+        assert abs(lib.fuelgauge_ocv_percent(voltage) - percent) < 0.01
+    assert lib.fuelgauge_ocv_percent(3.0) == 0 and lib.fuelgauge_ocv_percent(4.3) == 100
+
+    gauge = host_object(lib, 'btd_fuelgauge_t')
+    lib.fuelgauge_init(gauge, 120.0)
+    rng = random.Random(1)
+    capacity, period_s = 120.0, 10
+    charge, coulomb = 0.85 * capacity, 0.0
+    gauge_errors, linear_errors = [], []
+    for n in range(10000):
+        current = -160.0 if (n // 6) % 2 else -60.0  # a minute each
+        charge += current * period_s / 3600
+        coulomb += current * 1.05 * period_s / 3600
+        percent = 100 * charge / capacity
+        if percent < 3:
+            break
+        voltage = ocv_voltage(percent) + current / 1000 * 0.3 + rng.gauss(0, 0.01)
+        lib.fuelgauge_update(gauge, voltage, current, coulomb)
+        gauge_errors.append(abs(lib.fuelgauge_percent(gauge) - percent))
+        linear_errors.append(abs(min(max((voltage - 3.0) / 1.2 * 100, 0), 100) - percent))
+        if n == 300:  # 110 mA on average
+            assert abs(lib.fuelgauge_time_to_empty_min(gauge) - percent / 100 * capacity / 110 * 60) < 0.2 * 60
+    logging.info('fuel gauge error max %.1f mean %.1f, linear map max %.1f mean %.1f', max(gauge_errors),
+                 sum(gauge_errors) / len(gauge_errors), max(linear_errors), sum(linear_errors) / len(linear_errors))
+    assert max(gauge_errors[30:]) < 5
+    assert sum(gauge_errors) / len(gauge_errors) < 2
+    assert sum(gauge_errors) < sum(linear_errors) / 4
+
+
+@pytest.mark.host_test
+def test_backlight_policy(tmp_path: str) -> None:
+    # main/btd_backlight.c: dims outside of sessions, off while working unless tilted towards the user
+    lib = build_host_lib(tmp_path, 'main/btd_backlight.c')
+    lib.backlight_init.argtypes = [ctypes.c_int64]
+    lib.backlight_set_working.argtypes = [ctypes.c_bool, ctypes.c_int64]
+    lib.backlight_activity.argtypes = [ctypes.c_int64]
+    lib.backlight_is_facing.restype = ctypes.c_bool
+    lib.backlight_set_facing.argtypes = [ctypes.c_bool, ctypes.c_int64]
+    lib.backlight_update.argtypes = [ctypes.c_int64]
+    lib.backlight_session_ms.restype = ctypes.c_uint32
+    lib.backlight_session_ms.argtypes = [ctypes.c_int, ctypes.c_int64]
+    off, dim, full = 0, 1, 2
+
+    def gravity(elevation_deg: float) -> ctypes.Array:
+        e = math.radians(elevation_deg)
+        return (ctypes.c_float * 3)(math.cos(e), 0.0, math.sin(e))
+
+    assert not lib.backlight_is_facing(gravity(90))  # lying flat
+    assert not lib.backlight_is_facing(gravity(0))  # upright
+    assert not lib.backlight_is_facing(gravity(-45))  # facing away
+    assert lib.backlight_is_facing(gravity(45))
+
+    lib.backlight_init(0)
+    assert lib.backlight_update(14000) == full
+    assert lib.backlight_update(15000) == dim
+    lib.backlight_activity(16000)
+    assert lib.backlight_update(16000) == full
+
+    lib.backlight_set_working(True, 20000)
+    assert lib.backlight_update(24000) == full  # the working screen is shown first
+    assert lib.backlight_update(25000) == off
+    lib.backlight_set_facing(True, 30000)  # lifted
+    assert lib.backlight_update(30000) == full
+    assert lib.backlight_update(60000) == full
+    lib.backlight_set_facing(False, 60000)
+    assert lib.backlight_update(60000) == off
+    lib.backlight_activity(70000)  # button
+    assert lib.backlight_update(70000) == full
+    assert lib.backlight_update(74000) == full
+    assert lib.backlight_update(75000) == off
+    assert lib.backlight_update(100000) == off
+    assert lib.backlight_session_ms(full, 100000) == 5000 + 30000 + 5000
+    assert lib.backlight_session_ms(off, 100000) == 80000 - 40000
+
+    lib.backlight_set_working(False, 100000)
+    assert lib.backlight_update(100000) == full
+    lib.backlight_set_working(True, 120000)
+    assert lib.backlight_session_ms(full, 120000) == 0
+
+
+@pytest.mark.host_test
+def test_pattern_player(tmp_path: str) -> None:
+    # main/btd_pattern.c stepped like btd_vibrator.cpp does: a one-shot timer runs pattern_next() and
+    # writes the level to a fake LEDC channel, play() only queues
+    lib = build_host_lib(tmp_path, 'main/btd_pattern.c', sizes=('pattern_player_t',))
+    lib.pattern_play.restype = ctypes.c_bool
+    lib.pattern_is_idle.restype = ctypes.c_bool
+    lib.pattern_next.restype = ctypes.c_uint32
+    pattern_a = ctypes.addressof(ctypes.c_char.in_dll(lib, 'PATTERN_A'))
+    player = host_object(lib, 'pattern_player_t')
+    lib.pattern_player_init(player)
+
+    ledc = []  # (ms, duty) writes of the fake channel
+    timer = {'due': None}
+
+    def play(now: int) -> bool:
+        idle = lib.pattern_is_idle(player)
+        queued = lib.pattern_play(player, ctypes.c_void_p(pattern_a))
+        if queued and idle and timer['due'] is None:
+            timer['due'] = now
+        return queued
+
+    def run_until(end: int) -> None:
+        while timer['due'] is not None and timer['due'] <= end:
+            now = timer['due']
+            level = ctypes.c_uint8()
+            ms = lib.pattern_next(player, ctypes.byref(level))
+            ledc.append((now, level.value))
+            timer['due'] = now + ms if ms else None
+
+    assert lib.pattern_is_idle(player)
+    assert play(0)
+    assert ledc == []  # nothing happens in the caller
+    run_until(10000)
+    assert ledc == [(0, 255), (200, 0), (400, 255), (600, 0), (800, 255), (1200, 0)]
+    assert lib.pattern_is_idle(player)
+
+    # queued while playing: follows the first one without a gap
+    ledc.clear()
+    assert play(2000)
+    run_until(2300)
+    assert play(2300)
+    run_until(10000)
+    assert [t for t, _ in ledc] == [2000, 2200, 2400, 2600, 2800, 3200, 3400, 3600, 3800, 4000, 4400]
+    assert ledc[-1] == (4400, 0)
+
+    # a full queue refuses, stop turns the output off at the next step
+    ledc.clear()
+    assert all(play(5000) for _ in range(4))
+    assert not play(5000)
+    run_until(5000)
+    lib.pattern_stop(player)
+    timer['due'] = 5100
+    run_until(10000)
+    assert ledc == [(5000, 255), (5100, 0)]
+    assert lib.pattern_is_idle(player)
+
+
+class PatternStep(ctypes.Structure):
+    _fields_ = [('level', ctypes.c_uint8), ('fade_to', ctypes.c_uint8), ('hz', ctypes.c_uint16), ('ms', ctypes.c_uint16)]
+
+
+@pytest.mark.host_test
+def test_audio_cues(tmp_path: str) -> None:
+    # the cues of main/btd_pattern.c as btd_buzzer.c plays them: the tone and the start and end duty of each step
+    lib = build_host_lib(tmp_path, 'main/btd_pattern.c', sizes=('pattern_player_t', 'pattern_step_t'))
+    assert ctypes.sizeof(PatternStep) == lib.sizeof_pattern_step_t()
+    lib.pattern_play.restype = ctypes.c_bool
+    lib.pattern_next.restype = ctypes.c_uint32
+    lib.pattern_current.restype = ctypes.POINTER(PatternStep)
+    lib.pattern_duration_ms.restype = ctypes.c_uint32
+    player = host_object(lib, 'pattern_player_t')
+
+    def play(name: str) -> list:
+        cue = ctypes.addressof(ctypes.c_char.in_dll(lib, name))
+        lib.pattern_player_init(player)
+        assert lib.pattern_play(player, ctypes.c_void_p(cue))
+        now, hz, steps = 0, 2000, []
+        level = ctypes.c_uint8()
+        while True:
+            ms = lib.pattern_next(player, ctypes.byref(level))
+            step = lib.pattern_current(player)
+            if not step:
+                assert ms == 0 and level.value == 0
+                break
+            hz = step.contents.hz or hz
+            steps.append((now, hz, level.value, step.contents.fade_to))
+            now += ms
+        assert now == lib.pattern_duration_ms(ctypes.c_void_p(cue))
+        return steps
+
+    assert play('CUE_WORK_START') == [(0, 2093, 255, 255), (90, 2637, 255, 255), (180, 3136, 255, 0)]
+    assert play('CUE_BREAK_START') == [(0, 3136, 255, 255), (90, 2637, 255, 255), (180, 2093, 255, 0)]
+    assert play('CUE_BREAK_END') == [(0, 3136, 255, 0), (120, 3136, 0, 0), (200, 3136, 255, 0)]
+    for name in ('CUE_WORK_START', 'CUE_BREAK_START', 'CUE_BREAK_END'):
+        cue = ctypes.addressof(ctypes.c_char.in_dll(lib, name))
+        assert lib.pattern_duration_ms(ctypes.c_void_p(cue)) <= 500  # a cue does not hold the microphone long
@@ -0,0 +1,29 @@
+# Python side of main/btd_delta.c, shared by the stream servers
+
+KEYFRAME_INTERVAL = 100  # BTD_DELTA_KEYFRAME_INTERVAL in main/btd_delta.h
+A_RES = 16.0 / 32768.0  # ADC counts to g, same as getAccelData()
+
+
+def delta_decode(data, keyframe_interval=KEYFRAME_INTERVAL):
+    # inverse of delta_encode_sample(), keyframe_interval 0 = only the first sample is a keyframe
+    samples = []
+    prev = [0, 0, 0]
+    cur = [0, 0, 0]
+    axis = shift = value = 0
+    for byte in data:
+        value |= (byte & 0x7F) << shift
+        if byte & 0x80:
+            shift += 7
+            continue
+        if axis == 0 and (len(samples) == 0 if keyframe_interval == 0
+                          else len(samples) % keyframe_interval == 0):
+            prev = [0, 0, 0]
+        delta = (value >> 1) ^ -(value & 1)
+        cur[axis] = (prev[axis] + delta + 32768) % 65536 - 32768
+        axis += 1
+        value = shift = 0
+        if axis == 3:
+            axis = 0
+            prev = cur[:]
+            samples.append(tuple(cur))
+    return samples
@@ -0,0 +1,208 @@
+import argparse
+import csv
+import random
+import select
+import socket
+import struct
+import threading
+import time
+
+from btd_delta import delta_decode, A_RES
+
+# stand-in server for the reconnecting TCP stream (CONFIG_BTD_STREAM_TCP_RESUME), see main/btd_conn.h
+# --drop closes client connections at random, to exercise reconnect and replay
+# --journal keeps the accepted records on disk, a restarted server resumes the sessions from it
+
+PORT = 9000  # the same port number used in the M5StickC Plus code
+SERVER = '0.0.0.0'  # Listen on all interfaces
+REPORT_INTERVAL = 5  # seconds between statistics printouts
+
+FRAME = struct.Struct('<BBHI')  # type, flags, payload length, seq
+HELLO, RESUME, DATA, ACK = b'H'[0], b'R'[0], b'D'[0], b'A'[0]
+RECORD_TIMESTAMP = struct.Struct('<I')  # ms of the first sample in a record
+JOURNAL = struct.Struct('<IIH')  # session id, seq, payload length, followed by the payload
+
+
+class Session:
+    def __init__(self, session_id):
+        self.session_id = session_id
+        self.next_seq = None
+        self.records = 0
+        self.duplicates = 0
+        self.missing = 0  # dropped by the client when its resend buffer overflowed
+        self.connects = 0
+        self.samples = []
+
+    def __str__(self):
+        return (f"session {self.session_id:08x}: {self.connects} connects, {self.records} records, "
+                f"{len(self.samples)} samples, {self.duplicates} duplicates, {self.missing} missing")
+
+
+sessions = {}
+lock = threading.Lock()
+journal = None
+
+
+def accept(session, seq, payload):
+    # call with lock held, returns False for a record the session already has
+    if seq < session.next_seq:
+        session.duplicates += 1
+        return False
+    session.missing += seq - session.next_seq
+    session.next_seq = seq + 1
+    session.records += 1
+    session.samples.extend(delta_decode(payload[RECORD_TIMESTAMP.size:], 0))
+    return True
+
+
+def load_journal(path):
+    # restores the sessions of earlier runs, a record cut short by a kill is dropped
+    try:
+        with open(path, 'rb') as fp:
+            data = fp.read()
+    except FileNotFoundError:
+        return 0
+    pos = 0
+    while pos + JOURNAL.size <= len(data):
+        session_id, seq, length = JOURNAL.unpack_from(data, pos)
+        payload = data[pos + JOURNAL.size:pos + JOURNAL.size + length]
+        if len(payload) < length:
+            break
+        pos += JOURNAL.size + length
+        session = sessions.setdefault(session_id, Session(session_id))
+        if session.next_seq is None:
+            session.next_seq = seq
+        accept(session, seq, payload)
+    return pos
+
+
+def recv_exact(conn, size):
+    data = b''
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def handle(conn, addr, args):
+    header = recv_exact(conn, FRAME.size)
+    if header is None:
+        return
+    kind, _, length, acked = FRAME.unpack(header)
+    payload = recv_exact(conn, length)
+    if kind != HELLO or payload is None or length != 4:
+        print(f"{addr[0]}:{addr[1]} sent no hello, closing")
+        return
+
+    session_id = struct.unpack('<I', payload)[0]
+    with lock:
+        session = sessions.setdefault(session_id, Session(session_id))
+        session.connects += 1
+        if session.next_seq is None:
+            session.next_seq = acked
+        # the client can not go back further than its last acknowledged record
+        session.next_seq = max(session.next_seq, acked)
+        resume = session.next_seq
+    print(f"{addr[0]}:{addr[1]} hello, session {session_id:08x} acked {acked}, resuming at {resume}")
+    conn.sendall(FRAME.pack(RESUME, 0, 0, resume))
+
+    unacked = 0
+    while True:
+        # acknowledge batched records as soon as the client goes quiet
+        if unacked and not select.select([conn], [], [], 0)[0]:
+            conn.sendall(FRAME.pack(ACK, 0, 0, session.next_seq))
+            unacked = 0
+
+        header = recv_exact(conn, FRAME.size)
+        if header is None:
+            print(f"{addr[0]}:{addr[1]} closed")
+            return
+        kind, _, length, seq = FRAME.unpack(header)
+        payload = recv_exact(conn, length)
+        if kind != DATA or payload is None:
+            print(f"{addr[0]}:{addr[1]} unexpected frame {kind}, closing")
+            return
+
+        with lock:
+            if accept(session, seq, payload) and journal:
+                # on disk before the ack that covers it
+                journal.write(JOURNAL.pack(session_id, seq, length) + payload)
+                journal.flush()
+            next_seq = session.next_seq
+
+        # dropped before the ack, so the client has to replay what is in flight
+        if random.random() < args.drop:
+            print(f"{addr[0]}:{addr[1]} dropping connection at seq {seq}")
+            return
+
+        unacked += 1
+        if unacked >= args.ack_every:
+            conn.sendall(FRAME.pack(ACK, 0, 0, next_seq))
+            unacked = 0
+
+
+def serve(conn, addr, args):
+    try:
+        handle(conn, addr, args)
+    except OSError as e:
+        print(f"{addr[0]}:{addr[1]} {e}")
+    finally:
+        conn.close()
+
+
+def report():
+    while True:
+        time.sleep(REPORT_INTERVAL)
+        with lock:
+            for session in sessions.values():
+                print(session)
+
+
+def main():
+    global journal
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', type=int, default=PORT)
+    parser.add_argument('--drop', type=float, default=0.0,
+                        help='probability of closing the connection after each data frame')
+    parser.add_argument('--ack-every', type=int, default=4, help='records per acknowledgement')
+    parser.add_argument('--csv', help='write the samples of all sessions in g to this file on exit')
+    parser.add_argument('--journal', help='append the accepted records to this file and restore the sessions from it')
+    args = parser.parse_args()
+
+    if args.journal:
+        size = load_journal(args.journal)
+        for session in sessions.values():
+            print(f"restored {session}")
+        journal = open(args.journal, 'ab')
+        journal.truncate(size)
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    s.bind((SERVER, args.port))
+    s.listen(4)
+    print(f"Waiting for clients on port {args.port}...")
+    threading.Thread(target=report, daemon=True).start()
+
+    try:
+        while True:
+            conn, addr = s.accept()
+            threading.Thread(target=serve, args=(conn, addr, args), daemon=True).start()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        s.close()
+        with lock:
+            for session in sessions.values():
+                print(session)
+            if args.csv:
+                with open(args.csv, 'w', newline='') as fp:
+                    writer = csv.writer(fp)
+                    for session in sessions.values():
+                        for sample in session.samples:
+                            writer.writerow([round(v * A_RES, 6) for v in sample])
+
+
+if __name__ == '__main__':
+    main()
@@ -2,11 +2,27 @@ import socket
 import csv
 import time
 
+from btd_delta import delta_decode, A_RES
+
 
 def chunker(seq, size):
     return (seq[pos:pos + size] for pos in range(0, len(seq), size))
 
 
+# set to True when the device is built with CONFIG_BTD_STREAM_TCP_DELTA
+DELTA = False
+
+
+def recv_exact(conn, size):
+    data = b''
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
 # Define server information
 host = '0.0.0.0'  # listen on all available interfaces
 port = 9000  # the same port number used in the M5StickC Plus code
@@ -28,7 +44,20 @@ tup = []
 msg=''
 termination = 'end'.encode()
 st = time.time()
-while True:
+payload = b''
+while DELTA:
+    header = recv_exact(conn, 2)
+    if header is None:
+        print("no message..")  # connection closed by client
+        break
+    length = int.from_bytes(header, 'little')
+    if length == 0:
+        print("end of transmission..")
+        break
+    payload += recv_exact(conn, length) or b''
+    print('frame:', length, 'bytes')
+
+while not DELTA:
     data = conn.recv(1024)  # receive up to 1024 bytes of data
     if not data:
         print("no message..")  # connection closed by client
@@ -47,7 +76,12 @@ et = time.time()
 conn.send("OK".encode('utf-8'))
 print(len(msg))
 print(msg)
-res = [float(idx) for idx in msg.split(', ') if not idx == '']
+if DELTA:
+    samples = delta_decode(payload)
+    print(len(payload), 'bytes for', len(samples), 'samples')
+    res = [round(v * A_RES, 6) for sample in samples for v in sample]
+else:
+    res = [float(idx) for idx in msg.split(', ') if not idx == '']
 tup.extend(res)
 conn.send("Bye!".encode('utf-8'))
 conn.close()
@@ -0,0 +1,91 @@
+import socket
+import struct
+import time
+
+# receiver for the UDP stream mode (CONFIG_BTD_STREAM_UDP), see main/btd_stream.h
+
+PORT = 9000  # the same port number used in the M5StickC Plus code
+SERVER = '0.0.0.0'  # Listen on all interfaces
+REPORT_INTERVAL = 5  # seconds between statistics printouts
+
+MAGIC = 0xB7D5
+HEADER = struct.Struct('<HHIIq')  # magic, count, seq, period_us, timestamp_us
+SAMPLE = struct.Struct('<hhh')
+A_RES = 16.0 / 32768.0  # ADC counts to g, same as getAccelData()
+
+
+class StreamStats:
+    def __init__(self):
+        self.received = 0
+        self.lost = 0
+        self.reordered = 0
+        self.duplicates = 0
+        self.samples = 0
+        self.jitter_us = 0.0
+        self.first_seq = None
+        self.highest_seq = None
+        self.seen = set()
+        self.last_transit_us = None
+
+    def update(self, seq, timestamp_us, count, arrival_us):
+        if seq in self.seen:
+            self.duplicates += 1
+            return
+        self.seen.add(seq)
+
+        if self.highest_seq is None:
+            self.first_seq = self.highest_seq = seq
+        elif seq > self.highest_seq:
+            self.highest_seq = seq
+        else:
+            self.reordered += 1
+            self.first_seq = min(self.first_seq, seq)
+
+        self.received += 1
+        self.samples += count
+        self.lost = (self.highest_seq - self.first_seq + 1) - self.received
+
+        # RFC 3550 inter-arrival jitter, clock offset between device and host cancels out
+        transit = arrival_us - timestamp_us
+        if self.last_transit_us is not None:
+            self.jitter_us += (abs(transit - self.last_transit_us) - self.jitter_us) / 16
+        self.last_transit_us = transit
+
+    def __str__(self):
+        expected = self.received + self.lost
+        loss = 100.0 * self.lost / expected if expected else 0.0
+        return (f"received {self.received} datagrams ({self.samples} samples), "
+                f"lost {self.lost} ({loss:.2f}%), reordered {self.reordered}, "
+                f"duplicates {self.duplicates}, jitter {self.jitter_us / 1000:.2f} ms")
+
+
+def start():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    s.bind((SERVER, PORT))
+    print(f"[LISTENING] UDP stream receiver on {SERVER}:{PORT}")
+
+    stats = StreamStats()
+    last_report = time.time()
+    while True:
+        data, addr = s.recvfrom(2048)
+        arrival_us = time.monotonic_ns() // 1000
+        if len(data) < HEADER.size:
+            continue
+        magic, count, seq, period_us, timestamp_us = HEADER.unpack_from(data)
+        if magic != MAGIC or len(data) < HEADER.size + count * SAMPLE.size:
+            print(f"[{addr}] invalid datagram of {len(data)} bytes")
+            continue
+
+        stats.update(seq, timestamp_us, count, arrival_us)
+        x, y, z = SAMPLE.unpack_from(data, HEADER.size + (count - 1) * SAMPLE.size)
+        last_sample = (x * A_RES, y * A_RES, z * A_RES)
+
+        if time.time() - last_report >= REPORT_INTERVAL:
+            last_report = time.time()
+            print(f"[{addr}] {stats}, last sample {last_sample[0]:.3f}, {last_sample[1]:.3f}, {last_sample[2]:.3f}")
+
+
+if __name__ == '__main__':
+    print("[STARTING] server is starting...")
+    start()
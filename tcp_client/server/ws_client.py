@@ -0,0 +1,120 @@
+import argparse
+import base64
+import os
+import socket
+import struct
+import threading
+import time
+
+# client for the /ws telemetry stream of the config web server (CONFIG_BTD_WS_TELEMETRY), see main/btd_telemetry.h
+# opens several connections at once, e.g. --clients 3 next to a browser, to measure the frame rate per client
+
+HOST = '192.168.4.1'  # default address of the ti:ma access point
+PORT = 80
+REPORT_INTERVAL = 5  # seconds between statistics printouts
+
+FRAME = struct.Struct('<BBHBBHII')  # version, state, remaining_s, battery, loud, mic_level, steps, seq
+STATES = {0: 'init', 1: 'awake', 2: 'working', 3: 'break'}
+
+
+class Client:
+    def __init__(self, index):
+        self.index = index
+        self.frames = 0
+        self.gaps = 0  # frames lost or skipped by the device
+        self.last = None
+        self.error = None
+
+    def __str__(self):
+        text = f"client {self.index}: {self.frames} frames, {self.gaps} missing"
+        if self.error:
+            text += f", {self.error}"
+        return text
+
+
+def recv_exact(conn, size):
+    data = b''
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError('closed by the device')
+        data += chunk
+    return data
+
+
+def connect(host, port):
+    conn = socket.create_connection((host, port), timeout=5)
+    key = base64.b64encode(os.urandom(16)).decode()
+    conn.sendall((f"GET /ws HTTP/1.1\r\nHost: {host}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                  f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n").encode())
+    response = b''
+    while b'\r\n\r\n' not in response:
+        response += recv_exact(conn, 1)
+    if not response.startswith(b'HTTP/1.1 101'):
+        raise ConnectionError(response.split(b'\r\n')[0].decode())
+    return conn
+
+
+def recv_message(conn):
+    # frames from the server are not masked and the telemetry never needs extended lengths beyond 16 bit
+    opcode, length = recv_exact(conn, 2)
+    length &= 0x7F
+    if length == 126:
+        length = struct.unpack('>H', recv_exact(conn, 2))[0]
+    elif length == 127:
+        length = struct.unpack('>Q', recv_exact(conn, 8))[0]
+    return opcode & 0x0F, recv_exact(conn, length)
+
+
+def run(client, args):
+    try:
+        conn = connect(args.host, args.port)
+        while True:
+            opcode, payload = recv_message(conn)
+            if opcode == 0x8:
+                raise ConnectionError('closed by the device')
+            if opcode != 0x2 or len(payload) != FRAME.size:
+                continue
+            frame = FRAME.unpack(payload)
+            seq = frame[-1]
+            if client.last is not None and seq > client.last[-1] + 1:
+                client.gaps += seq - client.last[-1] - 1
+            client.last = frame
+            client.frames += 1
+    except OSError as e:
+        client.error = str(e)
+
+
+def describe(frame):
+    version, state, remaining_s, battery, loud, mic_level, steps, seq = frame
+    return (f"#{seq} {STATES.get(state, state)} {remaining_s // 60}:{remaining_s % 60:02d} left, "
+            f"battery {battery}%, mic {mic_level}{' (loud)' if loud else ''}, {steps} steps")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--host', default=HOST)
+    parser.add_argument('--port', type=int, default=PORT)
+    parser.add_argument('--clients', type=int, default=1, help='parallel connections')
+    parser.add_argument('--duration', type=float, default=0, help='seconds to run, 0 runs until Ctrl+C')
+    args = parser.parse_args()
+
+    clients = [Client(i) for i in range(args.clients)]
+    for client in clients:
+        threading.Thread(target=run, args=(client, args), daemon=True).start()
+
+    start = time.time()
+    try:
+        while not args.duration or time.time() - start < args.duration:
+            time.sleep(min(REPORT_INTERVAL, args.duration or REPORT_INTERVAL))
+            elapsed = time.time() - start
+            for client in clients:
+                print(f"{client}, {client.frames / elapsed:.1f} frames/s")
+            if clients[0].last:
+                print(describe(clients[0].last))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
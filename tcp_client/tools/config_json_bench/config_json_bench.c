@@ -0,0 +1,216 @@
+// host benchmark and mutation fuzzer of the config JSON codec (main/btd_config_json.c),
+// optionally against cJSON as the config handlers used it before (IDF's json component).
+// from tcp_client/:
+//   cc -O2 -g -fsanitize=address,undefined -I tools/conn_host -I main
+//       tools/config_json_bench/config_json_bench.c main/btd_config_json.c -o config_json_bench
+// with cJSON, the parse and the response of the old GET and POST /config handlers:
+//   cc -O2 -DWITH_CJSON=1 -I tools/conn_host -I main -I $IDF_PATH/components/json/cJSON
+//       tools/config_json_bench/config_json_bench.c main/btd_config_json.c
+//       $IDF_PATH/components/json/cJSON/cJSON.c -o config_json_bench
+// code size: compare `size` of btd_config_json.o and cJSON.o built for the target (xtensa-esp32-elf-gcc -Os)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btd_config_json.h"
+#if WITH_CJSON
+#include "cJSON.h"
+#endif
+
+#define BENCH_ROUNDS 1000000
+#define FUZZ_INPUTS 1000000
+
+static const char *const seeds[] = {
+    "{\"workTimeSeconds\":1500,\"breakTimeSeconds\":300,\"longBreakTimeSeconds\":900,"
+    "\"longBreakSessionCount\":3,\"timeoutSeconds\":0,\"breakGestureEnabled\":true}",
+    "{ \"breakTimeSeconds\" : 60 , \"breakGestureEnabled\" : false }",
+    "{\"name\":\"desk \\\"2\\\"\",\"tags\":[1,2.5e3,{\"a\":[true,null,-1]}],\"workTimeSeconds\":600}",
+    "\n{\"timeoutSeconds\":-0,\"extra\":{}}\t",
+    "{}",
+};
+
+static uint32_t rng = 0x2468ACE1;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// one edit of the input: delete, insert or replace a byte, truncate, or repeat a slice
+static size_t mutate(char *buffer, size_t len, size_t size)
+{
+    static const char alphabet[] = "{}[]\":,.-+0123456789eEtruefalsnl \\x\n";
+    size_t at = len ? next_random() % len : 0;
+    char c = next_random() % 8 ? alphabet[next_random() % (sizeof(alphabet) - 1)] : (char)next_random();
+    switch (next_random() % 5)
+    {
+    case 0:
+        if (len > 0)
+        {
+            memmove(buffer + at, buffer + at + 1, len - at - 1);
+            len--;
+        }
+        break;
+    case 1:
+        if (len < size)
+        {
+            memmove(buffer + at + 1, buffer + at, len - at);
+            buffer[at] = c;
+            len++;
+        }
+        break;
+    case 2:
+        if (len > 0)
+            buffer[at] = c;
+        break;
+    case 3:
+        len = at;
+        break;
+    default:
+    {
+        size_t slice = len - at < 8 ? len - at : 8;
+        if (len + slice <= size)
+        {
+            memmove(buffer + at + slice, buffer + at, len - at);
+            len += slice;
+        }
+        break;
+    }
+    }
+    return len;
+}
+
+static int fuzz(void)
+{
+    const btd_config_t before = {1234, 321, 999, 4, 77, true};
+    char input[CONFIG_JSON_MAX_LEN];
+    char written[CONFIG_JSON_MAX_LEN];
+    char error[CONFIG_JSON_ERROR_LEN];
+    unsigned accepted = 0;
+
+    for (unsigned i = 0; i < FUZZ_INPUTS; i++)
+    {
+        const char *seed = seeds[next_random() % (sizeof(seeds) / sizeof(seeds[0]))];
+        size_t len = strlen(seed);
+        memcpy(input, seed, len);
+        for (unsigned edits = 1 + next_random() % 4; edits > 0; edits--)
+            len = mutate(input, len, sizeof(input));
+
+        // a copy on the heap, so ASan catches a read past the end
+        char *exact = malloc(len ? len : 1);
+        memcpy(exact, input, len);
+        btd_config_t config = before;
+        memset(error, 0, sizeof(error));
+        esp_err_t err = config_json_parse(exact, len, &config, error);
+        free(exact);
+
+        if (err != ESP_OK)
+        {
+            if (memcmp(&config, &before, sizeof(config)) != 0 || error[0] == '\0' || error[sizeof(error) - 1] != '\0')
+            {
+                printf("FAIL: rejected input changed the config or has no message: %.*s\n", (int)len, input);
+                return 1;
+            }
+            continue;
+        }
+        accepted++;
+
+        // the writer round-trips every accepted config and refuses buffers that are too small
+        size_t written_len = config_json_write(&config, written, sizeof(written));
+        btd_config_t again = before;
+        if (written_len == 0 || config_json_parse(written, written_len, &again, NULL) != ESP_OK ||
+            memcmp(&again, &config, sizeof(config)) != 0 ||
+            config_json_write(&config, written, written_len) != 0 ||
+            config_json_write(&config, written, written_len + 1) != written_len)
+        {
+            printf("FAIL: no round trip for: %.*s\n", (int)len, input);
+            return 1;
+        }
+    }
+    printf("fuzz: %u inputs, %u accepted, no failures\n", FUZZ_INPUTS, accepted);
+    return 0;
+}
+
+static void bench(void)
+{
+    const char *json = seeds[0];
+    size_t len = strlen(json);
+    btd_config_t config = DEFAULT_CONFIG;
+    char out[CONFIG_JSON_MAX_LEN];
+    size_t total = 0;
+
+    double start = now_ns();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+    {
+        config.workTimeSeconds = 0;
+        config_json_parse(json, len, &config, NULL);
+        total += config.workTimeSeconds;
+    }
+    double parse_ns = (now_ns() - start) / BENCH_ROUNDS;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+    {
+        config.timeoutSeconds = i & 0xFF;
+        total += config_json_write(&config, out, sizeof(out));
+    }
+    double write_ns = (now_ns() - start) / BENCH_ROUNDS;
+    printf("btd_config_json: %zu B object, parse %.0f ns, write %.0f ns, no heap (%zu)\n",
+           len, parse_ns, write_ns, total);
+
+#if WITH_CJSON
+    // the old handlers: cJSON_Parse of the terminated body, cJSON_PrintUnformatted of a new object
+    start = now_ns();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+    {
+        cJSON *root = cJSON_Parse(json);
+        config.workTimeSeconds = cJSON_GetObjectItem(root, "workTimeSeconds")->valueint;
+        config.breakTimeSeconds = cJSON_GetObjectItem(root, "breakTimeSeconds")->valueint;
+        config.longBreakTimeSeconds = cJSON_GetObjectItem(root, "longBreakTimeSeconds")->valueint;
+        config.longBreakSessionCount = cJSON_GetObjectItem(root, "longBreakSessionCount")->valueint;
+        config.timeoutSeconds = cJSON_GetObjectItem(root, "timeoutSeconds")->valueint;
+        config.breakGestureEnabled = cJSON_IsTrue(cJSON_GetObjectItem(root, "breakGestureEnabled"));
+        cJSON_Delete(root);
+        total += config.workTimeSeconds;
+    }
+    parse_ns = (now_ns() - start) / BENCH_ROUNDS;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+    {
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddNumberToObject(root, "workTimeSeconds", config.workTimeSeconds);
+        cJSON_AddNumberToObject(root, "breakTimeSeconds", config.breakTimeSeconds);
+        cJSON_AddNumberToObject(root, "longBreakTimeSeconds", config.longBreakTimeSeconds);
+        cJSON_AddNumberToObject(root, "longBreakSessionCount", config.longBreakSessionCount);
+        cJSON_AddNumberToObject(root, "timeoutSeconds", i & 0xFF);
+        cJSON_AddBoolToObject(root, "breakGestureEnabled", config.breakGestureEnabled);
+        char *response = cJSON_PrintUnformatted(root);
+        total += strlen(response);
+        free(response);
+        cJSON_Delete(root);
+    }
+    write_ns = (now_ns() - start) / BENCH_ROUNDS;
+    printf("cJSON:           %zu B object, parse %.0f ns, write %.0f ns (%zu)\n", len, parse_ns, write_ns, total);
+#endif
+}
+
+int main(void)
+{
+    if (fuzz() != 0)
+        return 1;
+    bench();
+    return 0;
+}
@@ -0,0 +1,8 @@
+// host stand-in for the ESP-IDF error codes used by main/btd_conn.h and main/btd_config_json.h
+#pragma once
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
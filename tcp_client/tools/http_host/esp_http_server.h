@@ -0,0 +1,33 @@
+// host stand-in for the ESP-IDF HTTP server API, just enough to build main/btd_webui.cpp
+// into the library of test_webui_gzip (pytest_tcp_client.py), see httpd_fake.c
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_HTTPD_RESULT_TRUNC 0xb006
+
+#define HTTPD_RESP_USE_STRLEN -1
+
+typedef struct
+{
+    const char *headers; // of the request, "Name: value\r\n" lines
+    size_t content_len;
+} httpd_req_t;
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,97 @@
+// records the response of one handler call as HTTP/1.1 text, for the host tests
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_http_server.h"
+
+typedef esp_err_t (*handler_t)(httpd_req_t *req);
+
+static char *out;
+static size_t out_size;
+static size_t out_len;
+
+static const char *status;
+static const char *type;
+static const char *header_fields[8];
+static const char *header_values[8];
+static int header_count;
+
+static void append(const char *data, size_t len)
+{
+    if (len > out_size - out_len)
+        len = out_size - out_len;
+    memcpy(out + out_len, data, len);
+    out_len += len;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size)
+{
+    size_t field_len = strlen(field);
+    for (const char *line = req->headers; *line; line = strstr(line, "\r\n") + 2)
+    {
+        if (strncasecmp(line, field, field_len) != 0 || line[field_len] != ':')
+            continue;
+        const char *value = line + field_len + 1;
+        while (*value == ' ')
+            value++;
+        size_t len = strstr(value, "\r\n") - value;
+        if (val_size == 0)
+            return ESP_ERR_HTTPD_RESULT_TRUNC;
+        size_t copied = len < val_size - 1 ? len : val_size - 1;
+        memcpy(val, value, copied);
+        val[copied] = '\0';
+        return copied < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *value)
+{
+    status = value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *value)
+{
+    type = value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value)
+{
+    if (header_count == 8)
+        return ESP_ERR_INVALID_SIZE;
+    header_fields[header_count] = field;
+    header_values[header_count++] = value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len)
+{
+    char line[128];
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+        buf_len = buf ? strlen(buf) : 0;
+    append(line, snprintf(line, sizeof(line), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n",
+                          status, type, (int)buf_len));
+    for (int i = 0; i < header_count; i++)
+        append(line, snprintf(line, sizeof(line), "%s: %s\r\n", header_fields[i], header_values[i]));
+    append("\r\n", 2);
+    append(buf, buf_len);
+    return ESP_OK;
+}
+
+/*
+    In: handler, request headers as "Name: value\r\n" lines, buffer for the response
+    Out: length of the response in out, 0 if the handler failed
+*/
+size_t httpd_fake_call(handler_t handler, const char *headers, char *response, size_t size)
+{
+    httpd_req_t req = {.headers = headers, .content_len = 0};
+    out = response;
+    out_size = size;
+    out_len = 0;
+    status = "200 OK";
+    type = "text/html";
+    header_count = 0;
+    return handler(&req) == ESP_OK ? out_len : 0;
+}
@@ -0,0 +1,10 @@
+// host stand-in for the M5StickCPlus library header, just enough to build the
+// vendored utility/MahonyAHRS.cpp for tools/mahony_bench
+#pragma once
+
+#include <stdint.h>
+
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+// invSqrt() reinterprets a float as long, which is 32 bits on the ESP32 only
+#define long int32_t
@@ -0,0 +1,110 @@
+// host benchmark of the Mahony filter: the vendored global-state implementation
+// (components/M5StickCPlus/src/utility/MahonyAHRS.cpp) against MahonyFilter
+// (main/btd_mahony.cpp), plus a check that both compute the same angles.
+// from tcp_client/:
+//   c++ -O2 -I tools/mahony_bench -I main -I components/M5StickCPlus/src/utility \
+//       tools/mahony_bench/mahony_bench.cpp main/btd_mahony.cpp \
+//       components/M5StickCPlus/src/utility/MahonyAHRS.cpp -o mahony_bench && ./mahony_bench
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "MahonyAHRS.h"
+#include "btd_mahony.h"
+
+#define VENDOR_RATE 25.0f // fixed in MahonyAHRS.cpp
+#define VENDOR_DECLINATION 8.5f
+#define FIFO_SAMPLES 32
+#define SAMPLES (1 << 20)
+#define DEG_TO_RAD_BENCH 0.017453293f
+
+static volatile float sink;
+
+// wrist movement: rotation around all axes, accelerometer with gravity and some noise
+static std::vector<btd_imu_sample_t> make_samples(size_t count, float rate)
+{
+    std::vector<btd_imu_sample_t> samples(count);
+    uint32_t rng = 0x12345678;
+    for (size_t i = 0; i < count; i++) {
+        float t = i / rate;
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        float n = (rng & 0xFFFF) / 65536.0f - 0.5f;
+        float roll = 0.6f * sinf(0.7f * t);
+        float pitch = 0.4f * sinf(0.45f * t + 1.0f);
+        btd_imu_sample_t *s = &samples[i];
+        s->ax = -sinf(pitch) + 0.05f * n;
+        s->ay = cosf(pitch) * sinf(roll) + 0.05f * n;
+        s->az = cosf(pitch) * cosf(roll) - 0.05f * n;
+        s->gx = 0.6f * 0.7f * cosf(0.7f * t) * 57.29578f + n;
+        s->gy = 0.4f * 0.45f * cosf(0.45f * t + 1.0f) * 57.29578f - n;
+        s->gz = 10.0f * sinf(0.2f * t);
+    }
+    return samples;
+}
+
+template <typename F>
+static double updates_per_second(size_t count, F run)
+{
+    auto start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return count / elapsed.count();
+}
+
+int main()
+{
+    std::vector<btd_imu_sample_t> samples = make_samples(SAMPLES, VENDOR_RATE);
+    float pitch, roll, yaw;
+
+    // same input at the vendored rate, both start at the identity
+    MahonyFilter filter(VENDOR_RATE);
+    float max_diff = 0.0f;
+    for (size_t i = 0; i < 10000; i++) {
+        const btd_imu_sample_t *s = &samples[i];
+        MahonyAHRSupdateIMU(s->gx * DEG_TO_RAD_BENCH, s->gy * DEG_TO_RAD_BENCH, s->gz * DEG_TO_RAD_BENCH,
+                            s->ax, s->ay, s->az, &pitch, &roll, &yaw);
+        float p, r, y;
+        filter.update(s->gx, s->gy, s->gz, s->ax, s->ay, s->az);
+        filter.getEuler(&p, &r, &y);
+        float dy = fabsf(remainderf(yaw + VENDOR_DECLINATION - y, 360.0f));
+        max_diff = fmaxf(max_diff, fmaxf(fmaxf(fabsf(pitch - p), fabsf(roll - r)), dy));
+    }
+    printf("max angle difference to MahonyAHRSupdateIMU: %.4f deg over 10000 samples\n", max_diff);
+
+    double vendor = updates_per_second(SAMPLES, [&] {
+        for (const btd_imu_sample_t &s : samples)
+            MahonyAHRSupdateIMU(s.gx * DEG_TO_RAD_BENCH, s.gy * DEG_TO_RAD_BENCH, s.gz * DEG_TO_RAD_BENCH,
+                                s.ax, s.ay, s.az, &pitch, &roll, &yaw);
+        sink = pitch;
+    });
+    double euler_each = updates_per_second(SAMPLES, [&] {
+        for (const btd_imu_sample_t &s : samples) {
+            filter.update(s.gx, s.gy, s.gz, s.ax, s.ay, s.az);
+            filter.getEuler(&pitch, &roll, &yaw);
+        }
+        sink = pitch;
+    });
+    double single = updates_per_second(SAMPLES, [&] {
+        for (const btd_imu_sample_t &s : samples)
+            filter.update(s.gx, s.gy, s.gz, s.ax, s.ay, s.az);
+        filter.getEuler(&pitch, &roll, &yaw);
+        sink = pitch;
+    });
+    double batch = updates_per_second(SAMPLES, [&] {
+        for (size_t i = 0; i < SAMPLES; i += FIFO_SAMPLES) {
+            filter.updateBatch(&samples[i], FIFO_SAMPLES);
+            filter.getEuler(&pitch, &roll, &yaw);
+        }
+        sink = pitch;
+    });
+
+    printf("MahonyAHRSupdateIMU (globals, angles per sample): %6.1f M updates/s\n", vendor / 1e6);
+    printf("MahonyFilter::update + getEuler per sample:       %6.1f M updates/s\n", euler_each / 1e6);
+    printf("MahonyFilter::update, angles once:                %6.1f M updates/s\n", single / 1e6);
+    printf("MahonyFilter::updateBatch of %d, angles per batch: %5.1f M updates/s\n", FIFO_SAMPLES, batch / 1e6);
+    return 0;
+}
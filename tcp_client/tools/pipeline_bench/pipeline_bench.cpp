@@ -0,0 +1,93 @@
+// host benchmark of the working loop's sample pipeline at one rate configuration (btd_rates.h):
+// fusion at the IMU rate, then decimation, feature windows, classifier and steps
+// (update_movement_features()) and the detectors once per loop, as in handle_working().
+// from tcp_client/, one configuration per build:
+//   for rates in "100 50 25" "200 50 25" "500 50 25" "500 50 50"; do set -- $rates
+//     c++ -O2 -I tools/pipeline_bench -I main -DCONFIG_BTD_IMU_RATE_HZ=$1 -DCONFIG_BTD_MOTION_RATE_HZ=$2 \
+//         -DCONFIG_BTD_STEPS_RATE_HZ=$3 tools/pipeline_bench/pipeline_bench.cpp main/btd_movement.cpp \
+//         main/btd_fusion.cpp main/btd_mahony.cpp main/btd_activity.cpp -x c main/btd_features.c \
+//         main/btd_steps.c main/btd_bandpass.c main/btd_decimator.c -lm -o pipeline_bench && ./pipeline_bench
+//   done
+// the motion rate has to match the activity model, see tools/train_classifier.py --rate
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "btd_movement.h"
+#include "btd_rates.h"
+extern "C" {
+#include "btd_fusion.h"
+}
+
+#define SECONDS 600
+
+typedef struct
+{
+    float ax, ay, az, gx, gy, gz;
+} bench_sample_t;
+
+// 10 s blocks of sitting, walking (1.8 Hz steps) and shaking (4 Hz), with sensor noise
+static std::vector<bench_sample_t> make_samples(void)
+{
+    std::vector<bench_sample_t> samples(SECONDS * IMU_RATE_HZ);
+    uint32_t rng = 0x12345678;
+    for (size_t i = 0; i < samples.size(); i++) {
+        float t = (float)i / IMU_RATE_HZ;
+        float n[6];
+        for (int k = 0; k < 6; k++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            n[k] = (rng & 0xFFFF) / 65536.0f - 0.5f;
+        }
+        int block = (int)(t / 10.0f) % 3;
+        float z = 1.0f, gx = 0.0f;
+        if (block == 1) {
+            z += 0.3f * sinf(2 * M_PI * 1.8f * t);
+            gx = 20.0f * sinf(2 * M_PI * 0.9f * t);
+        } else if (block == 2) {
+            z += 0.8f * sinf(2 * M_PI * 4.0f * t);
+            gx = 300.0f * sinf(2 * M_PI * 4.0f * t);
+        }
+        samples[i] = {0.02f * n[0], 0.02f * n[1], z + 0.02f * n[2], gx + n[3], n[4], n[5]};
+    }
+    return samples;
+}
+
+int main(void)
+{
+    std::vector<bench_sample_t> samples = make_samples();
+    init_movement_detection();
+
+    double fusion_us = 0.0, detectors_us = 0.0;
+    int walks = 0, gestures = 0;
+    std::vector<float> magnitudes(IMU_SAMPLES_PER_LOOP), rotation_rates(IMU_SAMPLES_PER_LOOP);
+    for (size_t loop = 0; loop + IMU_SAMPLES_PER_LOOP <= samples.size(); loop += IMU_SAMPLES_PER_LOOP) {
+        int64_t timestamp = (int64_t)(loop + IMU_SAMPLES_PER_LOOP - 1) * 1000 / IMU_RATE_HZ;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < IMU_SAMPLES_PER_LOOP; i++) {
+            const bench_sample_t *s = &samples[loop + i];
+            fusion_update(s->ax, s->ay, s->az, s->gx, s->gy, s->gz);
+            magnitudes[i] = sqrtf(s->ax * s->ax + s->ay * s->ay + s->az * s->az);
+            rotation_rates[i] = fusion_get_rotation_rate();
+        }
+        auto fused = std::chrono::steady_clock::now();
+        for (int i = 0; i < IMU_SAMPLES_PER_LOOP; i++) {
+            update_movement_features(magnitudes[i], rotation_rates[i],
+                                     timestamp - (IMU_SAMPLES_PER_LOOP - 1 - i) * 1000 / IMU_RATE_HZ);
+        }
+        walks += is_walking(timestamp);
+        gestures += detect_break_gesture();
+        should_auto_off(timestamp);
+        auto done = std::chrono::steady_clock::now();
+        fusion_us += std::chrono::duration<double, std::micro>(fused - start).count();
+        detectors_us += std::chrono::duration<double, std::micro>(done - fused).count();
+    }
+
+    printf("IMU %d Hz, motion %d Hz, steps %d Hz: fusion %.1f us, detectors %.1f us per second of input "
+           "(%d walks, %d gestures)\n",
+           IMU_RATE_HZ, MOTION_RATE_HZ, STEPS_RATE_HZ, fusion_us / SECONDS, detectors_us / SECONDS, walks, gestures);
+    return 0;
+}
@@ -0,0 +1,12 @@
+// rates for the host build of pipeline_bench.cpp, override with -D
+#pragma once
+
+#ifndef CONFIG_BTD_IMU_RATE_HZ
+#define CONFIG_BTD_IMU_RATE_HZ 100
+#endif
+#ifndef CONFIG_BTD_MOTION_RATE_HZ
+#define CONFIG_BTD_MOTION_RATE_HZ 50
+#endif
+#ifndef CONFIG_BTD_STEPS_RATE_HZ
+#define CONFIG_BTD_STEPS_RATE_HZ 25
+#endif
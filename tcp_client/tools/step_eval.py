@@ -0,0 +1,130 @@
+import argparse
+import csv
+import ctypes
+import math
+import os
+import subprocess
+import tempfile
+
+# offline check of the step detection (main/btd_steps.c) against annotated recordings
+# builds the C code into a shared library, replays the recording at 100 Hz, decimated to the
+# step detection rate (btd_decimator.c, CONFIG_BTD_STEPS_RATE_HZ) as on the device, and matches
+# the step events to the annotated steps:
+#   python tools/step_eval.py                          # values.csv with tools/values_steps.csv
+#   python tools/step_eval.py --csv rec.csv --annotations rec_steps.csv --tolerance 0.2 --rate 50
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MAIN = os.environ.get('STEPS_MAIN', os.path.join(HERE, '..', 'main'))
+SAMPLE_RATE = 100
+DEFAULT_RATE = 25  # CONFIG_BTD_STEPS_RATE_HZ
+
+
+class StepEvent(ctypes.Structure):
+    _fields_ = [('timestamp_ms', ctypes.c_int64), ('index', ctypes.c_uint32), ('interval_ms', ctypes.c_uint16)]
+
+
+def build_library(directory):
+    library = os.path.join(directory, 'btd_steps.so')
+    sources = [os.path.join(MAIN, 'btd_steps.c'), os.path.join(MAIN, 'btd_bandpass.c'), os.path.join(MAIN, 'btd_decimator.c')]
+    subprocess.check_call([os.environ.get('CC', 'cc'), '-O2', '-shared', '-fPIC', '-DSTEPS_EVENTS=1', '-I', MAIN,
+                           '-o', library] + sources + ['-lm'])
+    lib = ctypes.CDLL(library)
+    lib.steps_init.argtypes = [ctypes.c_float]
+    lib.steps_update.argtypes = [ctypes.c_float, ctypes.c_int64]
+    lib.steps_cadence.argtypes = [ctypes.c_int64]
+    lib.steps_cadence.restype = ctypes.c_uint16
+    lib.steps_read_events.argtypes = [ctypes.POINTER(StepEvent), ctypes.c_size_t]
+    lib.steps_read_events.restype = ctypes.c_size_t
+    lib.decimator_init.restype = ctypes.c_bool
+    lib.decimator_prime.argtypes = [ctypes.c_void_p, ctypes.c_float]
+    lib.decimator_push.restype = ctypes.c_bool
+    lib.decimator_push.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.POINTER(ctypes.c_float)]
+    lib.decimator_delay.restype = ctypes.c_float
+    return lib
+
+
+def read_annotations(path):
+    segments, steps = [], []
+    with open(path) as fp:
+        for row in csv.reader(line for line in fp if not line.startswith('#')):
+            if row[0] == 'segment':
+                segments.append((float(row[1]), float(row[2])))
+            elif row[0] == 'step':
+                steps.append(float(row[1]))
+    return segments, steps
+
+
+def run(lib, samples, rate):
+    # as update_movement_features(): decimated magnitude, timestamps corrected for the decimator delay
+    lib.steps_init(rate)
+    decimator = ctypes.create_string_buffer(4096)  # larger than btd_decimator_t
+    assert lib.decimator_init(decimator, SAMPLE_RATE // rate)
+    delay_ms = round(lib.decimator_delay(decimator) * 1000 / SAMPLE_RATE)
+    decimated = ctypes.c_float()
+    buffer = (StepEvent * 64)()
+    detected, cadence = [], []
+    for i, (x, y, z) in enumerate(samples):
+        magnitude = math.sqrt(x * x + y * y + z * z)
+        if i == 0:
+            lib.decimator_prime(decimator, magnitude)
+        timestamp_ms = i * 1000 // SAMPLE_RATE
+        if lib.decimator_push(decimator, magnitude, ctypes.byref(decimated)) and \
+                lib.steps_update(decimated.value, timestamp_ms - delay_ms):
+            count = lib.steps_read_events(buffer, len(buffer))
+            detected.extend(buffer[k].timestamp_ms / 1000 for k in range(count))
+        cadence.append(lib.steps_cadence(timestamp_ms))
+    return detected, cadence
+
+
+def match(detected, annotated, tolerance):
+    # greedy in time order, each annotated step matches at most one detection
+    matched, offsets = 0, []
+    remaining = sorted(annotated)
+    for t in sorted(detected):
+        best = min(remaining, key=lambda a: abs(a - t), default=None)
+        if best is not None and abs(best - t) <= tolerance:
+            remaining.remove(best)
+            matched += 1
+            offsets.append(t - best)
+    return matched, offsets
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--csv', default=os.path.join(HERE, '..', 'values.csv'), help='x,y,z in g at 100 Hz')
+    parser.add_argument('--annotations', default=os.path.join(HERE, 'values_steps.csv'))
+    parser.add_argument('--tolerance', type=float, default=0.25, help='seconds between a detection and its step')
+    parser.add_argument('--rate', type=int, default=DEFAULT_RATE, choices=(10, 20, 25, 50, 100),
+                        help='step detection rate, must divide the 100 Hz of the recording')
+    args = parser.parse_args()
+
+    with open(args.csv) as fp:
+        samples = [tuple(float(v) for v in row[:3]) for row in csv.reader(fp) if row]
+    segments, annotated = read_annotations(args.annotations)
+
+    with tempfile.TemporaryDirectory() as directory:
+        detected, cadence = run(build_library(directory), samples, args.rate)
+
+    matched, offsets = match(detected, annotated, args.tolerance)
+    precision = matched / len(detected) if detected else 0.0
+    recall = matched / len(annotated) if annotated else 0.0
+    f1 = 2 * precision * recall / (precision + recall) if precision + recall else 0.0
+    outside = sum(1 for t in detected if not any(a <= t <= b for a, b in segments))
+
+    print(f"{len(annotated)} annotated steps, {len(detected)} detected, {matched} matched within {args.tolerance} s")
+    print(f"precision {precision:.3f}  recall {recall:.3f}  F1 {f1:.3f}  detections outside walking segments: {outside}")
+    if offsets:
+        print(f"timing: mean offset {1000 * sum(offsets) / len(offsets):+.0f} ms, "
+              f"max {1000 * max(abs(o) for o in offsets):.0f} ms")
+    for a, b in segments:
+        inside = sorted(t for t in annotated if a <= t <= b)
+        if len(inside) > 1:
+            reference = 60 * (len(inside) - 1) / (inside[-1] - inside[0])
+            values = [c for i, c in enumerate(cadence) if a <= i / SAMPLE_RATE <= b and c > 0]
+            mean = sum(values) / len(values) if values else 0
+            print(f"segment {a:.1f}-{b:.1f} s: annotated cadence {reference:.0f} steps/min, "
+                  f"detected {mean:.0f} steps/min while walking ({len(values) / SAMPLE_RATE:.1f} s)")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,303 @@
+import argparse
+import csv
+import ctypes
+import math
+import os
+import random
+import subprocess
+import tempfile
+
+# trains the activity classifier of main/btd_activity.cpp and writes main/btd_activity_model.h
+#   python tools/train_classifier.py                                   # values.csv with tools/values_steps.csv
+#   python tools/train_classifier.py --recording rec.csv:rec_labels.csv --recording ...
+# recordings: x,y,z in g at 100 Hz, as streamed to the server or decoded from /imulog
+# labels: rows segment,<start s>,<end s> are walking (as tools/values_steps.csv), rows
+# gesture,<start s>,<end s> are shaking, everything else is still
+# The features come from the C code (btd_decimator.c to --rate, btd_features.c, activity_quantize()), so training and
+# device see the same numbers. Recordings are split into alternating 10 s blocks for training
+# and validation; training blocks are also replayed slower/faster and weaker/stronger.
+# Without gesture recordings, gestures are synthesized as shaking bursts on top of still parts.
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MAIN = os.path.join(HERE, '..', 'main')
+MODEL = os.path.join(MAIN, 'btd_activity_model.h')
+SAMPLE_RATE = 100  # of the recordings
+DEFAULT_RATE = 50  # CONFIG_BTD_MOTION_RATE_HZ
+WINDOW = 2 * SAMPLE_RATE  # MOTION_WINDOW of btd_movement.cpp, in recorded samples
+BLOCK_S = 10
+CLASSES = ['still', 'walking', 'gesture']
+FEATURES = ['stddev', 'mean', 'crossings', 'peaks', 'frequency', 'amplitude', 'periodicity']
+LEAF = 0xFF
+
+
+class FeatureConfig(ctypes.Structure):
+    _fields_ = [('length', ctypes.c_uint16), ('sample_frequency', ctypes.c_float), ('peak_threshold', ctypes.c_int16),
+                ('min_frequency', ctypes.c_float), ('max_frequency', ctypes.c_float)]
+
+
+class Features(ctypes.Structure):
+    _fields_ = [('count', ctypes.c_uint16), ('mean', ctypes.c_float), ('variance', ctypes.c_float),
+                ('energy', ctypes.c_float), ('zero_crossing_rate', ctypes.c_float), ('peak_count', ctypes.c_uint16),
+                ('dominant_frequency', ctypes.c_float), ('dominant_amplitude', ctypes.c_float)]
+
+
+def build_library(directory):
+    if not os.path.exists(MODEL):
+        write_model([{'leaf': 0}], 0, DEFAULT_RATE, ['no model yet'])
+    library = os.path.join(directory, 'btd_activity.so')
+    objects = []
+    for source in ('btd_features.c', 'btd_decimator.c'):
+        objects.append(os.path.join(directory, source.replace('.c', '.o')))
+        subprocess.check_call([os.environ.get('CC', 'cc'), '-O2', '-fPIC', '-c', '-I', MAIN, '-o', objects[-1],
+                               os.path.join(MAIN, source)])
+    subprocess.check_call([os.environ.get('CXX', 'c++'), '-O2', '-shared', '-fPIC', '-I', MAIN, '-o', library,
+                           os.path.join(MAIN, 'btd_activity.cpp')] + objects + ['-lm'])
+    lib = ctypes.CDLL(library)
+    lib.features_init.restype = ctypes.c_bool
+    lib.features_push.argtypes = [ctypes.c_void_p, ctypes.c_int16]
+    lib.decimator_init.restype = ctypes.c_bool
+    lib.decimator_prime.argtypes = [ctypes.c_void_p, ctypes.c_float]
+    lib.decimator_push.restype = ctypes.c_bool
+    lib.decimator_push.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.POINTER(ctypes.c_float)]
+    lib.decimator_delay.restype = ctypes.c_float
+    return lib
+
+
+def window_features(lib, magnitudes, labels, rate):
+    # magnitudes and labels at SAMPLE_RATE, decimated to rate as in update_movement_features();
+    # quantized features, label (None where the window is mixed) and input index about 20 times per second
+    length = 2 * rate
+    decimator = ctypes.create_string_buffer(4096)  # larger than btd_decimator_t
+    assert lib.decimator_init(decimator, SAMPLE_RATE // rate)
+    lib.decimator_prime(decimator, magnitudes[0])
+    delay = int(round(lib.decimator_delay(decimator)))
+    config = FeatureConfig(length, rate, 150, 0.5, 6.0)
+    window = ctypes.create_string_buffer(4096)
+    assert lib.features_init(window, ctypes.byref(config))
+    features = Features()
+    quantized = (ctypes.c_int16 * len(FEATURES))()
+    decimated = ctypes.c_float()
+    counts = [0] * len(CLASSES)
+    history = []  # labels of the decimated samples
+    rows = []
+    for i, m in enumerate(magnitudes):
+        if not lib.decimator_push(decimator, m, ctypes.byref(decimated)):
+            continue
+        lib.features_push(window, max(-32768, min(32767, int(round((decimated.value - 1.0) * 1000)))))
+        history.append(labels[max(0, i - delay)])
+        counts[history[-1]] += 1
+        if len(history) > length:
+            counts[history[-length - 1]] -= 1
+        if len(history) >= length and len(history) % max(1, rate // 20) == 0:
+            lib.features_get(window, ctypes.byref(features))
+            lib.activity_quantize(ctypes.byref(features), quantized)
+            best = max(range(len(CLASSES)), key=lambda c: counts[c])
+            label = best if counts[best] >= 0.6 * length else None
+            rows.append((list(quantized), label, i))
+    return rows
+
+
+def read_recording(spec):
+    path, _, label_path = spec.partition(':')
+    with open(path) as fp:
+        samples = [tuple(float(v) for v in row[:3]) for row in csv.reader(fp) if row]
+    magnitudes = [math.sqrt(x * x + y * y + z * z) for x, y, z in samples]
+    labels = [0] * len(magnitudes)
+    if label_path:
+        with open(label_path) as fp:
+            for row in csv.reader(line for line in fp if not line.startswith('#')):
+                if row and row[0] in ('segment', 'gesture'):
+                    c = 1 if row[0] == 'segment' else 2
+                    for i in range(int(float(row[1]) * SAMPLE_RATE), min(len(labels), int(float(row[2]) * SAMPLE_RATE))):
+                        labels[i] = c
+    return magnitudes, labels
+
+
+def augment(magnitudes, labels, speed, gain):
+    # replays the recording speed times faster (linear interpolation) with gain times the movement
+    out_m, out_l = [], []
+    t = 0.0
+    while t < len(magnitudes) - 1:
+        i = int(t)
+        f = t - i
+        m = magnitudes[i] * (1 - f) + magnitudes[i + 1] * f
+        out_m.append(1.0 + gain * (m - 1.0))
+        out_l.append(labels[i])
+        t += speed
+    return out_m, out_l
+
+
+def synthesize_gestures(magnitudes, labels, rng, count):
+    # shaking bursts (3-6 Hz, 0.3-1.2 g, 0.8-3 s) on still stretches, with still gaps in between
+    still = [i for i in range(len(labels) - 4 * SAMPLE_RATE) if all(labels[i + k] == 0 for k in (0, 100, 200, 399))]
+    out_m, out_l = [], []
+    for _ in range(count):
+        start = rng.choice(still)
+        base = magnitudes[start:start + 4 * SAMPLE_RATE]
+        frequency = rng.uniform(3.0, 6.0)
+        amplitude = rng.uniform(0.3, 1.2)
+        length = int(rng.uniform(0.8, 3.0) * SAMPLE_RATE)
+        onset = rng.randrange(0, len(base) - length)
+        phase = rng.uniform(0, 2 * math.pi)
+        for k, m in enumerate(base):
+            shaking = onset <= k < onset + length
+            if shaking:
+                m += amplitude * math.sin(2 * math.pi * frequency * k / SAMPLE_RATE + phase) * rng.uniform(0.8, 1.2)
+            out_m.append(m)
+            out_l.append(2 if shaking else 0)
+    return out_m, out_l
+
+
+def gini(counts):
+    total = sum(counts)
+    return 1.0 - sum((c / total) ** 2 for c in counts) if total else 0.0
+
+
+def train_tree(rows, features, max_depth, min_leaf):
+    nodes = []
+
+    def build(subset, depth):
+        counts = [0] * len(CLASSES)
+        for _, label in subset:
+            counts[label] += 1
+        index = len(nodes)
+        nodes.append({'leaf': max(range(len(CLASSES)), key=lambda c: counts[c])})
+        if depth == max_depth or max(counts) == len(subset):
+            return index
+        best = None
+        parent = gini(counts) * len(subset)
+        for f in features:
+            ordered = sorted(subset, key=lambda r: r[0][f])
+            left = [0] * len(CLASSES)
+            right = counts[:]
+            for k in range(len(ordered) - 1):
+                label = ordered[k][1]
+                left[label] += 1
+                right[label] -= 1
+                value, following = ordered[k][0][f], ordered[k + 1][0][f]
+                if value == following or k + 1 < min_leaf or len(ordered) - k - 1 < min_leaf:
+                    continue
+                gain = parent - gini(left) * (k + 1) - gini(right) * (len(ordered) - k - 1)
+                if best is None or gain > best[0]:
+                    best = (gain, f, (value + following) // 2)
+        if best is None or best[0] <= 1e-9:
+            return index
+        _, f, threshold = best
+        nodes[index] = {'feature': f, 'threshold': threshold}
+        nodes[index]['left'] = build([r for r in subset if r[0][f] <= threshold], depth + 1)
+        nodes[index]['right'] = build([r for r in subset if r[0][f] > threshold], depth + 1)
+        left, right = nodes[nodes[index]['left']], nodes[nodes[index]['right']]
+        if 'leaf' in left and 'leaf' in right and left['leaf'] == right['leaf']:
+            del nodes[index + 1:]  # both children were appended last
+            nodes[index] = {'leaf': left['leaf']}
+        return index
+
+    build(rows, 0)
+    return nodes
+
+
+def classify(nodes, values):
+    node = nodes[0]
+    while 'leaf' not in node:
+        node = nodes[node['left'] if values[node['feature']] <= node['threshold'] else node['right']]
+    return node['leaf']
+
+
+def depth_of(nodes, index=0):
+    node = nodes[index]
+    if 'leaf' in node:
+        return 0
+    return 1 + max(depth_of(nodes, node['left']), depth_of(nodes, node['right']))
+
+
+def report(nodes, rows, title):
+    matrix = [[0] * len(CLASSES) for _ in CLASSES]
+    for values, label in rows:
+        matrix[label][classify(nodes, values)] += 1
+    lines = [f'{title}: {len(rows)} windows, accuracy {sum(matrix[c][c] for c in range(len(CLASSES))) / len(rows):.3f}']
+    for c, name in enumerate(CLASSES):
+        predicted = sum(matrix[r][c] for r in range(len(CLASSES)))
+        precision = matrix[c][c] / predicted if predicted else 0.0
+        recall = matrix[c][c] / sum(matrix[c]) if sum(matrix[c]) else 0.0
+        lines.append(f'  {name:8s} precision {precision:.3f} recall {recall:.3f}  confusion {matrix[c]}')
+    return lines
+
+
+def write_model(nodes, depth, rate, comments, path=MODEL):
+    with open(path, 'w') as fp:
+        fp.write('// generated by tools/train_classifier.py, do not edit\n')
+        for line in comments:
+            fp.write(f'// {line}\n')
+        fp.write('#ifndef BTD_ACTIVITY_MODEL_H\n#define BTD_ACTIVITY_MODEL_H\n\n#include <stdint.h>\n\n')
+        fp.write(f'#define ACTIVITY_LEAF 0x{LEAF:02X}\n\n')
+        fp.write('// inner node: quantized[feature] <= threshold goes to left, else right\n')
+        fp.write('// leaf: feature is ACTIVITY_LEAF, left is the btd_activity_t\n')
+        fp.write('typedef struct\n{\n    int16_t threshold;\n    uint8_t feature;\n    uint8_t left;\n    uint8_t right;\n'
+                 '} activity_node_t;\n\n')
+        fp.write(f'#define ACTIVITY_MODEL_RATE_HZ {rate} // of the magnitude window the model was trained on\n\n')
+        fp.write(f'constexpr int ACTIVITY_MODEL_DEPTH = {depth};\n\n')
+        fp.write('constexpr activity_node_t ACTIVITY_MODEL[] = {\n')
+        for i, node in enumerate(nodes):
+            if 'leaf' in node:
+                fp.write(f'    {{0, ACTIVITY_LEAF, {node["leaf"]}, 0}}, // {i}: {CLASSES[node["leaf"]]}\n')
+            else:
+                fp.write(f'    {{{node["threshold"]}, {node["feature"]}, {node["left"]}, {node["right"]}}}, '
+                         f'// {i}: {FEATURES[node["feature"]]} <= {node["threshold"]}\n')
+        fp.write('};\n\n#endif // BTD_ACTIVITY_MODEL_H\n')
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--recording', action='append',
+                        help='csv[:labels], default values.csv:tools/values_steps.csv')
+    parser.add_argument('--gestures', type=int, default=60, help='synthetic gesture bursts per split, 0 = none')
+    parser.add_argument('--depth', type=int, default=5)
+    parser.add_argument('--min-leaf', type=int, default=10)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--rate', type=int, default=DEFAULT_RATE, choices=(25, 50, 100),
+                        help='CONFIG_BTD_MOTION_RATE_HZ, must divide the 100 Hz of the recordings')
+    parser.add_argument('--output', default=MODEL)
+    # the peak count counts noisy local maxima of the raw samples, it follows the sensor noise more than the movement
+    parser.add_argument('--skip', action='append', choices=FEATURES, help='features the tree must not use, default peaks')
+    args = parser.parse_args()
+    recordings = args.recording or [os.path.join(HERE, '..', 'values.csv') + ':' + os.path.join(HERE, 'values_steps.csv')]
+    rng = random.Random(args.seed)
+
+    train, validation = [], []
+    with tempfile.TemporaryDirectory() as directory:
+        lib = build_library(directory)
+        for spec in recordings:
+            magnitudes, labels = read_recording(spec)
+            for values, label, end in window_features(lib, magnitudes, labels, args.rate):
+                block, offset = divmod(end / SAMPLE_RATE, BLOCK_S)
+                if label is not None and offset >= WINDOW / SAMPLE_RATE:  # windows within one block
+                    (train if block % 2 == 0 else validation).append((values, label))
+            # the training blocks again at other speeds and strengths, the validation blocks unmodified
+            masked = [label if (i // (BLOCK_S * SAMPLE_RATE)) % 2 == 0 else None for i, label in enumerate(labels)]
+            for speed in (0.6, 0.8, 1.25):
+                for gain in (0.6, 1.0, 1.5):
+                    m, lab = augment(magnitudes, masked, speed, gain)
+                    for values, label, end in window_features(lib, m, [0 if x is None else x for x in lab], args.rate):
+                        if label is not None and lab[end] is not None and lab[end - WINDOW + 1] is not None:
+                            train.append((values, label))
+            if args.gestures:
+                for rows, seed in ((train, 0), (validation, 1)):
+                    m, lab = synthesize_gestures(magnitudes, labels, random.Random(args.seed * 2 + seed), args.gestures)
+                    rows.extend((v, l) for v, l, _ in window_features(lib, m, lab, args.rate) if l is not None)
+
+    rng.shuffle(train)
+    skip = args.skip or ['peaks']
+    nodes = train_tree(train, [f for f, name in enumerate(FEATURES) if name not in skip], args.depth, args.min_leaf)
+    depth = depth_of(nodes)
+    lines = [f'{len(nodes)} nodes, depth {depth}, {len(nodes) * 6} bytes']
+    lines += report(nodes, train, 'training')
+    lines += report(nodes, validation, 'validation')
+    sources = ', '.join(os.path.relpath(spec.split(':')[0], os.path.join(HERE, '..')) for spec in recordings)
+    comments = [f'{args.rate} Hz, trained on {sources}' + (f' and {2 * args.gestures} synthetic gesture bursts' if args.gestures else '')] + lines
+    write_model(nodes, depth, args.rate, comments, args.output)
+    print('\n'.join(lines))
+    print(f'written to {os.path.relpath(args.output)}')
+
+
+if __name__ == '__main__':
+    main()